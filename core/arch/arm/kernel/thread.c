@@ -1206,11 +1206,11 @@ void thread_init_per_cpu(void)
 
 	thread_init_vbar(get_excp_vect());
 
-#ifdef CFG_FTRACE_SUPPORT
+#if defined(CFG_FTRACE_SUPPORT) || defined(CFG_LDELF_TIMING)
 	/*
 	 * Enable accesses to frequency register and physical counter
 	 * register in EL0/PL0 required for timestamping during
-	 * function tracing.
+	 * function tracing and TA loading.
 	 */
 	write_cntkctl(read_cntkctl() | CNTKCTL_PL0PCTEN);
 #endif
@@ -4,6 +4,7 @@
  */
 
 #include <assert.h>
+#include <bench.h>
 #include <compiler.h>
 #include <config.h>
 #include <io.h>
@@ -67,6 +68,7 @@ uint32_t thread_handle_std_smc(uint32_t a0, uint32_t a1, uint32_t a2,
 		thread_resume_from_rpc(a3, a1, a2, a4, a5);
 		rv = OPTEE_SMC_RETURN_ERESUME;
 	} else {
+		bm_stage(BM_STAGE_SMC_ENTRY);
 		thread_alloc_and_run(a0, a1, a2, a3, 0, 0);
 		rv = OPTEE_SMC_RETURN_ETHREAD_LIMIT;
 	}
@@ -205,6 +207,8 @@ uint32_t __weak __thread_std_smc_entry(uint32_t a0, uint32_t a1, uint32_t a2,
 {
 	uint32_t rv = 0;
 
+	bm_stage(BM_STAGE_THREAD_ALLOC);
+
 	if (IS_ENABLED(CFG_VIRTUALIZATION))
 		virt_on_stdcall();
 
@@ -222,6 +226,8 @@ uint32_t __weak __thread_std_smc_entry(uint32_t a0, uint32_t a1, uint32_t a2,
 		}
 	}
 
+	bm_stage(BM_STAGE_RETURN);
+
 	return rv;
 }
 
@@ -499,7 +505,9 @@ uint32_t thread_rpc_cmd(uint32_t cmd, size_t num_params,
 		return ret;
 
 	reg_pair_from_64(carg, rpc_args + 1, rpc_args + 2);
+	bm_stage(BM_STAGE_RPC_ENTRY);
 	thread_rpc(rpc_args);
+	bm_stage(BM_STAGE_RPC_RETURN);
 
 	return get_rpc_arg_res(arg, num_params, params);
 }
@@ -5,6 +5,7 @@
  */
 
 #include <assert.h>
+#include <bench.h>
 #include <ffa.h>
 #include <io.h>
 #include <initcall.h>
@@ -452,6 +453,7 @@ static void handle_yielding_call(struct thread_smc_args *args)
 				       0);
 		res = TEE_ERROR_BAD_PARAMETERS;
 	} else {
+		bm_stage(BM_STAGE_SMC_ENTRY);
 		thread_alloc_and_run(args->a1, args->a3, args->a4, args->a5,
 				     args->a6, args->a7);
 		res = TEE_ERROR_BUSY;
@@ -1076,10 +1078,17 @@ uint32_t __weak __thread_std_smc_entry(uint32_t a0, uint32_t a1,
 	 * a4 <- w6
 	 * a5 <- w7
 	 */
+	uint32_t rv = FFA_DENIED;
+
+	bm_stage(BM_STAGE_THREAD_ALLOC);
+
 	thread_get_tsd()->rpc_target_info = swap_src_dst(a0);
 	if (a1 == OPTEE_FFA_YIELDING_CALL_WITH_ARG)
-		return yielding_call_with_arg(reg_pair_to_64(a3, a2), a4);
-	return FFA_DENIED;
+		rv = yielding_call_with_arg(reg_pair_to_64(a3, a2), a4);
+
+	bm_stage(BM_STAGE_RETURN);
+
+	return rv;
 }
 
 static bool set_fmem(struct optee_msg_param *param, struct thread_param *tpm)
@@ -1200,7 +1209,9 @@ uint32_t thread_rpc_cmd(uint32_t cmd, size_t num_params,
 	if (ret)
 		return ret;
 
+	bm_stage(BM_STAGE_RPC_ENTRY);
 	thread_rpc(&rpc_arg);
+	bm_stage(BM_STAGE_RPC_RETURN);
 
 	return get_rpc_arg_res(arg, num_params, params);
 }
@@ -51,10 +51,30 @@ struct tee_ts_global {
 	struct tee_ts_cpu_buf cpu_buf[];
 };
 
+/*
+ * Tracepoints along the path of a standard call. The time spent between
+ * consecutive stages is accumulated in per command type latency
+ * histograms kept in secure memory, see BENCHMARK_CMD_GET_LATENCY.
+ */
+enum bm_stage {
+	BM_STAGE_SMC_ENTRY,	/* Standard SMC received, no thread yet */
+	BM_STAGE_THREAD_ALLOC,	/* Running in the allocated thread */
+	BM_STAGE_PARAM_IN,	/* Parameters copied in */
+	BM_STAGE_TA_ENTRY,	/* About to enter the TA */
+	BM_STAGE_TA_RETURN,	/* Returned from the TA */
+	BM_STAGE_RPC_ENTRY,	/* About to issue an RPC to normal world */
+	BM_STAGE_RPC_RETURN,	/* Back from normal world RPC */
+	BM_STAGE_RETURN,	/* About to return to normal world */
+};
+
 #ifdef CFG_TEE_BENCHMARK
 void bm_timestamp(void);
+void bm_stage(enum bm_stage stage);
+void bm_stage_cmd(uint32_t cmd);
 #else
 static inline void bm_timestamp(void) {}
+static inline void bm_stage(enum bm_stage stage __unused) {}
+static inline void bm_stage_cmd(uint32_t cmd __unused) {}
 #endif /* CFG_TEE_BENCHMARK */
 
 #endif /* BENCH_H */
@@ -12,11 +12,26 @@
 #include <tee_api_types.h>
 #include <util.h>
 
+/* Compression formats of struct embedded_ts::ts */
+#define EMB_TS_COMPRESS_DEFLATE	0
+#define EMB_TS_COMPRESS_LZ4	1
+
+/*
+ * With EMB_TS_COMPRESS_LZ4 the image is split in blocks compressed
+ * independently so that they can be decoded directly into the destination
+ * buffer. The data starts with the uncompressed size of a block (uint32_t),
+ * followed by for each block the size of the compressed block (uint32_t)
+ * and the LZ4 block itself. If bit 31 of the size is set the block is
+ * stored uncompressed. The last block may be shorter than the others.
+ */
+#define EMB_TS_LZ4_BLOCK_STORED	BIT32(31)
+
 struct embedded_ts {
 	uint32_t flags;
 	TEE_UUID uuid;
 	uint32_t size;
 	uint32_t uncompressed_size; /* 0: not compressed */
+	uint32_t compression; /* EMB_TS_COMPRESS_* */
 	const uint8_t *ts; /* @size bytes */
 };
 
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+#ifndef KERNEL_LZ4_H
+#define KERNEL_LZ4_H
+
+#include <stddef.h>
+#include <tee_api_types.h>
+
+/*
+ * lz4_decompress_block() - Decompress an LZ4 block
+ * @src:	LZ4 compressed block (block format, no frame header)
+ * @src_len:	Size of @src
+ * @dst:	Output buffer
+ * @dst_len:	Expected size of the decompressed data
+ *
+ * Returns TEE_SUCCESS if @src decompresses to exactly @dst_len bytes,
+ * TEE_ERROR_CORRUPT_OBJECT if the input is malformed.
+ */
+TEE_Result lz4_decompress_block(const void *src, size_t src_len, void *dst,
+				size_t dst_len);
+
+#endif /* KERNEL_LZ4_H */
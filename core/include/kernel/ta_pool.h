@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+#ifndef KERNEL_TA_POOL_H
+#define KERNEL_TA_POOL_H
+
+/*
+ * ta_pool_fill_early_tas() - Load the early TAs of the warm pool
+ *
+ * Called at the beginning of each standard call, only the first call does
+ * something. This is the earliest point where user TAs can be loaded since
+ * initcalls are executed without a thread context.
+ */
+#ifdef CFG_TA_POOL
+void ta_pool_fill_early_tas(void);
+#else
+static inline void ta_pool_fill_early_tas(void)
+{
+}
+#endif
+
+#endif /* KERNEL_TA_POOL_H */
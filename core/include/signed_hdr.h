@@ -14,6 +14,7 @@ enum shdr_img_type {
 	SHDR_TA = 0,
 	SHDR_BOOTSTRAP_TA = 1,
 	SHDR_ENCRYPTED_TA = 2,
+	SHDR_COMPRESSED_TA = 3,
 };
 
 #define SHDR_MAGIC	0x4f545348
@@ -126,6 +127,23 @@ static inline size_t shdr_enc_get_size(const struct shdr_encrypted_ta *ehdr)
 #define SHDR_ENC_GET_TAG(x)	({ typeof(x) _x = (x); \
 				   (SHDR_ENC_GET_IV(_x) + _x->iv_size); })
 
+/**
+ * struct shdr_compressed_ta - compressed TA header
+ * @comp_algo:		compression algorithm, defined by enum
+ *			shdr_comp_algo
+ * @uncompressed_size:	size of the TA once decompressed
+ *
+ * The hash in struct shdr covers the decompressed TA.
+ */
+struct shdr_compressed_ta {
+	uint32_t comp_algo;
+	uint32_t uncompressed_size;
+};
+
+enum shdr_comp_algo {
+	SHDR_COMP_ALGO_ZLIB = 0,
+};
+
 /*
  * Allocates a struct shdr large enough to hold the entire header,
  * excluding a subheader like struct shdr_bootstrap_ta.
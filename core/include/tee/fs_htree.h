@@ -25,6 +25,9 @@
 #define TEE_FS_HTREE_FEK_SIZE		U(16)
 #define TEE_FS_HTREE_TAG_SIZE		U(16)
 
+/* Largest data block size which can be recorded in a hash tree image */
+#define TEE_FS_HTREE_MAX_BLOCK_SHIFT	U(16)
+
 /* Internal struct provided to let the rpc callbacks know the size if needed */
 struct tee_fs_htree_node_image {
 	/* Note that calc_node_hash() depends on hash first in struct */
@@ -42,10 +45,17 @@ struct tee_fs_htree_meta {
 	uint64_t length;
 };
 
-/* Internal struct needed by struct tee_fs_htree_image */
+/*
+ * Internal struct needed by struct tee_fs_htree_image
+ *
+ * @block_shift occupies what used to be padding and is 0 in images
+ * created before data block sizes were recorded, in which case
+ * struct tee_fs_htree_storage::block_size applies.
+ */
 struct tee_fs_htree_imeta {
 	struct tee_fs_htree_meta meta;
 	uint32_t max_node_id;
+	uint32_t block_shift;
 };
 
 /* Internal struct provided to let the rpc callbacks know the size if needed */
@@ -74,11 +84,21 @@ struct tee_fs_rpc_operation;
 /**
  * struct tee_fs_htree_storage - storage description supplied by user of
  * this interface
- * @block_size:		size of data blocks
+ * @block_size:		size of data blocks, unless another size is recorded
+ *			in the hash tree image
+ * @create_block_shift:	optional, if non-zero new hash trees get data blocks
+ *			of 1 << @create_block_shift bytes, recorded in the
+ *			hash tree image. At most TEE_FS_HTREE_MAX_BLOCK_SHIFT.
  * @rpc_read_init:	initialize a struct tee_fs_rpc_operation for an RPC read
  *			operation
  * @rpc_write_init:	initialize a struct tee_fs_rpc_operation for an RPC
  *			write operation
+ * @get_cache_id:	optional, supplies an id identifying the file in the
+ *			hash tree cache, see <tee/fs_htree_cache.h>. Returns
+ *			false if the file isn't to be cached.
+ * @set_block_size:	optional, supplies the size of the data blocks of the
+ *			hash tree once known, before any node but the root
+ *			node or any data block is accessed
  *
  * The @idx arguments starts counting from 0. The @vers arguments are either
  * 0 or 1. The @data arguments is a pointer to a buffer in non-secure shared
@@ -86,6 +106,7 @@ struct tee_fs_rpc_operation;
  */
 struct tee_fs_htree_storage {
 	size_t block_size;
+	unsigned int create_block_shift;
 	TEE_Result (*rpc_read_init)(void *aux, struct tee_fs_rpc_operation *op,
 				    enum tee_fs_htree_type type, size_t idx,
 				    uint8_t vers, void **data);
@@ -95,6 +116,8 @@ struct tee_fs_htree_storage {
 				     enum tee_fs_htree_type type, size_t idx,
 				     uint8_t vers, void **data);
 	TEE_Result (*rpc_write_final)(struct tee_fs_rpc_operation *op);
+	bool (*get_cache_id)(void *aux, uint32_t *id);
+	void (*set_block_size)(void *aux, size_t block_size);
 };
 
 struct tee_fs_htree;
@@ -126,6 +149,12 @@ void tee_fs_htree_close(struct tee_fs_htree **ht);
  */
 struct tee_fs_htree_meta *tee_fs_htree_get_meta(struct tee_fs_htree *ht);
 
+/**
+ * tee_fs_htree_get_block_size() - get the size of the data blocks
+ * @ht:		hash tree
+ */
+size_t tee_fs_htree_get_block_size(struct tee_fs_htree *ht);
+
 /**
  * tee_fs_htree_meta_set_dirty() - tell hash tree that meta were modified
  */
@@ -154,7 +183,10 @@ TEE_Result tee_fs_htree_truncate(struct tee_fs_htree **ht, size_t block_num);
  * tee_fs_htree_write_block() - encrypt and write a data block to storage
  * @ht:		hash tree
  * @block_num:	block number
- * @block:	pointer to a block of stor->block_size size
+ * @block:	pointer to a block of tee_fs_htree_get_block_size() size
+ *
+ * When the file is cached the block may be kept in secure memory and only
+ * written to storage by tee_fs_htree_sync_to_storage().
  *
  * Frees the hash tree and sets *ht to NULL on failure and returns an error code
  */
@@ -164,7 +196,7 @@ TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht, size_t block_num,
  * tee_fs_htree_write_block() - read and decrypt a data block from storage
  * @ht:		hash tree
  * @block_num:	block number
- * @block:	pointer to a block of stor->block_size size
+ * @block:	pointer to a block of tee_fs_htree_get_block_size() size
  *
  * Frees the hash tree and sets *ht to NULL on failure and returns an error code
  */
@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#ifndef __TEE_FS_HTREE_CACHE_H
+#define __TEE_FS_HTREE_CACHE_H
+
+/*
+ * Cache of hash tree elements kept in secure memory, used by the hash tree
+ * to avoid RPCs when the same file is opened and read repeatedly.
+ *
+ * Elements are identified by a file id supplied by the storage (see
+ * get_cache_id in struct tee_fs_htree_storage) and the type, index and
+ * version of the element. Heads and nodes are cached as stored, they are
+ * verified as usual each time a hash tree is opened. Data blocks are cached
+ * decrypted together with their authentication tag, a cached block is only
+ * used if the tag matches the tag in the verified node of the block.
+ */
+
+#include <compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tee/fs_htree.h>
+
+/*
+ * struct tee_fs_htree_cache_stats - statistics of the hash tree cache
+ * @hits:	number of elements found in the cache
+ * @misses:	number of elements not found in the cache
+ * @rpc_reads:	number of elements read from storage
+ * @rpc_writes:	number of elements written to storage
+ * @evictions:	number of elements evicted to make room for new ones
+ * @count:	current number of elements in the cache
+ * @size:	current size of the cache in bytes
+ * @max_size:	maximum size of the cache in bytes
+ */
+struct tee_fs_htree_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t rpc_reads;
+	uint32_t rpc_writes;
+	uint32_t evictions;
+	uint32_t count;
+	uint32_t size;
+	uint32_t max_size;
+};
+
+#ifdef CFG_REE_FS_BLOCK_CACHE
+/*
+ * tee_fs_htree_cache_get() - look up an element
+ * @id:		file id
+ * @type:	type of element
+ * @idx:	index of element
+ * @vers:	version of element, 0 or 1
+ * @tag:	authentication tag of a data block, NULL for other elements
+ * @data:	buffer receiving the element
+ * @len:	size of the element
+ *
+ * Returns true if the element was found and copied into @data.
+ */
+bool tee_fs_htree_cache_get(uint32_t id, enum tee_fs_htree_type type,
+			    size_t idx, uint8_t vers, const uint8_t *tag,
+			    void *data, size_t len);
+
+/*
+ * tee_fs_htree_cache_put() - add or replace an element
+ *
+ * Arguments as for tee_fs_htree_cache_get(). The least recently used
+ * elements are evicted if needed, nothing is done if there's not enough
+ * memory.
+ */
+void tee_fs_htree_cache_put(uint32_t id, enum tee_fs_htree_type type,
+			    size_t idx, uint8_t vers, const uint8_t *tag,
+			    const void *data, size_t len);
+
+/* Removes an element from the cache if present */
+void tee_fs_htree_cache_remove(uint32_t id, enum tee_fs_htree_type type,
+			       size_t idx, uint8_t vers);
+
+/* Removes all elements of a file from the cache */
+void tee_fs_htree_cache_remove_id(uint32_t id);
+
+/* Accounts for an element read from (@write false) or written to storage */
+void tee_fs_htree_cache_count_rpc(bool write);
+
+void tee_fs_htree_cache_get_stats(struct tee_fs_htree_cache_stats *stats);
+#else
+static inline bool
+tee_fs_htree_cache_get(uint32_t id __unused,
+		       enum tee_fs_htree_type type __unused,
+		       size_t idx __unused, uint8_t vers __unused,
+		       const uint8_t *tag __unused, void *data __unused,
+		       size_t len __unused)
+{
+	return false;
+}
+
+static inline void
+tee_fs_htree_cache_put(uint32_t id __unused,
+		       enum tee_fs_htree_type type __unused,
+		       size_t idx __unused, uint8_t vers __unused,
+		       const uint8_t *tag __unused, const void *data __unused,
+		       size_t len __unused)
+{
+}
+
+static inline void
+tee_fs_htree_cache_remove(uint32_t id __unused,
+			  enum tee_fs_htree_type type __unused,
+			  size_t idx __unused, uint8_t vers __unused)
+{
+}
+
+static inline void tee_fs_htree_cache_remove_id(uint32_t id __unused)
+{
+}
+
+static inline void tee_fs_htree_cache_count_rpc(bool write __unused)
+{
+}
+
+static inline void
+tee_fs_htree_cache_get_stats(struct tee_fs_htree_cache_stats *stats __unused)
+{
+}
+#endif /*CFG_REE_FS_BLOCK_CACHE*/
+
+#endif /*__TEE_FS_HTREE_CACHE_H*/
@@ -45,10 +45,31 @@ struct tee_file_operations {
 			     bool overwrite);
 	TEE_Result (*remove)(struct tee_pobj *po);
 	TEE_Result (*truncate)(struct tee_file_handle *fh, size_t size);
+	/* Optional, commits writes held back by the file system */
+	TEE_Result (*sync)(struct tee_file_handle *fh);
 
 	TEE_Result (*opendir)(const TEE_UUID *uuid, struct tee_fs_dir **d);
 	TEE_Result (*readdir)(struct tee_fs_dir *d, struct tee_fs_dirent **ent);
+	/*
+	 * Optional, reads up to *num entries into @ents and updates *num.
+	 * Returns TEE_ERROR_ITEM_NOT_FOUND if there are no more entries.
+	 */
+	TEE_Result (*readdir_batch)(struct tee_fs_dir *d,
+				    struct tee_fs_dirent *ents, size_t *num);
 	void (*closedir)(struct tee_fs_dir *d);
+
+	/*
+	 * Optional, transactions. Once begin_transaction() has been called
+	 * on a file handle, write() and truncate() on the handle aren't
+	 * committed until commit_transaction() commits all the handles
+	 * passed at once. abort_transaction() discards the changes, as
+	 * does closing a handle. If commit_transaction() fails the changes
+	 * of all the handles are discarded.
+	 */
+	TEE_Result (*begin_transaction)(struct tee_file_handle *fh);
+	TEE_Result (*commit_transaction)(struct tee_file_handle **fh,
+					 size_t num);
+	void (*abort_transaction)(struct tee_file_handle **fh, size_t num);
 };
 
 #ifdef CFG_REE_FS
@@ -66,6 +87,25 @@ TEE_Result tee_rpmb_fs_raw_open(const char *fname, bool create,
  * prevent a RPMB key write in the wrong state.
  */
 bool plat_rpmb_key_is_ready(void);
+
+/*
+ * struct tee_rpmb_fs_stats - statistics of partial block writes
+ * @partial_writes:	number of writes not aligned to RPMB blocks
+ * @frames_saved:	number of RPMB frames not read by partial writes
+ *			compared to reading all blocks covered by the write
+ * @cache_hits:		number of edge blocks found in the block cache
+ * @cache_misses:	number of edge blocks read from RPMB
+ * @rpc_count:		number of RPMB requests sent to tee-supplicant
+ */
+struct tee_rpmb_fs_stats {
+	uint32_t partial_writes;
+	uint32_t frames_saved;
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+	uint32_t rpc_count;
+};
+
+void tee_rpmb_fs_get_stats(struct tee_rpmb_fs_stats *stats);
 #endif
 
 /*
@@ -46,4 +46,7 @@ TEE_Result tee_fs_rpc_write_final(struct tee_fs_rpc_operation *op);
 TEE_Result tee_fs_rpc_truncate(uint32_t id, int fd, size_t len);
 TEE_Result tee_fs_rpc_remove_dfh(uint32_t id,
 				 const struct tee_fs_dirfile_fileh *dfh);
+
+/* Returns the number of file operation RPCs sent so far, wraps around */
+uint32_t tee_fs_rpc_get_count(void);
 #endif /* TEE_FS_RPC_H */
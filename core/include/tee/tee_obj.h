@@ -22,6 +22,8 @@ struct tee_obj {
 	size_t ds_pos;
 	struct tee_pobj *pobj;	/* ptr to persistant object */
 	struct tee_file_handle *fh;
+	bool in_trans;		/* true if part of a storage transaction */
+	uint32_t trans_data_size; /* data size when joining the transaction */
 };
 
 void tee_obj_add(struct user_ta_ctx *utc, struct tee_obj *o);
@@ -12,7 +12,7 @@
 #include <tee/tee_fs.h>
 
 struct tee_pobj {
-	TAILQ_ENTRY(tee_pobj) link;
+	LIST_ENTRY(tee_pobj) link;
 	uint32_t refcnt;
 	TEE_UUID uuid;
 	void *obj_id;
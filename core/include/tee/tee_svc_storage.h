@@ -42,6 +42,15 @@ TEE_Result syscall_storage_start_enum(unsigned long obj_enum,
 TEE_Result syscall_storage_next_enum(unsigned long obj_enum,
 			TEE_ObjectInfo *info, void *obj_id, uint64_t *len);
 
+TEE_Result syscall_storage_next_enum_ids(unsigned long obj_enum,
+					 void *obj_ids, uint32_t *obj_id_lens,
+					 uint64_t *count);
+
+/*
+ * Persistent Object Transaction Functions
+ */
+TEE_Result syscall_storage_transaction(unsigned long op);
+
 /*
  * Data Stream Access Functions
  */
@@ -56,6 +65,8 @@ TEE_Result syscall_storage_obj_trunc(unsigned long obj, size_t len);
 TEE_Result syscall_storage_obj_seek(unsigned long obj, int32_t offset,
 				    unsigned long whence);
 
+TEE_Result syscall_storage_obj_sync(unsigned long obj);
+
 void tee_svc_storage_close_all_enum(struct user_ta_ctx *utc);
 
 void tee_svc_storage_init(void);
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#ifndef __TEE_TEE_SVC_STORAGE_CACHE_H
+#define __TEE_TEE_SVC_STORAGE_CACHE_H
+
+/*
+ * Cache of the head and attributes of persistent objects kept in secure
+ * memory, used to avoid reading them from storage each time an object is
+ * opened.
+ *
+ * Elements are identified by the TA UUID, the storage and the object ID of
+ * a persistent object. Only data read from an object which the storage has
+ * opened, and thus authenticated, is added. An element is used only once
+ * the storage has opened the object again. Elements are removed both
+ * before and after the object is created, renamed or deleted, so the
+ * previous head can neither be served nor added while the object changes.
+ */
+
+#include <compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tee/tee_pobj.h>
+
+#ifdef CFG_STORAGE_HEAD_CACHE
+/*
+ * tee_svc_storage_cache_get_gen() - get the current generation of the cache
+ *
+ * The generation is updated each time an element is removed. It's taken
+ * before the object is opened and passed to tee_svc_storage_cache_put()
+ * to not add data read before the object was changed.
+ */
+uint32_t tee_svc_storage_cache_get_gen(void);
+
+/*
+ * tee_svc_storage_cache_get() - look up the head of an object
+ * @po:		persistent object
+ * @data:	returns an allocated copy of the element, to be freed
+ * @len:	returns the size of @data
+ *
+ * Returns true if the element was found and @data allocated.
+ */
+bool tee_svc_storage_cache_get(const struct tee_pobj *po, void **data,
+			       size_t *len);
+
+/*
+ * tee_svc_storage_cache_put() - add or replace the head of an object
+ * @po:		persistent object
+ * @gen:	generation of the cache before @data was read
+ * @data:	head and attributes as stored
+ * @len:	size of @data
+ *
+ * The least recently used elements are evicted if needed, nothing is done
+ * if an element was removed since @gen or if there's not enough memory.
+ */
+void tee_svc_storage_cache_put(const struct tee_pobj *po, uint32_t gen,
+			       const void *data, size_t len);
+
+/* Removes the head of an object from the cache if present */
+void tee_svc_storage_cache_remove(const struct tee_pobj *po);
+#else
+static inline uint32_t tee_svc_storage_cache_get_gen(void)
+{
+	return 0;
+}
+
+static inline bool
+tee_svc_storage_cache_get(const struct tee_pobj *po __unused,
+			  void **data __unused, size_t *len __unused)
+{
+	return false;
+}
+
+static inline void
+tee_svc_storage_cache_put(const struct tee_pobj *po __unused,
+			  uint32_t gen __unused, const void *data __unused,
+			  size_t len __unused)
+{
+}
+
+static inline void
+tee_svc_storage_cache_remove(const struct tee_pobj *po __unused)
+{
+}
+#endif /*CFG_STORAGE_HEAD_CACHE*/
+
+#endif /*__TEE_TEE_SVC_STORAGE_CACHE_H*/
@@ -3,9 +3,12 @@
  * Copyright (c) 2017, Linaro Limited
  * Copyright (c) 2020, Arm Limited.
  */
+#include <arm.h>
+#include <config.h>
 #include <crypto/crypto.h>
 #include <initcall.h>
 #include <kernel/embedded_ts.h>
+#include <kernel/lz4.h>
 #include <kernel/ts_store.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,10 +18,26 @@
 #include <util.h>
 #include <zlib.h>
 
+/*
+ * @offs:	Offset in the (compressed) image
+ * @strm:	Inflate state for EMB_TS_COMPRESS_DEFLATE
+ * @uoffs:	Uncompressed offset of the next read (EMB_TS_COMPRESS_LZ4)
+ * @next_uoffs:	Uncompressed offset of the next block (EMB_TS_COMPRESS_LZ4)
+ * @blk_size:	Uncompressed size of the blocks (EMB_TS_COMPRESS_LZ4)
+ * @blk_buf:	Last block, when it could not be decoded in place
+ * @blk_len:	Number of bytes in @blk_buf, ending at @next_uoffs
+ * @decode_ticks: Counter ticks spent decompressing
+ */
 struct ts_store_handle {
 	const struct embedded_ts *ts;
 	size_t offs;
 	z_stream strm;
+	size_t uoffs;
+	size_t next_uoffs;
+	size_t blk_size;
+	uint8_t *blk_buf;
+	size_t blk_len;
+	uint64_t decode_ticks;
 };
 
 static void *zalloc(void *opaque __unused, unsigned int items,
@@ -50,6 +69,28 @@ static bool decompression_init(z_stream *strm,
 	return true;
 }
 
+static bool lz4_init(struct ts_store_handle *h, const struct embedded_ts *ts)
+{
+	uint32_t blk_size = 0;
+
+	if (ts->size < sizeof(blk_size))
+		return false;
+	memcpy(&blk_size, ts->ts, sizeof(blk_size));
+	if (!blk_size)
+		return false;
+
+	h->blk_size = blk_size;
+	h->offs = sizeof(blk_size);
+
+	return true;
+}
+
+static bool is_lz4(const struct embedded_ts *ts)
+{
+	return IS_ENABLED(CFG_EMBEDDED_TS_LZ4) &&
+	       ts->compression == EMB_TS_COMPRESS_LZ4;
+}
+
 TEE_Result emb_ts_open(const TEE_UUID *uuid,
 		       struct ts_store_handle **h,
 		       const struct embedded_ts*
@@ -67,7 +108,17 @@ TEE_Result emb_ts_open(const TEE_UUID *uuid,
 		return TEE_ERROR_OUT_OF_MEMORY;
 
 	if (ts->uncompressed_size) {
-		if (!decompression_init(&handle->strm, ts)) {
+		if (is_lz4(ts)) {
+			if (!lz4_init(handle, ts)) {
+				free(handle);
+				return TEE_ERROR_BAD_FORMAT;
+			}
+		} else if (ts->compression != EMB_TS_COMPRESS_DEFLATE) {
+			EMSG("Unsupported compression %"PRIu32,
+			     ts->compression);
+			free(handle);
+			return TEE_ERROR_NOT_SUPPORTED;
+		} else if (!decompression_init(&handle->strm, ts)) {
 			free(handle);
 			return TEE_ERROR_BAD_FORMAT;
 		}
@@ -198,18 +249,139 @@ out:
 	return ret;
 }
 
+/*
+ * Decodes the next LZ4 block, @ulen bytes, into @dst. The block is skipped
+ * if @dst is NULL.
+ */
+static TEE_Result lz4_read_block(struct ts_store_handle *h, void *dst,
+				 size_t ulen)
+{
+	const struct embedded_ts *ts = h->ts;
+	TEE_Result res = TEE_SUCCESS;
+	const uint8_t *src = NULL;
+	uint32_t csize = 0;
+	bool stored = false;
+
+	if (ts->size - h->offs < sizeof(csize))
+		return TEE_ERROR_CORRUPT_OBJECT;
+	memcpy(&csize, ts->ts + h->offs, sizeof(csize));
+	h->offs += sizeof(csize);
+
+	stored = csize & EMB_TS_LZ4_BLOCK_STORED;
+	csize &= ~EMB_TS_LZ4_BLOCK_STORED;
+	if (csize > ts->size - h->offs || (stored && csize != ulen))
+		return TEE_ERROR_CORRUPT_OBJECT;
+	src = ts->ts + h->offs;
+
+	if (dst) {
+		if (stored)
+			memcpy(dst, src, ulen);
+		else
+			res = lz4_decompress_block(src, csize, dst, ulen);
+		if (res) {
+			EMSG("Decompression error (%#"PRIx32")", res);
+			return res;
+		}
+	}
+
+	h->offs += csize;
+	h->next_uoffs += ulen;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Blocks fully covered by the read are decoded directly into @data, or
+ * skipped without being decoded if @data is NULL. Only a block which is
+ * partially read goes through @blk_buf.
+ */
+static TEE_Result read_lz4(struct ts_store_handle *h, void *data, size_t len)
+{
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *dst = data;
+	size_t next_offs = 0;
+	size_t ulen = 0;
+	size_t n = 0;
+
+	if (ADD_OVERFLOW(h->uoffs, len, &next_offs) ||
+	    next_offs > h->ts->uncompressed_size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	while (len) {
+		if (h->uoffs < h->next_uoffs) {
+			n = MIN(len, h->next_uoffs - h->uoffs);
+			if (dst) {
+				memcpy(dst, h->blk_buf + h->blk_len -
+					    (h->next_uoffs - h->uoffs), n);
+				dst += n;
+			}
+			h->uoffs += n;
+			len -= n;
+			continue;
+		}
+
+		ulen = MIN(h->blk_size,
+			   h->ts->uncompressed_size - h->next_uoffs);
+		if (len >= ulen) {
+			res = lz4_read_block(h, dst, ulen);
+			if (res)
+				return res;
+			if (dst)
+				dst += ulen;
+			h->uoffs += ulen;
+			h->blk_len = 0;
+			len -= ulen;
+		} else {
+			if (!h->blk_buf) {
+				h->blk_buf = malloc(h->blk_size);
+				if (!h->blk_buf)
+					return TEE_ERROR_OUT_OF_MEMORY;
+			}
+			res = lz4_read_block(h, h->blk_buf, ulen);
+			if (res)
+				return res;
+			h->blk_len = ulen;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
 TEE_Result emb_ts_read(struct ts_store_handle *h, void *data, size_t len)
 {
-	if (h->ts->uncompressed_size)
-		return read_compressed(h, data, len);
-	else
+	TEE_Result res = TEE_SUCCESS;
+	uint64_t t = 0;
+
+	if (!h->ts->uncompressed_size)
 		return read_uncompressed(h, data, len);
+
+	t = barrier_read_counter_timer();
+	if (is_lz4(h->ts))
+		res = read_lz4(h, data, len);
+	else
+		res = read_compressed(h, data, len);
+	h->decode_ticks += barrier_read_counter_timer() - t;
+
+	return res;
 }
 
 void emb_ts_close(struct ts_store_handle *h)
 {
-	if (h->ts->uncompressed_size)
-		inflateEnd(&h->strm);
+	const struct embedded_ts *ts = h->ts;
+	size_t __maybe_unused out = 0;
+
+	if (ts->uncompressed_size) {
+		if (is_lz4(ts)) {
+			out = h->uoffs;
+			free(h->blk_buf);
+		} else {
+			out = h->strm.total_out;
+			inflateEnd(&h->strm);
+		}
+		IMSG("%pUl: %zu bytes %s decompressed in %"PRIu64" us",
+		     (void *)&ts->uuid, out, is_lz4(ts) ? "LZ4" : "zlib",
+		     (h->decode_ticks * 1000000) / read_cntfrq());
+	}
 	free(h);
 }
 
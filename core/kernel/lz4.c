@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+/*
+ * Decoder for the LZ4 block format, see
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * Each sequence is a token, the literals and a match referring to the
+ * data already decompressed. The last sequence only has literals.
+ */
+
+#include <kernel/lz4.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH	4
+
+/* Reads the extra bytes of a length field, returns false on overrun */
+static bool read_len(const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+	uint8_t b = 0;
+
+	do {
+		if (*ip >= iend)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+
+	return true;
+}
+
+TEE_Result lz4_decompress_block(const void *src, size_t src_len, void *dst,
+				size_t dst_len)
+{
+	const uint8_t *ip = src;
+	const uint8_t *iend = ip + src_len;
+	uint8_t *op = dst;
+	uint8_t *oend = op + dst_len;
+	const uint8_t *match = NULL;
+	size_t offs = 0;
+	size_t len = 0;
+	uint8_t token = 0;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15 && !read_len(&ip, iend, &len))
+			return TEE_ERROR_CORRUPT_OBJECT;
+		if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+			return TEE_ERROR_CORRUPT_OBJECT;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return TEE_ERROR_CORRUPT_OBJECT;
+		offs = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offs || offs > (size_t)(op - (uint8_t *)dst))
+			return TEE_ERROR_CORRUPT_OBJECT;
+
+		len = token & 0xf;
+		if (len == 15 && !read_len(&ip, iend, &len))
+			return TEE_ERROR_CORRUPT_OBJECT;
+		len += LZ4_MIN_MATCH;
+		if (len > (size_t)(oend - op))
+			return TEE_ERROR_CORRUPT_OBJECT;
+
+		match = op - offs;
+		if (offs >= len) {
+			memcpy(op, match, len);
+			op += len;
+		} else {
+			/* Overlapping copy, repeats the last @offs bytes */
+			while (len--)
+				*op++ = *match++;
+		}
+	}
+
+	if (op != oend)
+		return TEE_ERROR_CORRUPT_OBJECT;
+
+	return TEE_SUCCESS;
+}
@@ -33,11 +33,22 @@
  * OP-TEE core needs to do authenticated decryption of TA to retrieve its
  * contents. Here encryption provides the confidentiality of TA and MAC tag
  * provides the integrity of encrypted TA blob.
+ *
+ * Compressed TAs
+ * --------------
+ *
+ * With CFG_REE_FS_TA_COMPRESSED=y a TA may be transferred zlib compressed
+ * (SHDR_COMPRESSED_TA). The signed hash covers the decompressed TA, so the
+ * security properties are the same as for a plain signed TA. The payload
+ * is decompressed in a streaming fashion from a secure copy of the shared
+ * memory, and hashed as it is written to its final destination.
  */
 
 #include <assert.h>
+#include <config.h>
 #include <crypto/crypto.h>
 #include <initcall.h>
+#include <kernel/mutex.h>
 #include <kernel/thread.h>
 #include <kernel/ts_store.h>
 #include <mm/core_memprot.h>
@@ -47,6 +58,7 @@
 #include <signed_hdr.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/queue.h>
 #include <tee_api_defines_extensions.h>
 #include <tee_api_types.h>
 #include <tee/tee_pobj.h>
@@ -54,6 +66,12 @@
 #include <tee/tee_ta_enc_manager.h>
 #include <tee/uuid.h>
 #include <utee_defines.h>
+#ifdef CFG_REE_FS_TA_COMPRESSED
+#include <zlib.h>
+#endif
+
+/* Size of the secure copies of the compressed input fed to inflate() */
+#define COMPRESSED_CHUNK_SIZE	4096
 
 struct ree_fs_ta_handle {
 	struct shdr *nw_ta; /* Non-secure (shared memory) */
@@ -65,6 +83,12 @@ struct ree_fs_ta_handle {
 	void *enc_ctx;
 	struct shdr_bootstrap_ta *bs_hdr;
 	struct shdr_encrypted_ta *ehdr;
+#ifdef CFG_REE_FS_TA_COMPRESSED
+	struct shdr_compressed_ta *chdr;
+	z_stream strm;
+	uint8_t *zbuf; /* Secure copy of a chunk of compressed input */
+	size_t uoffs; /* Offset in the decompressed TA */
+#endif
 };
 
 struct ta_ver_db_hdr {
@@ -75,6 +99,89 @@ struct ta_ver_db_hdr {
 static const char ta_ver_db_obj_id[] = "ta_ver.db";
 static struct mutex ta_ver_db_mutex = MUTEX_INITIALIZER;
 
+#ifdef CFG_REE_FS_TA_COMPRESSED
+static void *zalloc(void *opaque __unused, unsigned int items,
+		    unsigned int size)
+{
+	size_t sz = 0;
+
+	if (MUL_OVERFLOW(items, size, &sz))
+		return NULL;
+	return malloc(sz);
+}
+
+static void zfree(void *opaque __unused, void *address)
+{
+	free(address);
+}
+
+static TEE_Result decompress_init(struct ree_fs_ta_handle *h,
+				  const struct shdr *ta, size_t ta_size,
+				  size_t offs, void *hash_ctx)
+{
+	struct shdr_compressed_ta *chdr = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *zbuf = NULL;
+	size_t sz = 0;
+
+	if (ADD_OVERFLOW(offs, sizeof(*chdr), &sz) || ta_size < sz)
+		return TEE_ERROR_SECURITY;
+
+	chdr = malloc(sizeof(*chdr));
+	zbuf = malloc(COMPRESSED_CHUNK_SIZE);
+	if (!chdr || !zbuf) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto err;
+	}
+
+	memcpy(chdr, (uint8_t *)ta + offs, sizeof(*chdr));
+	if (chdr->comp_algo != SHDR_COMP_ALGO_ZLIB ||
+	    !chdr->uncompressed_size) {
+		res = TEE_ERROR_SECURITY;
+		goto err;
+	}
+
+	res = crypto_hash_update(hash_ctx, (uint8_t *)chdr, sizeof(*chdr));
+	if (res)
+		goto err;
+
+	h->strm.zalloc = zalloc;
+	h->strm.zfree = zfree;
+	if (inflateInit(&h->strm) != Z_OK) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto err;
+	}
+
+	h->chdr = chdr;
+	h->zbuf = zbuf;
+	return TEE_SUCCESS;
+err:
+	free(chdr);
+	free(zbuf);
+	return res;
+}
+
+static void decompress_final(struct ree_fs_ta_handle *h)
+{
+	if (h->chdr)
+		inflateEnd(&h->strm);
+	free(h->chdr);
+	free(h->zbuf);
+}
+#else
+static TEE_Result decompress_init(struct ree_fs_ta_handle *h __unused,
+				  const struct shdr *ta __unused,
+				  size_t ta_size __unused, size_t offs __unused,
+				  void *hash_ctx __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+static void decompress_final(struct ree_fs_ta_handle *h __unused)
+{
+}
+#endif /*CFG_REE_FS_TA_COMPRESSED*/
+
 /*
  * Load a TA via RPC with UUID defined by input param @uuid. The virtual
  * address of the raw TA binary is received in out parameter @ta.
@@ -124,15 +231,19 @@ exit:
 	return res;
 }
 
-static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
-				 struct ts_store_handle **h)
+/*
+ * Prepares reading and verifying a TA image already loaded via RPC in
+ * @ta/@mobj. Ownership of @mobj is transferred to the returned handle, or
+ * the payload is freed on error.
+ */
+static TEE_Result ree_fs_ta_open_payload(const TEE_UUID *uuid,
+					 struct shdr *ta, size_t ta_size,
+					 struct mobj *mobj,
+					 struct ts_store_handle **h)
 {
 	struct ree_fs_ta_handle *handle;
 	struct shdr *shdr = NULL;
-	struct mobj *mobj = NULL;
 	void *hash_ctx = NULL;
-	struct shdr *ta = NULL;
-	size_t ta_size = 0;
 	TEE_Result res = TEE_SUCCESS;
 	size_t offs = 0;
 	struct shdr_bootstrap_ta *bs_hdr = NULL;
@@ -140,13 +251,10 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 	size_t shdr_sz = 0;
 
 	handle = calloc(1, sizeof(*handle));
-	if (!handle)
-		return TEE_ERROR_OUT_OF_MEMORY;
-
-	/* Request TA from tee-supplicant */
-	res = rpc_load(uuid, &ta, &ta_size, &mobj);
-	if (res != TEE_SUCCESS)
-		goto error;
+	if (!handle) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto error_free_payload;
+	}
 
 	/* Make secure copy of signed header */
 	shdr = shdr_alloc_and_copy(ta, ta_size);
@@ -160,7 +268,9 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 	if (res != TEE_SUCCESS)
 		goto error_free_payload;
 	if (shdr->img_type != SHDR_TA && shdr->img_type != SHDR_BOOTSTRAP_TA &&
-	    shdr->img_type != SHDR_ENCRYPTED_TA) {
+	    shdr->img_type != SHDR_ENCRYPTED_TA &&
+	    (shdr->img_type != SHDR_COMPRESSED_TA ||
+	     !IS_ENABLED(CFG_REE_FS_TA_COMPRESSED))) {
 		res = TEE_ERROR_SECURITY;
 		goto error_free_payload;
 	}
@@ -187,7 +297,8 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 	offs = shdr_sz;
 
 	if (shdr->img_type == SHDR_BOOTSTRAP_TA ||
-	    shdr->img_type == SHDR_ENCRYPTED_TA) {
+	    shdr->img_type == SHDR_ENCRYPTED_TA ||
+	    shdr->img_type == SHDR_COMPRESSED_TA) {
 		TEE_UUID bs_uuid = { };
 		size_t sz = shdr_sz;
 
@@ -267,6 +378,13 @@ static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
 		handle->ehdr = ehdr;
 	}
 
+	if (shdr->img_type == SHDR_COMPRESSED_TA) {
+		res = decompress_init(handle, ta, ta_size, offs, hash_ctx);
+		if (res != TEE_SUCCESS)
+			goto error_free_hash;
+		offs += sizeof(struct shdr_compressed_ta);
+	}
+
 	if (ta_size != offs + shdr->img_size) {
 		res = TEE_ERROR_SECURITY;
 		goto error_free_hash;
@@ -285,7 +403,8 @@ error_free_hash:
 	crypto_hash_free_ctx(hash_ctx);
 error_free_payload:
 	thread_rpc_free_payload(mobj);
-error:
+	if (handle)
+		decompress_final(handle);
 	free(ehdr);
 	free(bs_hdr);
 	shdr_free(shdr);
@@ -298,6 +417,12 @@ static TEE_Result ree_fs_ta_get_size(const struct ts_store_handle *h,
 {
 	struct ree_fs_ta_handle *handle = (struct ree_fs_ta_handle *)h;
 
+#ifdef CFG_REE_FS_TA_COMPRESSED
+	if (handle->chdr) {
+		*size = handle->chdr->uncompressed_size;
+		return TEE_SUCCESS;
+	}
+#endif
 	*size = handle->shdr->img_size;
 	return TEE_SUCCESS;
 }
@@ -431,6 +556,123 @@ out:
 	return res;
 }
 
+static TEE_Result ree_fs_ta_read_final(struct ree_fs_ta_handle *handle)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	if (handle->shdr->img_type == SHDR_ENCRYPTED_TA) {
+		/*
+		 * Last read: time to finalize authenticated
+		 * decryption.
+		 */
+		res = tee_ta_decrypt_final(handle->enc_ctx,
+					   handle->ehdr, NULL, NULL, 0);
+		if (res != TEE_SUCCESS)
+			return TEE_ERROR_SECURITY;
+	}
+	/*
+	 * Last read: time to check if our digest matches the expected
+	 * one (from the signed header)
+	 */
+	res = check_digest(handle);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	if (handle->bs_hdr)
+		res = check_update_version(handle->bs_hdr);
+
+	return res;
+}
+
+#ifdef CFG_REE_FS_TA_COMPRESSED
+static TEE_Result read_compressed(struct ree_fs_ta_handle *h, void *data,
+				  size_t len)
+{
+	z_stream *strm = &h->strm;
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *tmpbuf = NULL;
+	size_t next_offs = 0;
+	size_t total = 0;
+	size_t out = 0;
+	size_t n = 0;
+	int st = Z_OK;
+
+	if (ADD_OVERFLOW(h->uoffs, len, &next_offs) ||
+	    next_offs > h->chdr->uncompressed_size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (!data) {
+		/*
+		 * inflate() does not support a NULL strm->next_out and the
+		 * skipped data must be hashed anyway.
+		 */
+		tmpbuf = malloc(MIN(len, (size_t)COMPRESSED_CHUNK_SIZE));
+		if (!tmpbuf)
+			return TEE_ERROR_OUT_OF_MEMORY;
+	}
+
+	while (total < len) {
+		if (!strm->avail_in) {
+			n = MIN(h->nw_ta_size - h->offs,
+				(size_t)COMPRESSED_CHUNK_SIZE);
+			if (!n) {
+				/* Compressed stream is truncated */
+				res = TEE_ERROR_SECURITY;
+				break;
+			}
+			/* Decompress a secure copy, shm might be modified */
+			memcpy(h->zbuf, (uint8_t *)h->nw_ta + h->offs, n);
+			h->offs += n;
+			strm->next_in = h->zbuf;
+			strm->avail_in = n;
+		}
+
+		if (data) {
+			strm->next_out = (uint8_t *)data + total;
+			strm->avail_out = len - total;
+		} else {
+			strm->next_out = tmpbuf;
+			strm->avail_out = MIN(len - total,
+					      (size_t)COMPRESSED_CHUNK_SIZE);
+		}
+
+		out = strm->total_out;
+		st = inflate(strm, Z_NO_FLUSH);
+		out = strm->total_out - out;
+
+		/* Hash secure buffer */
+		if (out) {
+			res = crypto_hash_update(h->hash_ctx,
+						 strm->next_out - out, out);
+			if (res)
+				break;
+			total += out;
+		}
+
+		/*
+		 * Z_BUF_ERROR only means that no progress was possible,
+		 * which is expected when the input chunk has been consumed.
+		 */
+		if ((st != Z_OK && st != Z_STREAM_END && st != Z_BUF_ERROR) ||
+		    (st == Z_STREAM_END && total != len) ||
+		    (st == Z_BUF_ERROR && strm->avail_in)) {
+			EMSG("Decompression error (%d)", st);
+			res = TEE_ERROR_SECURITY;
+			break;
+		}
+	}
+
+	free(tmpbuf);
+	if (res != TEE_SUCCESS)
+		return TEE_ERROR_SECURITY;
+
+	h->uoffs = next_offs;
+	if (h->uoffs == h->chdr->uncompressed_size)
+		res = ree_fs_ta_read_final(h);
+	return res;
+}
+#endif /*CFG_REE_FS_TA_COMPRESSED*/
+
 static TEE_Result ree_fs_ta_read(struct ts_store_handle *h, void *data,
 				 size_t len)
 {
@@ -441,6 +683,11 @@ static TEE_Result ree_fs_ta_read(struct ts_store_handle *h, void *data,
 	uint8_t *dst = src;
 	TEE_Result res = TEE_SUCCESS;
 
+#ifdef CFG_REE_FS_TA_COMPRESSED
+	if (handle->chdr)
+		return read_compressed(handle, data, len);
+#endif
+
 	if (ADD_OVERFLOW(handle->offs, len, &next_offs) ||
 	    next_offs > handle->nw_ta_size)
 		return TEE_ERROR_BAD_PARAMETERS;
@@ -492,28 +739,8 @@ static TEE_Result ree_fs_ta_read(struct ts_store_handle *h, void *data,
 	}
 
 	handle->offs = next_offs;
-	if (handle->offs == handle->nw_ta_size) {
-		if (handle->shdr->img_type == SHDR_ENCRYPTED_TA) {
-			/*
-			 * Last read: time to finalize authenticated
-			 * decryption.
-			 */
-			res = tee_ta_decrypt_final(handle->enc_ctx,
-						   handle->ehdr, NULL, NULL, 0);
-			if (res != TEE_SUCCESS)
-				return TEE_ERROR_SECURITY;
-		}
-		/*
-		 * Last read: time to check if our digest matches the expected
-		 * one (from the signed header)
-		 */
-		res = check_digest(handle);
-		if (res != TEE_SUCCESS)
-			return res;
-
-		if (handle->bs_hdr)
-			res = check_update_version(handle->bs_hdr);
-	}
+	if (handle->offs == handle->nw_ta_size)
+		res = ree_fs_ta_read_final(handle);
 	return res;
 }
 
@@ -525,6 +752,7 @@ static void ree_fs_ta_close(struct ts_store_handle *h)
 		return;
 	thread_rpc_free_payload(handle->mobj);
 	crypto_hash_free_ctx(handle->hash_ctx);
+	decompress_final(handle);
 	free(handle->shdr);
 	free(handle->ehdr);
 	free(handle->bs_hdr);
@@ -532,6 +760,22 @@ static void ree_fs_ta_close(struct ts_store_handle *h)
 }
 
 #ifndef CFG_REE_FS_TA_BUFFERED
+static TEE_Result ree_fs_ta_open(const TEE_UUID *uuid,
+				 struct ts_store_handle **h)
+{
+	struct mobj *mobj = NULL;
+	struct shdr *ta = NULL;
+	size_t ta_size = 0;
+	TEE_Result res = TEE_SUCCESS;
+
+	/* Request TA from tee-supplicant */
+	res = rpc_load(uuid, &ta, &ta_size, &mobj);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	return ree_fs_ta_open_payload(uuid, ta, ta_size, mobj, h);
+}
+
 REGISTER_TA_STORE(9) = {
 	.description = "REE",
 	.open = ree_fs_ta_open,
@@ -549,71 +793,265 @@ REGISTER_TA_STORE(9) = {
  * The whole TA/library is read into a temporary buffer during .open(). This
  * allows the binary to be authenticated before any data is read and processed
  * by the upper layer (ELF loader).
+ *
+ * With CFG_REE_FS_TA_CACHE=y the buffers holding verified (and decrypted)
+ * images are kept in a bounded LRU cache. The image is still requested
+ * from tee-supplicant on each open since the REE may replace it at any
+ * time, but if the signed header is identical to the one of a cached
+ * image the cached copy is used. The signature verification, hashing and
+ * decryption are skipped in that case. The signed header covers the hash
+ * of the whole image so an identical header means an identical image.
+ * Loading another image with the same UUID, for instance when a new
+ * version is installed, replaces the cached entry.
  */
 
-struct buf_ree_fs_ta_handle {
-	struct ts_store_handle *h; /* Note: a REE FS TA store handle */
+struct buf_ta_img {
+	TEE_UUID uuid;
+	struct shdr *shdr; /* Verified signed header */
 	size_t ta_size;
 	tee_mm_entry_t *mm;
 	uint8_t *buf;
-	size_t offs;
 	uint8_t *tag;
 	unsigned int tag_len;
+	unsigned int refcount;
+	TAILQ_ENTRY(buf_ta_img) link;
 };
 
-static TEE_Result buf_ta_open(const TEE_UUID *uuid,
-			      struct ts_store_handle **h)
+struct buf_ree_fs_ta_handle {
+	struct buf_ta_img *img;
+	size_t offs;
+};
+
+static void buf_ta_img_free(struct buf_ta_img *img)
 {
-	struct buf_ree_fs_ta_handle *handle = NULL;
+	if (!img)
+		return;
+	tee_mm_free(img->mm);
+	shdr_free(img->shdr);
+	free(img->tag);
+	free(img);
+}
+
+#ifdef CFG_REE_FS_TA_CACHE
+/* Most recently used images first */
+static TAILQ_HEAD(buf_ta_img_head, buf_ta_img) ta_cache =
+	TAILQ_HEAD_INITIALIZER(ta_cache);
+static struct mutex ta_cache_mu = MUTEX_INITIALIZER;
+static size_t ta_cache_size;
+static size_t ta_cache_count;
+
+/* Called with ta_cache_mu held */
+static void ta_cache_put(struct buf_ta_img *img)
+{
+	assert(img->refcount);
+	img->refcount--;
+	if (!img->refcount)
+		buf_ta_img_free(img);
+}
+
+/* Called with ta_cache_mu held */
+static void ta_cache_remove(struct buf_ta_img *img)
+{
+	TAILQ_REMOVE(&ta_cache, img, link);
+	ta_cache_size -= img->ta_size;
+	ta_cache_count--;
+	ta_cache_put(img);
+}
+
+/*
+ * Returns a cached image matching the signed header of the image in @ta
+ * or NULL.
+ */
+static struct buf_ta_img *ta_cache_get(const TEE_UUID *uuid,
+				       const struct shdr *ta, size_t ta_size)
+{
+	struct buf_ta_img *img = NULL;
+	struct shdr *shdr = NULL;
+
+	/* Compare a stable secure copy, @ta is in shared memory */
+	shdr = shdr_alloc_and_copy(ta, ta_size);
+	if (!shdr)
+		return NULL;
+
+	mutex_lock(&ta_cache_mu);
+	TAILQ_FOREACH(img, &ta_cache, link)
+		if (!memcmp(&img->uuid, uuid, sizeof(*uuid)))
+			break;
+
+	if (img) {
+		if (SHDR_GET_SIZE(img->shdr) == SHDR_GET_SIZE(shdr) &&
+		    !memcmp(img->shdr, shdr, SHDR_GET_SIZE(shdr))) {
+			TAILQ_REMOVE(&ta_cache, img, link);
+			TAILQ_INSERT_HEAD(&ta_cache, img, link);
+			img->refcount++;
+		} else {
+			/* Stale image, a new one is about to be loaded */
+			ta_cache_remove(img);
+			img = NULL;
+		}
+	}
+	mutex_unlock(&ta_cache_mu);
+
+	shdr_free(shdr);
+	return img;
+}
+
+static void ta_cache_add(struct buf_ta_img *img)
+{
+	struct buf_ta_img *i = NULL;
+
+	if (!CFG_REE_FS_TA_CACHE_ENTRIES ||
+	    img->ta_size > CFG_REE_FS_TA_CACHE_SIZE)
+		return;
+
+	mutex_lock(&ta_cache_mu);
+
+	/* Another thread may have loaded the same TA concurrently */
+	TAILQ_FOREACH(i, &ta_cache, link) {
+		if (!memcmp(&i->uuid, &img->uuid, sizeof(img->uuid))) {
+			ta_cache_remove(i);
+			break;
+		}
+	}
+
+	while (ta_cache_count >= CFG_REE_FS_TA_CACHE_ENTRIES ||
+	       ta_cache_size + img->ta_size > CFG_REE_FS_TA_CACHE_SIZE)
+		ta_cache_remove(TAILQ_LAST(&ta_cache, buf_ta_img_head));
+
+	img->refcount++;
+	TAILQ_INSERT_HEAD(&ta_cache, img, link);
+	ta_cache_size += img->ta_size;
+	ta_cache_count++;
+
+	mutex_unlock(&ta_cache_mu);
+}
+
+static void buf_ta_img_put(struct buf_ta_img *img)
+{
+	mutex_lock(&ta_cache_mu);
+	ta_cache_put(img);
+	mutex_unlock(&ta_cache_mu);
+}
+#else
+static struct buf_ta_img *ta_cache_get(const TEE_UUID *uuid __unused,
+				       const struct shdr *ta __unused,
+				       size_t ta_size __unused)
+{
+	return NULL;
+}
+
+static void ta_cache_add(struct buf_ta_img *img __unused)
+{
+}
+
+static void buf_ta_img_put(struct buf_ta_img *img)
+{
+	buf_ta_img_free(img);
+}
+#endif /*CFG_REE_FS_TA_CACHE*/
+
+static TEE_Result buf_ta_img_load(const TEE_UUID *uuid, struct shdr *ta,
+				  size_t ta_size, struct mobj *mobj,
+				  struct buf_ta_img **img_ret)
+{
+	struct ree_fs_ta_handle *rh = NULL;
+	struct ts_store_handle *h = NULL;
+	struct buf_ta_img *img = NULL;
 	TEE_Result res = TEE_SUCCESS;
 
-	handle = calloc(1, sizeof(*handle));
-	if (!handle)
+	img = calloc(1, sizeof(*img));
+	if (!img) {
+		thread_rpc_free_payload(mobj);
 		return TEE_ERROR_OUT_OF_MEMORY;
-	res = ree_fs_ta_open(uuid, &handle->h);
+	}
+	img->uuid = *uuid;
+	img->refcount = 1;
+
+	res = ree_fs_ta_open_payload(uuid, ta, ta_size, mobj, &h);
 	if (res)
 		goto err2;
-	res = ree_fs_ta_get_size(handle->h, &handle->ta_size);
+	res = ree_fs_ta_get_size(h, &img->ta_size);
 	if (res)
 		goto err;
 
-	res = ree_fs_ta_get_tag(handle->h, NULL, &handle->tag_len);
+	res = ree_fs_ta_get_tag(h, NULL, &img->tag_len);
 	if (res != TEE_ERROR_SHORT_BUFFER) {
 		res = TEE_ERROR_GENERIC;
 		goto err;
 	}
-	handle->tag = malloc(handle->tag_len);
-	if (!handle->tag) {
+	img->tag = malloc(img->tag_len);
+	if (!img->tag) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	res = ree_fs_ta_get_tag(handle->h, handle->tag, &handle->tag_len);
+	res = ree_fs_ta_get_tag(h, img->tag, &img->tag_len);
 	if (res)
 		goto err;
 
-	handle->mm = tee_mm_alloc(&tee_mm_sec_ddr, handle->ta_size);
-	if (!handle->mm) {
+	rh = (struct ree_fs_ta_handle *)h;
+	img->shdr = shdr_alloc_and_copy(rh->shdr, SHDR_GET_SIZE(rh->shdr));
+	if (!img->shdr) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	handle->buf = phys_to_virt(tee_mm_get_smem(handle->mm),
-				   MEM_AREA_TA_RAM, handle->ta_size);
-	if (!handle->buf) {
+
+	img->mm = tee_mm_alloc(&tee_mm_sec_ddr, img->ta_size);
+	if (!img->mm) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto err;
 	}
-	res = ree_fs_ta_read(handle->h, handle->buf, handle->ta_size);
+	img->buf = phys_to_virt(tee_mm_get_smem(img->mm), MEM_AREA_TA_RAM,
+				img->ta_size);
+	if (!img->buf) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto err;
+	}
+	res = ree_fs_ta_read(h, img->buf, img->ta_size);
 	if (res)
 		goto err;
-	*h = (struct ts_store_handle *)handle;
+	*img_ret = img;
 err:
-	ree_fs_ta_close(handle->h);
+	ree_fs_ta_close(h);
 err2:
-	if (res) {
-		tee_mm_free(handle->mm);
-		free(handle->tag);
-		free(handle);
+	if (res)
+		buf_ta_img_free(img);
+	return res;
+}
+
+static TEE_Result buf_ta_open(const TEE_UUID *uuid,
+			      struct ts_store_handle **h)
+{
+	struct buf_ree_fs_ta_handle *handle = NULL;
+	struct buf_ta_img *img = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	struct mobj *mobj = NULL;
+	struct shdr *ta = NULL;
+	size_t ta_size = 0;
+
+	handle = calloc(1, sizeof(*handle));
+	if (!handle)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	/* Request TA from tee-supplicant */
+	res = rpc_load(uuid, &ta, &ta_size, &mobj);
+	if (res)
+		goto err;
+
+	img = ta_cache_get(uuid, ta, ta_size);
+	if (img) {
+		thread_rpc_free_payload(mobj);
+	} else {
+		res = buf_ta_img_load(uuid, ta, ta_size, mobj, &img);
+		if (res)
+			goto err;
+		ta_cache_add(img);
 	}
+
+	handle->img = img;
+	*h = (struct ts_store_handle *)handle;
+	return TEE_SUCCESS;
+err:
+	free(handle);
 	return res;
 }
 
@@ -622,7 +1060,7 @@ static TEE_Result buf_ta_get_size(const struct ts_store_handle *h,
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
 
-	*size = handle->ta_size;
+	*size = handle->img->ta_size;
 	return TEE_SUCCESS;
 }
 
@@ -630,11 +1068,11 @@ static TEE_Result buf_ta_read(struct ts_store_handle *h, void *data,
 			      size_t len)
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
-	uint8_t *src = handle->buf + handle->offs;
+	uint8_t *src = handle->img->buf + handle->offs;
 	size_t next_offs = 0;
 
 	if (ADD_OVERFLOW(handle->offs, len, &next_offs) ||
-	    next_offs > handle->ta_size)
+	    next_offs > handle->img->ta_size)
 		return TEE_ERROR_BAD_PARAMETERS;
 
 	if (data)
@@ -647,12 +1085,13 @@ static TEE_Result buf_ta_get_tag(const struct ts_store_handle *h,
 				 uint8_t *tag, unsigned int *tag_len)
 {
 	struct buf_ree_fs_ta_handle *handle = (struct buf_ree_fs_ta_handle *)h;
+	struct buf_ta_img *img = handle->img;
 
-	*tag_len = handle->tag_len;
-	if (!tag || *tag_len < handle->tag_len)
+	*tag_len = img->tag_len;
+	if (!tag || *tag_len < img->tag_len)
 		return TEE_ERROR_SHORT_BUFFER;
 
-	memcpy(tag, handle->tag, handle->tag_len);
+	memcpy(tag, img->tag, img->tag_len);
 
 	return TEE_SUCCESS;
 }
@@ -663,13 +1102,16 @@ static void buf_ta_close(struct ts_store_handle *h)
 
 	if (!handle)
 		return;
-	tee_mm_free(handle->mm);
-	free(handle->tag);
+	buf_ta_img_put(handle->img);
 	free(handle);
 }
 
 REGISTER_TA_STORE(9) = {
+#ifdef CFG_REE_FS_TA_CACHE
+	.description = "REE [cached]",
+#else
 	.description = "REE [buffered]",
+#endif
 	.open = buf_ta_open,
 	.get_size = buf_ta_get_size,
 	.get_tag = buf_ta_get_tag,
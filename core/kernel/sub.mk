@@ -38,4 +38,5 @@ srcs-$(CFG_SECSTOR_TA) += secstor_ta.c
 endif
 
 srcs-$(CFG_EMBEDDED_TS) += embedded_ts.c
+srcs-$(CFG_EMBEDDED_TS_LZ4) += lz4.c
 srcs-y += pseudo_ta.c
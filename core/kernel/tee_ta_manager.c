@@ -6,6 +6,7 @@
 
 #include <arm.h>
 #include <assert.h>
+#include <bench.h>
 #include <kernel/mutex.h>
 #include <kernel/panic.h>
 #include <kernel/pseudo_ta.h>
@@ -544,7 +545,9 @@ TEE_Result tee_ta_close_session(struct tee_ta_session *csess,
 	} else {
 		tee_ta_set_busy(ctx);
 		set_invoke_timeout(sess, TEE_TIMEOUT_INFINITE);
+		bm_stage(BM_STAGE_TA_ENTRY);
 		ts_ctx->ops->enter_close_session(&sess->ts_sess);
+		bm_stage(BM_STAGE_TA_RETURN);
 		destroy_session(sess, open_sessions);
 		tee_ta_clear_busy(ctx);
 	}
@@ -742,7 +745,9 @@ TEE_Result tee_ta_open_session(TEE_ErrorOrigin *err,
 	if (tee_ta_try_set_busy(ctx)) {
 		s->param = param;
 		set_invoke_timeout(s, cancel_req_to);
+		bm_stage(BM_STAGE_TA_ENTRY);
 		res = ts_ctx->ops->enter_open_session(&s->ts_sess);
+		bm_stage(BM_STAGE_TA_RETURN);
 		tee_ta_clear_busy(ctx);
 	} else {
 		/* Deadlock avoided */
@@ -807,7 +812,9 @@ TEE_Result tee_ta_invoke_command(TEE_ErrorOrigin *err,
 
 	sess->param = param;
 	set_invoke_timeout(sess, cancel_req_to);
+	bm_stage(BM_STAGE_TA_ENTRY);
 	res = ts_ctx->ops->enter_invoke_cmd(&sess->ts_sess, cmd);
+	bm_stage(BM_STAGE_TA_RETURN);
 
 	sess->param = NULL;
 	tee_ta_clear_busy(ta_ctx);
@@ -962,6 +969,9 @@ static void ftrace_update_times(bool suspend)
 	} else {
 		for (i = 0; i <= fbuf->ret_idx; i++)
 			fbuf->begin_time[i] += now - fbuf->suspend_time;
+		/* Don't account suspended time in the next record delta */
+		if (fbuf->last_time)
+			fbuf->last_time += now - fbuf->suspend_time;
 	}
 }
 
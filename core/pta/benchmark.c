@@ -2,11 +2,15 @@
 /*
  * Copyright (c) 2017, Linaro Limited
  */
+#include <arm.h>
 #include <bench.h>
 #include <compiler.h>
+#include <kernel/linker.h>
 #include <kernel/misc.h>
 #include <kernel/mutex.h>
 #include <kernel/pseudo_ta.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <malloc.h>
 #include <mm/core_memprot.h>
 #include <mm/mobj.h>
@@ -29,6 +33,37 @@ static size_t bench_ts_size;
 static struct mutex bench_reg_mu = MUTEX_INITIALIZER;
 static struct mobj *bench_mobj;
 
+/*
+ * Latency histograms of standard calls
+ *
+ * Bucket i < 4 holds the value i (in counter ticks), above that each power
+ * of two is split in 4 sub-buckets, which gives a resolution better than
+ * 25% on the reported percentiles.
+ */
+#define LAT_NUM_BUCKETS		U(128)
+#define LAT_SUB_BITS		U(2)
+
+struct lat_hist {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint32_t bucket[LAT_NUM_BUCKETS];
+};
+
+/* Timestamps of the standard call served by a thread */
+struct lat_call {
+	uint64_t stamp[BM_STAGE_RETURN + 1];
+	uint64_t rpc_start;
+	uint64_t rpc_time;	/* Sum of all RPCs */
+	uint64_t ta_rpc_time;	/* Sum of RPCs issued from the TA */
+	uint32_t cmd;
+};
+
+static struct lat_hist lat_hist[BENCHMARK_LAT_CMD_COUNT][BENCHMARK_LAT_COUNT];
+static struct lat_call lat_call[CFG_NUM_THREADS];
+static uint64_t lat_smc_entry[CFG_TEE_CORE_NB_CORE];
+static unsigned int lat_lock = SPINLOCK_UNLOCK;
+
 static TEE_Result rpc_reg_global_buf(uint64_t type, paddr_t phta, size_t size)
 {
 	struct thread_param tpm = THREAD_PARAM_VALUE(IN, type, phta, size);
@@ -160,6 +195,260 @@ static TEE_Result unregister_benchmark(uint32_t type,
 	return res;
 }
 
+static unsigned int lat_bucket(uint64_t v)
+{
+	unsigned int msb = 0;
+	unsigned int idx = 0;
+
+	if (v < BIT(LAT_SUB_BITS))
+		return v;
+
+	msb = 63 - __builtin_clzll(v);
+	idx = ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) |
+	      ((v >> (msb - LAT_SUB_BITS)) & (BIT(LAT_SUB_BITS) - 1));
+
+	return MIN(idx, LAT_NUM_BUCKETS - 1);
+}
+
+/* Returns the upper bound (in ticks) of the values in bucket @idx */
+static uint64_t lat_bucket_max(unsigned int idx)
+{
+	unsigned int shift = 0;
+
+	if (idx < BIT(LAT_SUB_BITS))
+		return idx;
+
+	shift = (idx >> LAT_SUB_BITS) - 1;
+	return (((uint64_t)(idx & (BIT(LAT_SUB_BITS) - 1)) + BIT(LAT_SUB_BITS) +
+		 1) << shift) - 1;
+}
+
+static void lat_add(uint32_t cmd, unsigned int interval, uint64_t v)
+{
+	struct lat_hist *h = &lat_hist[cmd][interval];
+
+	if (!h->count || v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+	h->count++;
+	h->bucket[lat_bucket(v)]++;
+}
+
+static void lat_add_interval(uint32_t cmd, unsigned int interval,
+			     uint64_t start, uint64_t end)
+{
+	/* Skip stages that this call didn't go through */
+	if (start && end && end >= start)
+		lat_add(cmd, interval, end - start);
+}
+
+static void lat_account(struct lat_call *c)
+{
+	uint64_t *t = c->stamp;
+	uint32_t exceptions = 0;
+	uint64_t ta_start = 0;
+
+	exceptions = cpu_spin_lock_xsave(&lat_lock);
+
+	lat_add_interval(c->cmd, BENCHMARK_LAT_SMC_TO_THREAD,
+			 t[BM_STAGE_SMC_ENTRY], t[BM_STAGE_THREAD_ALLOC]);
+	lat_add_interval(c->cmd, BENCHMARK_LAT_PARAM_IN,
+			 t[BM_STAGE_THREAD_ALLOC], t[BM_STAGE_PARAM_IN]);
+	lat_add_interval(c->cmd, BENCHMARK_LAT_TA_ENTRY,
+			 t[BM_STAGE_PARAM_IN], t[BM_STAGE_TA_ENTRY]);
+	/* RPCs issued while in the TA are accounted separately */
+	if (t[BM_STAGE_TA_ENTRY])
+		ta_start = t[BM_STAGE_TA_ENTRY] + c->ta_rpc_time;
+	lat_add_interval(c->cmd, BENCHMARK_LAT_TA, ta_start,
+			 t[BM_STAGE_TA_RETURN]);
+	if (c->rpc_time)
+		lat_add(c->cmd, BENCHMARK_LAT_RPC, c->rpc_time);
+	lat_add_interval(c->cmd, BENCHMARK_LAT_RETURN, t[BM_STAGE_TA_RETURN],
+			 t[BM_STAGE_RETURN]);
+	lat_add_interval(c->cmd, BENCHMARK_LAT_TOTAL, t[BM_STAGE_SMC_ENTRY],
+			 t[BM_STAGE_RETURN]);
+
+	cpu_spin_unlock_xrestore(&lat_lock, exceptions);
+}
+
+void bm_stage(enum bm_stage stage)
+{
+	uint64_t now = barrier_read_counter_timer();
+	struct lat_call *c = NULL;
+	uint32_t exceptions = 0;
+	short int id = 0;
+
+	if (stage == BM_STAGE_SMC_ENTRY) {
+		/* Not in a thread yet, exceptions are masked */
+		lat_smc_entry[get_core_pos()] = now;
+		return;
+	}
+
+	id = thread_get_id_may_fail();
+	if (id < 0)
+		return;
+	c = lat_call + id;
+
+	switch (stage) {
+	case BM_STAGE_THREAD_ALLOC:
+		memset(c, 0, sizeof(*c));
+		c->cmd = BENCHMARK_LAT_CMD_OTHER;
+		exceptions = thread_mask_exceptions(THREAD_EXCP_ALL);
+		c->stamp[BM_STAGE_SMC_ENTRY] = lat_smc_entry[get_core_pos()];
+		thread_unmask_exceptions(exceptions);
+		c->stamp[stage] = now;
+		break;
+	case BM_STAGE_TA_ENTRY:
+		/* Keep the outermost TA in case of TA to TA calls */
+		if (!c->stamp[stage])
+			c->stamp[stage] = now;
+		break;
+	case BM_STAGE_RPC_ENTRY:
+		c->rpc_start = now;
+		break;
+	case BM_STAGE_RPC_RETURN:
+		if (!c->rpc_start)
+			break;
+		c->rpc_time += now - c->rpc_start;
+		if (c->stamp[BM_STAGE_TA_ENTRY] && !c->stamp[BM_STAGE_TA_RETURN])
+			c->ta_rpc_time += now - c->rpc_start;
+		c->rpc_start = 0;
+		break;
+	case BM_STAGE_RETURN:
+		c->stamp[stage] = now;
+		lat_account(c);
+		break;
+	default:
+		c->stamp[stage] = now;
+		break;
+	}
+}
+DECLARE_KEEP_PAGER(bm_stage);
+
+void bm_stage_cmd(uint32_t cmd)
+{
+	short int id = thread_get_id_may_fail();
+
+	if (id < 0)
+		return;
+
+	switch (cmd) {
+	case OPTEE_MSG_CMD_OPEN_SESSION:
+		lat_call[id].cmd = BENCHMARK_LAT_CMD_OPEN_SESSION;
+		break;
+	case OPTEE_MSG_CMD_INVOKE_COMMAND:
+		lat_call[id].cmd = BENCHMARK_LAT_CMD_INVOKE;
+		break;
+	case OPTEE_MSG_CMD_CLOSE_SESSION:
+		lat_call[id].cmd = BENCHMARK_LAT_CMD_CLOSE_SESSION;
+		break;
+	default:
+		lat_call[id].cmd = BENCHMARK_LAT_CMD_OTHER;
+		break;
+	}
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks)
+{
+	return ticks * 1000000000ULL / read_cntfrq();
+}
+
+static uint64_t lat_percentile(struct lat_hist *h, unsigned int pct)
+{
+	uint64_t target = (h->count * pct + 99) / 100;
+	uint64_t sum = 0;
+	unsigned int n = 0;
+
+	for (n = 0; n < LAT_NUM_BUCKETS; n++) {
+		sum += h->bucket[n];
+		if (sum >= target)
+			return MIN(lat_bucket_max(n), h->max);
+	}
+
+	return h->max;
+}
+
+static TEE_Result get_latency(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct benchmark_latency *out = NULL;
+	struct lat_hist *h = NULL;
+	uint32_t exceptions = 0;
+	unsigned int cmd = 0;
+	unsigned int n = 0;
+	size_t count = 0;
+	size_t sz = 0;
+
+	if ((TEE_PARAM_TYPE_GET(type, 0) != TEE_PARAM_TYPE_MEMREF_OUTPUT) ||
+		(TEE_PARAM_TYPE_GET(type, 1) != TEE_PARAM_TYPE_VALUE_OUTPUT) ||
+		(TEE_PARAM_TYPE_GET(type, 2) != TEE_PARAM_TYPE_NONE) ||
+		(TEE_PARAM_TYPE_GET(type, 3) != TEE_PARAM_TYPE_NONE)) {
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	out = calloc(BENCHMARK_LAT_CMD_COUNT * BENCHMARK_LAT_COUNT,
+		     sizeof(*out));
+	if (!out)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	exceptions = cpu_spin_lock_xsave(&lat_lock);
+	for (cmd = 0; cmd < BENCHMARK_LAT_CMD_COUNT; cmd++) {
+		for (n = 0; n < BENCHMARK_LAT_COUNT; n++) {
+			h = &lat_hist[cmd][n];
+			if (!h->count)
+				continue;
+			out[count].cmd = cmd;
+			out[count].interval = n;
+			out[count].count = h->count;
+			out[count].min_ns = h->min;
+			out[count].p50_ns = lat_percentile(h, 50);
+			out[count].p99_ns = lat_percentile(h, 99);
+			out[count].max_ns = h->max;
+			count++;
+		}
+	}
+	cpu_spin_unlock_xrestore(&lat_lock, exceptions);
+
+	/* Conversion is done outside of the spinlock */
+	for (n = 0; n < count; n++) {
+		out[n].min_ns = ticks_to_ns(out[n].min_ns);
+		out[n].p50_ns = ticks_to_ns(out[n].p50_ns);
+		out[n].p99_ns = ticks_to_ns(out[n].p99_ns);
+		out[n].max_ns = ticks_to_ns(out[n].max_ns);
+	}
+
+	sz = count * sizeof(*out);
+	p[1].value.a = count;
+	p[1].value.b = 0;
+	if (p[0].memref.size < sz) {
+		p[0].memref.size = sz;
+		free(out);
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+
+	memcpy(p[0].memref.buffer, out, sz);
+	p[0].memref.size = sz;
+	free(out);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result reset_latency(uint32_t type,
+				TEE_Param p[TEE_NUM_PARAMS] __unused)
+{
+	uint32_t exceptions = 0;
+
+	if (type != TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE,
+				    TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	exceptions = cpu_spin_lock_xsave(&lat_lock);
+	memset(lat_hist, 0, sizeof(lat_hist));
+	cpu_spin_unlock_xrestore(&lat_lock, exceptions);
+
+	return TEE_SUCCESS;
+}
+
 static TEE_Result invoke_command(void *session_ctx __unused,
 		uint32_t cmd_id, uint32_t param_types,
 		TEE_Param params[TEE_NUM_PARAMS])
@@ -171,6 +460,10 @@ static TEE_Result invoke_command(void *session_ctx __unused,
 		return get_benchmark_memref(param_types, params);
 	case BENCHMARK_CMD_UNREGISTER:
 		return unregister_benchmark(param_types, params);
+	case BENCHMARK_CMD_GET_LATENCY:
+		return get_latency(param_types, params);
+	case BENCHMARK_CMD_RESET_LATENCY:
+		return reset_latency(param_types, params);
 	default:
 		break;
 	}
@@ -3,6 +3,7 @@
  * Copyright (c) 2015, Linaro Limited
  */
 #include <compiler.h>
+#include <config.h>
 #include <stdio.h>
 #include <trace.h>
 #include <kernel/pseudo_ta.h>
@@ -11,6 +12,8 @@
 #include <string.h>
 #include <string_ext.h>
 #include <malloc.h>
+#include <tee/fs_htree_cache.h>
+#include <tee/tee_fs.h>
 
 #define TA_NAME		"stats.ta"
 
@@ -21,6 +24,8 @@
 #define STATS_CMD_PAGER_STATS		0
 #define STATS_CMD_ALLOC_STATS		1
 #define STATS_CMD_MEMLEAK_STATS		2
+#define STATS_CMD_FS_CACHE_STATS	3
+#define STATS_CMD_RPMB_FS_STATS		4
 
 #define STATS_NB_POOLS			4
 
@@ -137,6 +142,65 @@ static TEE_Result get_memleak_stats(uint32_t type,
 	return TEE_SUCCESS;
 }
 
+static TEE_Result get_fs_cache_stats(uint32_t type,
+				     TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct tee_fs_htree_cache_stats stats = { };
+
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT) != type) {
+		EMSG("expect 4 output values as argument");
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	if (!IS_ENABLED(CFG_REE_FS_BLOCK_CACHE))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	tee_fs_htree_cache_get_stats(&stats);
+	p[0].value.a = stats.hits;
+	p[0].value.b = stats.misses;
+	p[1].value.a = stats.rpc_reads;
+	p[1].value.b = stats.rpc_writes;
+	p[2].value.a = stats.evictions;
+	p[2].value.b = stats.count;
+	p[3].value.a = stats.size;
+	p[3].value.b = stats.max_size;
+
+	return TEE_SUCCESS;
+}
+
+#ifdef CFG_RPMB_FS
+static TEE_Result get_rpmb_fs_stats(uint32_t type,
+				    TEE_Param p[TEE_NUM_PARAMS])
+{
+	struct tee_rpmb_fs_stats stats = { };
+
+	if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_VALUE_OUTPUT,
+			    TEE_PARAM_TYPE_NONE,
+			    TEE_PARAM_TYPE_NONE) != type) {
+		EMSG("expect 2 output values as argument");
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	tee_rpmb_fs_get_stats(&stats);
+	p[0].value.a = stats.partial_writes;
+	p[0].value.b = stats.frames_saved;
+	p[1].value.a = stats.cache_hits;
+	p[1].value.b = stats.cache_misses;
+
+	return TEE_SUCCESS;
+}
+#else
+static TEE_Result get_rpmb_fs_stats(uint32_t type __unused,
+				    TEE_Param p[TEE_NUM_PARAMS] __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+#endif
+
 /*
  * Trusted Application Entry Points
  */
@@ -152,6 +216,10 @@ static TEE_Result invoke_command(void *psess __unused,
 		return get_alloc_stats(ptypes, params);
 	case STATS_CMD_MEMLEAK_STATS:
 		return get_memleak_stats(ptypes, params);
+	case STATS_CMD_FS_CACHE_STATS:
+		return get_fs_cache_stats(ptypes, params);
+	case STATS_CMD_RPMB_FS_STATS:
+		return get_rpmb_fs_stats(ptypes, params);
 	default:
 		break;
 	}
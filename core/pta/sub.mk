@@ -13,5 +13,6 @@ srcs-$(CFG_APDU_PTA) += apdu.c
 srcs-$(CFG_SCMI_PTA) += scmi.c
 srcs-$(CFG_HWRNG_PTA) += hwrng.c
 srcs-$(CFG_WITH_TUI) += tui.c
+srcs-$(CFG_TA_POOL) += ta_pool.c
 
 subdirs-y += bcm
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+/*
+ * Warm pool of pre-instantiated TAs
+ *
+ * Loading a TA and running TA_CreateEntryPoint() is the bulk of the cost
+ * of the first OpenSession. The TAs listed in CFG_TA_POOL_UUIDS are loaded
+ * ahead of time by opening and closing a session from the core. Only
+ * single instance, keep alive TAs keep their context once that session
+ * is closed, other TAs are reported as skipped.
+ *
+ * Early TAs are loaded during the first standard call. Other TAs need
+ * tee-supplicant and are loaded when the normal world invokes
+ * PTA_TA_POOL_CMD_FILL, for instance once tee-supplicant is started or
+ * when the system is idle.
+ */
+
+#include <arm.h>
+#include <atomic.h>
+#include <config.h>
+#include <ctype.h>
+#include <initcall.h>
+#include <kernel/early_ta.h>
+#include <kernel/mutex.h>
+#include <kernel/pseudo_ta.h>
+#include <kernel/ta_pool.h>
+#include <kernel/tee_ta_manager.h>
+#include <malloc.h>
+#include <pta_ta_pool.h>
+#include <string.h>
+#include <tee/uuid.h>
+#include <trace.h>
+#include <user_ta_header.h>
+#include <util.h>
+
+#define PTA_NAME "ta_pool.pta"
+
+#define UUID_STR_LEN	36
+
+struct pool_ent {
+	TEE_UUID uuid;
+	uint32_t state;
+	TEE_Result res;
+	uint32_t load_time_us;
+};
+
+#ifdef CFG_TA_POOL_UUIDS
+static const char pool_uuids[] = TO_STR(CFG_TA_POOL_UUIDS);
+#else
+static const char pool_uuids[] = "";
+#endif
+
+static struct pool_ent *pool_ents;
+static size_t pool_num_ents;
+static unsigned int early_filled;
+
+/* Serializes filling of the pool and protects @pool_ents */
+static struct mutex pool_mu = MUTEX_INITIALIZER;
+
+/* The sessions used to load the TAs, closed right away */
+static struct tee_ta_session_head pool_sessions =
+	TAILQ_HEAD_INITIALIZER(pool_sessions);
+
+static int hex(char c)
+{
+	char lc = tolower(c);
+
+	if (isdigit(lc))
+		return lc - '0';
+	if (isxdigit(lc))
+		return lc - 'a' + 10;
+	return -1;
+}
+
+static TEE_Result uuid_from_str(TEE_UUID *uuid, const char *s)
+{
+	uint8_t octets[sizeof(TEE_UUID)] = { };
+	size_t n = 0;
+	size_t i = 0;
+	int h = 0;
+	int l = 0;
+
+	for (n = 0; n < UUID_STR_LEN;) {
+		if (n == 8 || n == 13 || n == 18 || n == 23) {
+			if (s[n] != '-')
+				return TEE_ERROR_BAD_FORMAT;
+			n++;
+			continue;
+		}
+		h = hex(s[n]);
+		l = hex(s[n + 1]);
+		if (h < 0 || l < 0)
+			return TEE_ERROR_BAD_FORMAT;
+		octets[i++] = (h << 4) | l;
+		n += 2;
+	}
+
+	tee_uuid_from_octets(uuid, octets);
+	return TEE_SUCCESS;
+}
+
+/* Returns the number of UUIDs found in @pool_uuids, parsed if @ents != NULL */
+static size_t parse_pool_uuids(struct pool_ent *ents)
+{
+	const char *p = pool_uuids;
+	size_t num = 0;
+	size_t len = 0;
+
+	while (*p) {
+		if (*p == ' ') {
+			p++;
+			continue;
+		}
+
+		len = 0;
+		while (p[len] && p[len] != ' ')
+			len++;
+
+		if (len == UUID_STR_LEN &&
+		    (!ents || !uuid_from_str(&ents[num].uuid, p)))
+			num++;
+		else if (ents)
+			EMSG("Bad UUID \"%.*s\" in CFG_TA_POOL_UUIDS",
+			     (int)len, p);
+		p += len;
+	}
+
+	return num;
+}
+
+static bool is_early_ta(const TEE_UUID *uuid)
+{
+	const struct embedded_ts *ta = NULL;
+
+	if (!IS_ENABLED(CFG_EARLY_TA))
+		return false;
+
+	for_each_early_ta(ta)
+		if (!memcmp(&ta->uuid, uuid, sizeof(*uuid)))
+			return true;
+
+	return false;
+}
+
+/* Returns true if a context which will outlive its sessions is loaded */
+static bool is_ctx_pooled(const TEE_UUID *uuid)
+{
+	struct tee_ta_ctx *ctx = NULL;
+	bool ret = false;
+
+	mutex_lock(&tee_ta_mutex);
+	TAILQ_FOREACH(ctx, &tee_ctxes, link) {
+		if (memcmp(&ctx->ts_ctx.uuid, uuid, sizeof(*uuid)))
+			continue;
+		ret = (ctx->flags & TA_FLAG_SINGLE_INSTANCE) &&
+		      (ctx->flags & TA_FLAG_INSTANCE_KEEP_ALIVE) &&
+		      !ctx->panicked;
+		break;
+	}
+	mutex_unlock(&tee_ta_mutex);
+
+	return ret;
+}
+
+static void load_ent(struct pool_ent *ent)
+{
+	TEE_Identity id = {
+		.login = TEE_LOGIN_TRUSTED_APP,
+		.uuid = PTA_TA_POOL_UUID,
+	};
+	struct tee_ta_param param = { };
+	struct tee_ta_session *s = NULL;
+	TEE_ErrorOrigin eo = TEE_ORIGIN_TEE;
+	TEE_Result res = TEE_SUCCESS;
+	uint64_t t = 0;
+
+	t = barrier_read_counter_timer();
+	res = tee_ta_open_session(&eo, &s, &pool_sessions, &ent->uuid, &id,
+				  TEE_TIMEOUT_INFINITE, &param);
+	/*
+	 * The TA may turn down a session it doesn't expect, the context
+	 * is loaded and initialized nonetheless. On error the session is
+	 * already closed.
+	 */
+	if (!res)
+		tee_ta_close_session(s, &pool_sessions, &id);
+	t = barrier_read_counter_timer() - t;
+
+	ent->res = res;
+	ent->load_time_us = (t * 1000000) / read_cntfrq();
+
+	if (is_ctx_pooled(&ent->uuid)) {
+		ent->state = PTA_TA_POOL_STATE_READY;
+		DMSG("TA %pUl ready in %"PRIu32" us", (void *)&ent->uuid,
+		     ent->load_time_us);
+	} else if (!res || eo == TEE_ORIGIN_TRUSTED_APP) {
+		ent->state = PTA_TA_POOL_STATE_SKIPPED;
+		IMSG("TA %pUl is not single instance and keep alive, skipped",
+		     (void *)&ent->uuid);
+	} else {
+		ent->state = PTA_TA_POOL_STATE_FAILED;
+		EMSG("Failed to load TA %pUl: %#"PRIx32, (void *)&ent->uuid,
+		     res);
+	}
+}
+
+static void fill_pool(bool early_only, uint32_t *num_ready,
+		      uint32_t *num_failed)
+{
+	struct pool_ent *ent = NULL;
+	size_t n = 0;
+
+	*num_ready = 0;
+	*num_failed = 0;
+
+	mutex_lock(&pool_mu);
+	for (n = 0; n < pool_num_ents; n++) {
+		ent = pool_ents + n;
+
+		if (ent->state == PTA_TA_POOL_STATE_READY &&
+		    !is_ctx_pooled(&ent->uuid))
+			ent->state = PTA_TA_POOL_STATE_EVICTED;
+
+		if (ent->state != PTA_TA_POOL_STATE_READY &&
+		    ent->state != PTA_TA_POOL_STATE_SKIPPED &&
+		    (!early_only || is_early_ta(&ent->uuid)))
+			load_ent(ent);
+
+		if (ent->state == PTA_TA_POOL_STATE_READY)
+			(*num_ready)++;
+		else if (ent->state == PTA_TA_POOL_STATE_FAILED)
+			(*num_failed)++;
+	}
+	mutex_unlock(&pool_mu);
+}
+
+void ta_pool_fill_early_tas(void)
+{
+	unsigned int v = 0;
+	uint32_t num_ready = 0;
+	uint32_t num_failed = 0;
+
+	if (atomic_load_uint(&early_filled) ||
+	    !atomic_cas_uint(&early_filled, &v, 1))
+		return;
+
+	fill_pool(true /*early_only*/, &num_ready, &num_failed);
+	if (num_ready || num_failed)
+		IMSG("TA pool: %"PRIu32" ready, %"PRIu32" failed", num_ready,
+		     num_failed);
+}
+
+static TEE_Result get_status(uint32_t types, TEE_Param params[TEE_NUM_PARAMS])
+{
+	struct pta_ta_pool_entry *out = NULL;
+	struct pool_ent *ent = NULL;
+	size_t sz = 0;
+	size_t n = 0;
+
+	if (types != TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_OUTPUT,
+				     TEE_PARAM_TYPE_VALUE_OUTPUT,
+				     TEE_PARAM_TYPE_NONE,
+				     TEE_PARAM_TYPE_NONE))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (!params[0].memref.buffer && params[0].memref.size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	sz = pool_num_ents * sizeof(*out);
+	params[1].value.a = pool_num_ents;
+	params[1].value.b = 0;
+	if (params[0].memref.size < sz) {
+		params[0].memref.size = sz;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	params[0].memref.size = sz;
+	out = params[0].memref.buffer;
+
+	mutex_lock(&pool_mu);
+	for (n = 0; n < pool_num_ents; n++) {
+		ent = pool_ents + n;
+		if (ent->state == PTA_TA_POOL_STATE_READY &&
+		    !is_ctx_pooled(&ent->uuid))
+			ent->state = PTA_TA_POOL_STATE_EVICTED;
+
+		tee_uuid_to_octets(out[n].uuid, &ent->uuid);
+		out[n].state = ent->state;
+		out[n].result = ent->res;
+		out[n].load_time_us = ent->load_time_us;
+		out[n].reserved = 0;
+	}
+	mutex_unlock(&pool_mu);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fill(uint32_t types, TEE_Param params[TEE_NUM_PARAMS])
+{
+	uint32_t num_ready = 0;
+	uint32_t num_failed = 0;
+
+	if (types != TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+				     TEE_PARAM_TYPE_NONE,
+				     TEE_PARAM_TYPE_NONE,
+				     TEE_PARAM_TYPE_NONE))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	fill_pool(false /*early_only*/, &num_ready, &num_failed);
+	params[0].value.a = num_ready;
+	params[0].value.b = num_failed;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result invoke_command(void *psess __unused,
+				 uint32_t cmd, uint32_t ptypes,
+				 TEE_Param params[TEE_NUM_PARAMS])
+{
+	switch (cmd) {
+	case PTA_TA_POOL_CMD_GET_STATUS:
+		return get_status(ptypes, params);
+	case PTA_TA_POOL_CMD_FILL:
+		return fill(ptypes, params);
+	default:
+		break;
+	}
+
+	return TEE_ERROR_NOT_IMPLEMENTED;
+}
+
+static TEE_Result ta_pool_init(void)
+{
+	size_t num = parse_pool_uuids(NULL);
+
+	if (!num)
+		return TEE_SUCCESS;
+
+	pool_ents = calloc(num, sizeof(*pool_ents));
+	if (!pool_ents)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	pool_num_ents = parse_pool_uuids(pool_ents);
+	DMSG("TA pool: %zu entries", pool_num_ents);
+
+	return TEE_SUCCESS;
+}
+
+service_init(ta_pool_init);
+
+pseudo_ta_register(.uuid = PTA_TA_POOL_UUID, .name = PTA_NAME,
+		   .flags = PTA_DEFAULT_FLAGS,
+		   .invoke_command_entry_point = invoke_command);
@@ -3,6 +3,7 @@
  * Copyright (c) 2017, Linaro Limited
  */
 
+#include <arm.h>
 #include <assert.h>
 #include <kernel/ts_manager.h>
 #include <string.h>
@@ -20,14 +21,24 @@
  */
 #define TEST_BLOCK_SIZE		144
 
+/* Largest file used by the commit performance test */
+#define TEST_PERF_MAX_BLOCKS	256
+
+/*
+ * @block_size is supplied by the hash tree with test_set_block_size(), as
+ * with the REE FS the location of nodes and data blocks depends on it.
+ */
 struct test_aux {
 	uint8_t *data;
 	size_t data_len;
 	size_t data_alloced;
 	uint8_t *block;
+	size_t num_writes;
+	size_t block_size;
 };
 
-static TEE_Result test_get_offs_size(enum tee_fs_htree_type type, size_t idx,
+static TEE_Result test_get_offs_size(const struct test_aux *a,
+				     enum tee_fs_htree_type type, size_t idx,
 				     uint8_t vers, size_t *offs, size_t *size)
 {
 	const size_t node_size = sizeof(struct tee_fs_htree_node_image);
@@ -73,6 +84,8 @@ static TEE_Result test_get_offs_size(enum tee_fs_htree_type type, size_t idx,
 		return TEE_SUCCESS;
 	case TEE_FS_HTREE_TYPE_NODE:
 		pbn = 1 + ((idx / block_nodes) * block_nodes * 2);
+		if (pbn > 1 && a->block_size != TEST_BLOCK_SIZE)
+			return TEE_ERROR_BAD_STATE;
 		*offs = pbn * TEST_BLOCK_SIZE +
 			2 * node_size * (idx % block_nodes) +
 			node_size * vers;
@@ -81,6 +94,8 @@ static TEE_Result test_get_offs_size(enum tee_fs_htree_type type, size_t idx,
 	case TEE_FS_HTREE_TYPE_BLOCK:
 		bidx = 2 * idx + vers;
 		pbn = 2 + bidx + bidx / (block_nodes * 2 - 1);
+		if (a->block_size != TEST_BLOCK_SIZE)
+			return TEE_ERROR_BAD_STATE;
 		*offs = pbn * TEST_BLOCK_SIZE;
 		*size = TEST_BLOCK_SIZE;
 		return TEE_SUCCESS;
@@ -98,7 +113,7 @@ static TEE_Result test_read_init(void *aux, struct tee_fs_rpc_operation *op,
 	size_t offs = 0;
 	size_t sz = 0;
 
-	res = test_get_offs_size(type, idx, vers, &offs, &sz);
+	res = test_get_offs_size(a, type, idx, vers, &offs, &sz);
 	if (res == TEE_SUCCESS) {
 		memset(op, 0, sizeof(*op));
 		op->params[0].u.value.a = (vaddr_t)aux;
@@ -155,16 +170,25 @@ static TEE_Result test_write_final(struct tee_fs_rpc_operation *op)
 	memcpy(a->data + offs, a->block, sz);
 	if (end > a->data_len)
 		a->data_len = end;
+	a->num_writes++;
 	return TEE_SUCCESS;
 
 }
 
+static void test_set_block_size(void *aux, size_t block_size)
+{
+	struct test_aux *a = aux;
+
+	a->block_size = block_size;
+}
+
 static const struct tee_fs_htree_storage test_htree_ops = {
 	.block_size = TEST_BLOCK_SIZE,
 	.rpc_read_init = test_read_init,
 	.rpc_read_final = test_read_final,
 	.rpc_write_init = test_write_init,
 	.rpc_write_final = test_write_final,
+	.set_block_size = test_set_block_size,
 };
 
 #define CHECK_RES(res, cleanup)						\
@@ -403,11 +427,13 @@ static void aux_free(struct test_aux *aux)
 
 static struct test_aux *aux_alloc(size_t num_blocks)
 {
+	const struct test_aux a = { .block_size = TEST_BLOCK_SIZE };
 	struct test_aux *aux = NULL;
 	size_t o = 0;
 	size_t sz = 0;
 
-	if (test_get_offs_size(TEE_FS_HTREE_TYPE_BLOCK, num_blocks, 1, &o, &sz))
+	if (test_get_offs_size(&a, TEE_FS_HTREE_TYPE_BLOCK, num_blocks, 1,
+			       &o, &sz))
 		return NULL;
 
 	aux = calloc(1, sizeof(*aux));
@@ -463,6 +489,45 @@ out:
 	return res;
 }
 
+/*
+ * Reopens a file spanning several physical blocks of nodes, the storage
+ * only learns the size of the data blocks while the file is opened.
+ */
+static TEE_Result test_reopen(size_t num_blocks)
+{
+	struct ts_session *sess = ts_get_current_session();
+	const TEE_UUID *uuid = &sess->ctx->uuid;
+	struct test_aux *aux = aux_alloc(num_blocks);
+	uint8_t hash[TEE_FS_HTREE_HASH_SIZE] = { 0 };
+	struct tee_fs_htree *ht = NULL;
+	TEE_Result res = TEE_SUCCESS;
+
+	if (!aux)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	aux->data_len = 0;
+	res = tee_fs_htree_open(true, hash, uuid, &test_htree_ops, aux, &ht);
+	CHECK_RES(res, goto out);
+	res = do_range(write_block, &ht, 0, num_blocks, 1);
+	CHECK_RES(res, goto out);
+	res = tee_fs_htree_sync_to_storage(&ht, hash);
+	CHECK_RES(res, goto out);
+	tee_fs_htree_close(&ht);
+
+	aux->block_size = 0;
+	res = tee_fs_htree_open(false, hash, uuid, &test_htree_ops, aux, &ht);
+	CHECK_RES(res, goto out);
+	res = do_range(read_block, &ht, 0, num_blocks, 1);
+	CHECK_RES(res, goto out);
+
+out:
+	tee_fs_htree_close(&ht);
+	aux_free(aux);
+	if (res == TEE_ERROR_TIME_NOT_SET)
+		res = TEE_ERROR_SECURITY;
+	return res;
+}
+
 static TEE_Result test_corrupt_type(const TEE_UUID *uuid, uint8_t *hash,
 				    size_t num_blocks, struct test_aux *aux,
 				    enum tee_fs_htree_type type, size_t idx)
@@ -475,7 +540,7 @@ static TEE_Result test_corrupt_type(const TEE_UUID *uuid, uint8_t *hash,
 	size_t size0 = 0;
 	size_t n = 0;
 
-	res = test_get_offs_size(type, idx, 0, &offs, &size0);
+	res = test_get_offs_size(aux, type, idx, 0, &offs, &size0);
 	CHECK_RES(res, return res);
 
 	aux2.data = malloc(aux->data_alloced);
@@ -486,10 +551,10 @@ static TEE_Result test_corrupt_type(const TEE_UUID *uuid, uint8_t *hash,
 	while (true) {
 		memcpy(aux2.data, aux->data, aux->data_len);
 
-		res = test_get_offs_size(type, idx, 0, &offs, &size);
+		res = test_get_offs_size(aux, type, idx, 0, &offs, &size);
 		CHECK_RES(res, goto out);
 		aux2.data[offs + n]++;
-		res = test_get_offs_size(type, idx, 1, &offs, &size);
+		res = test_get_offs_size(aux, type, idx, 1, &offs, &size);
 		CHECK_RES(res, goto out);
 		aux2.data[offs + n]++;
 
@@ -619,5 +684,93 @@ TEE_Result core_fs_htree_tests(uint32_t nParamTypes,
 	if (res)
 		return res;
 
+	res = test_reopen(40);
+	if (res)
+		return res;
+
 	return test_corrupt(5);
 }
+
+/*
+ * Measures the time of tee_fs_htree_sync_to_storage() with @num_dirty
+ * blocks spread over a file of @num_blocks blocks modified since the last
+ * commit.
+ */
+static TEE_Result test_commit_perf(size_t num_blocks, size_t num_dirty,
+				   size_t reps, uint32_t *avg_us,
+				   uint32_t *writes)
+{
+	struct ts_session *sess = ts_get_current_session();
+	const TEE_UUID *uuid = &sess->ctx->uuid;
+	struct test_aux *aux = aux_alloc(num_blocks);
+	uint8_t hash[TEE_FS_HTREE_HASH_SIZE] = { 0 };
+	struct tee_fs_htree *ht = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	size_t stride = num_blocks / num_dirty;
+	size_t num_writes = 0;
+	uint64_t t_tot = 0;
+	uint64_t t = 0;
+	uint8_t salt = 23;
+	size_t r = 0;
+	size_t n = 0;
+
+	if (!aux)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	aux->data_len = 0;
+	res = tee_fs_htree_open(true, hash, uuid, &test_htree_ops, aux, &ht);
+	CHECK_RES(res, goto out);
+
+	res = do_range(write_block, &ht, 0, num_blocks, salt);
+	CHECK_RES(res, goto out);
+
+	res = tee_fs_htree_sync_to_storage(&ht, hash);
+	CHECK_RES(res, goto out);
+
+	for (r = 0; r < reps; r++) {
+		salt++;
+		for (n = 0; n < num_dirty; n++) {
+			res = write_block(&ht, (r + n * stride) % num_blocks,
+					  salt);
+			CHECK_RES(res, goto out);
+		}
+
+		aux->num_writes = 0;
+		t = barrier_read_counter_timer();
+		res = tee_fs_htree_sync_to_storage(&ht, hash);
+		t_tot += barrier_read_counter_timer() - t;
+		CHECK_RES(res, goto out);
+		num_writes += aux->num_writes;
+	}
+
+	*avg_us = ticks_to_us(t_tot) / reps;
+	*writes = num_writes / reps;
+out:
+	tee_fs_htree_close(&ht);
+	aux_free(aux);
+	return res;
+}
+
+TEE_Result core_fs_htree_commit_perf(uint32_t param_types,
+				     TEE_Param params[TEE_NUM_PARAMS])
+{
+	size_t num_blocks = 0;
+	size_t num_dirty = 0;
+	size_t reps = 0;
+
+	if (param_types != TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+					   TEE_PARAM_TYPE_VALUE_INPUT,
+					   TEE_PARAM_TYPE_VALUE_OUTPUT,
+					   TEE_PARAM_TYPE_NONE))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	num_blocks = params[0].value.a;
+	num_dirty = params[0].value.b;
+	reps = params[1].value.a;
+	if (!num_blocks || num_blocks > TEST_PERF_MAX_BLOCKS || !num_dirty ||
+	    num_dirty > num_blocks || !reps)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	return test_commit_perf(num_blocks, num_dirty, reps,
+				&params[2].value.a, &params[2].value.b);
+}
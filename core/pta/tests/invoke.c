@@ -425,6 +425,12 @@ static TEE_Result invoke_command(void *pSessionContext __unused,
 #if defined(CFG_REE_FS) && defined(CFG_WITH_USER_TA)
 	case PTA_INVOKE_TESTS_CMD_FS_HTREE:
 		return core_fs_htree_tests(nParamTypes, pParams);
+	case PTA_INVOKE_TESTS_CMD_FS_HTREE_COMMIT_PERF:
+		return core_fs_htree_commit_perf(nParamTypes, pParams);
+#endif
+#ifdef CFG_WITH_USER_TA
+	case PTA_INVOKE_TESTS_CMD_STORAGE_PERF:
+		return core_storage_perf(nParamTypes, pParams);
 #endif
 	case PTA_INVOKE_TESTS_CMD_MUTEX:
 		return core_mutex_tests(nParamTypes, pParams);
@@ -2,6 +2,7 @@
 /*
  * Copyright (c) 2014, STMicroelectronics International N.V.
  */
+#include <arm.h>
 #include <assert.h>
 #include <malloc.h>
 #include <stdbool.h>
@@ -19,6 +20,11 @@
  */
 #define LOG(...)
 
+uint32_t ticks_to_us(uint64_t ticks)
+{
+	return (ticks * 1000000) / read_cntfrq();
+}
+
 static int self_test_add_overflow(void)
 {
 	uint32_t r_u32;
@@ -9,6 +9,9 @@
 #include <tee_api_types.h>
 #include <tee_api_defines.h>
 
+/* Converts a number of counter timer ticks to microseconds */
+uint32_t ticks_to_us(uint64_t ticks);
+
 /* basic run-time tests */
 TEE_Result core_self_tests(uint32_t nParamTypes,
 			   TEE_Param pParams[TEE_NUM_PARAMS]);
@@ -16,6 +19,12 @@ TEE_Result core_self_tests(uint32_t nParamTypes,
 TEE_Result core_fs_htree_tests(uint32_t nParamTypes,
 			       TEE_Param pParams[TEE_NUM_PARAMS]);
 
+TEE_Result core_fs_htree_commit_perf(uint32_t param_types,
+				     TEE_Param params[TEE_NUM_PARAMS]);
+
+TEE_Result core_storage_perf(uint32_t param_types,
+			     TEE_Param params[TEE_NUM_PARAMS]);
+
 TEE_Result core_mutex_tests(uint32_t nParamTypes,
 			    TEE_Param pParams[TEE_NUM_PARAMS]);
 
@@ -0,0 +1,541 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#include <arm.h>
+#include <crypto/crypto.h>
+#include <kernel/ts_manager.h>
+#include <malloc.h>
+#include <pta_invoke_tests.h>
+#include <stdio.h>
+#include <string.h>
+#include <tee/fs_htree.h>
+#include <tee/tee_fs.h>
+#include <tee/tee_fs_key_manager.h>
+#include <tee/tee_fs_rpc.h>
+#include <tee/tee_pobj.h>
+#include <trace.h>
+#include <types_ext.h>
+#include <utee_defines.h>
+#include <util.h>
+
+#include "misc.h"
+
+#define PERF_MAX_SIZE		(64 * 1024)
+#define PERF_MAX_COUNT		128
+#define PERF_ID_LEN		24
+#define PERF_DATA_PATTERN	0x5a
+
+/* Size of the blocks encrypted and authenticated one by one by RPMB FS */
+#define PERF_RPMB_BLOCK_SIZE	256
+
+/*
+ * struct perf_ctx - state of a storage benchmark run
+ * @storage_id:	TEE_STORAGE_PRIVATE_REE or TEE_STORAGE_PRIVATE_RPMB
+ * @fops:	file operations of @storage_id
+ * @uuid:	owner of the objects
+ * @size:	object data size
+ * @count:	number of objects
+ * @buf:	data buffer of @size bytes rounded up to a RPMB block
+ * @samples:	duration of each operation in microseconds
+ * @num_samples: number of valid entries in @samples
+ * @rpcs:	number of RPCs done by the timed operations
+ * @t_start:	counter value at the start of the current operation
+ * @rpc_start:	RPC count at the start of the current operation
+ */
+struct perf_ctx {
+	uint32_t storage_id;
+	const struct tee_file_operations *fops;
+	TEE_UUID uuid;
+	size_t size;
+	size_t count;
+	uint8_t *buf;
+	uint32_t *samples;
+	size_t num_samples;
+	uint32_t rpcs;
+	uint64_t t_start;
+	uint32_t rpc_start;
+};
+
+static uint32_t get_rpc_count(struct perf_ctx *pc)
+{
+#ifdef CFG_RPMB_FS
+	struct tee_rpmb_fs_stats stats = { };
+
+	if (pc->storage_id == TEE_STORAGE_PRIVATE_RPMB) {
+		tee_rpmb_fs_get_stats(&stats);
+		return stats.rpc_count;
+	}
+#endif
+#ifdef CFG_REE_FS
+	if (pc->storage_id == TEE_STORAGE_PRIVATE_REE)
+		return tee_fs_rpc_get_count();
+#endif
+	return 0;
+}
+
+static void sample_start(struct perf_ctx *pc)
+{
+	pc->rpc_start = get_rpc_count(pc);
+	pc->t_start = barrier_read_counter_timer();
+}
+
+static void sample_end(struct perf_ctx *pc)
+{
+	uint64_t t = barrier_read_counter_timer() - pc->t_start;
+
+	pc->rpcs += get_rpc_count(pc) - pc->rpc_start;
+	pc->samples[pc->num_samples] = ticks_to_us(t);
+	pc->num_samples++;
+}
+
+static void init_pobj(struct perf_ctx *pc, struct tee_pobj *po, char *id,
+		      size_t idx, bool renamed)
+{
+	snprintf(id, PERF_ID_LEN, "storage_perf_%s%zu", renamed ? "r" : "",
+		 idx);
+	*po = (struct tee_pobj){
+		.uuid = pc->uuid,
+		.obj_id = id,
+		.obj_id_len = strlen(id),
+		.fops = pc->fops,
+	};
+}
+
+static TEE_Result create_obj(struct perf_ctx *pc, size_t idx, bool timed)
+{
+	struct tee_file_handle *fh = NULL;
+	char id[PERF_ID_LEN] = { };
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobj po = { };
+
+	init_pobj(pc, &po, id, idx, false);
+	if (timed)
+		sample_start(pc);
+	res = pc->fops->create(&po, true, NULL, 0, NULL, 0, pc->buf, pc->size,
+			       &fh);
+	if (timed)
+		sample_end(pc);
+	if (!res)
+		pc->fops->close(&fh);
+
+	return res;
+}
+
+static void remove_objs(struct perf_ctx *pc)
+{
+	char id[PERF_ID_LEN] = { };
+	struct tee_pobj po = { };
+	size_t n = 0;
+
+	for (n = 0; n < pc->count; n++) {
+		init_pobj(pc, &po, id, n, false);
+		pc->fops->remove(&po);
+		init_pobj(pc, &po, id, n, true);
+		pc->fops->remove(&po);
+	}
+}
+
+static TEE_Result do_file_op(struct perf_ctx *pc, uint32_t op, size_t idx)
+{
+	struct tee_file_handle *fh = NULL;
+	char id[PERF_ID_LEN] = { };
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobj po = { };
+	size_t len = pc->size;
+	size_t sz = 0;
+
+	init_pobj(pc, &po, id, idx, false);
+
+	if (op == PTA_INVOKE_TESTS_STORAGE_OPEN)
+		sample_start(pc);
+	res = pc->fops->open(&po, &sz, &fh);
+	if (op == PTA_INVOKE_TESTS_STORAGE_OPEN)
+		sample_end(pc);
+	if (res)
+		return res;
+
+	switch (op) {
+	case PTA_INVOKE_TESTS_STORAGE_READ:
+		sample_start(pc);
+		res = pc->fops->read(fh, 0, pc->buf, &len);
+		sample_end(pc);
+		if (!res && len != pc->size)
+			res = TEE_ERROR_GENERIC;
+		break;
+	case PTA_INVOKE_TESTS_STORAGE_WRITE:
+		sample_start(pc);
+		res = pc->fops->write(fh, 0, pc->buf, pc->size);
+		sample_end(pc);
+		break;
+	case PTA_INVOKE_TESTS_STORAGE_TRUNCATE:
+		sample_start(pc);
+		res = pc->fops->truncate(fh, pc->size / 2);
+		sample_end(pc);
+		break;
+	default:
+		break;
+	}
+
+	pc->fops->close(&fh);
+	return res;
+}
+
+/* The data must be intact once the truncating transaction is aborted */
+static TEE_Result do_truncate_abort(struct perf_ctx *pc, size_t idx)
+{
+	struct tee_file_handle *fh = NULL;
+	char id[PERF_ID_LEN] = { };
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobj po = { };
+	size_t len = pc->size;
+	size_t sz = 0;
+	size_t n = 0;
+
+	if (!pc->fops->begin_transaction)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	init_pobj(pc, &po, id, idx, false);
+	res = pc->fops->open(&po, &sz, &fh);
+	if (res)
+		return res;
+
+	sample_start(pc);
+	res = pc->fops->begin_transaction(fh);
+	if (!res) {
+		res = pc->fops->truncate(fh, pc->size / 2);
+		pc->fops->abort_transaction(&fh, 1);
+	}
+	sample_end(pc);
+	if (res)
+		goto out;
+
+	memset(pc->buf, 0, pc->size);
+	res = pc->fops->read(fh, 0, pc->buf, &len);
+	if (res)
+		goto out;
+	if (len != pc->size) {
+		res = TEE_ERROR_GENERIC;
+		goto out;
+	}
+	for (n = 0; n < len; n++) {
+		if (pc->buf[n] != PERF_DATA_PATTERN) {
+			res = TEE_ERROR_GENERIC;
+			goto out;
+		}
+	}
+out:
+	pc->fops->close(&fh);
+	return res;
+}
+
+static TEE_Result do_rename(struct perf_ctx *pc, size_t idx)
+{
+	char new_id[PERF_ID_LEN] = { };
+	char id[PERF_ID_LEN] = { };
+	struct tee_pobj new_po = { };
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobj po = { };
+
+	init_pobj(pc, &po, id, idx, false);
+	init_pobj(pc, &new_po, new_id, idx, true);
+	sample_start(pc);
+	res = pc->fops->rename(&po, &new_po, false);
+	sample_end(pc);
+
+	return res;
+}
+
+static TEE_Result do_remove(struct perf_ctx *pc, size_t idx)
+{
+	char id[PERF_ID_LEN] = { };
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobj po = { };
+
+	init_pobj(pc, &po, id, idx, false);
+	sample_start(pc);
+	res = pc->fops->remove(&po);
+	sample_end(pc);
+
+	return res;
+}
+
+/* The first sample includes opening the directory */
+static TEE_Result do_enumerate(struct perf_ctx *pc)
+{
+	struct tee_fs_dirent *d = NULL;
+	struct tee_fs_dir *dir = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	sample_start(pc);
+	res = pc->fops->opendir(&pc->uuid, &dir);
+	if (res) {
+		sample_end(pc);
+		return res;
+	}
+
+	for (n = 0; n < pc->count; n++) {
+		if (n)
+			sample_start(pc);
+		res = pc->fops->readdir(dir, &d);
+		sample_end(pc);
+		if (res)
+			break;
+	}
+
+	pc->fops->closedir(dir);
+	return res;
+}
+
+#ifdef CFG_REE_FS
+/* AES-GCM of each block, as done by the hash tree */
+static TEE_Result ree_crypto_time(struct perf_ctx *pc, uint64_t *t)
+{
+	uint8_t key[TEE_FS_HTREE_FEK_SIZE] = { };
+	uint8_t tag[TEE_FS_HTREE_TAG_SIZE] = { };
+	uint8_t iv[TEE_FS_HTREE_IV_SIZE] = { };
+	size_t blk_size = BIT(CFG_REE_FS_BLOCK_SHIFT);
+	TEE_Result res = TEE_SUCCESS;
+	size_t tag_len = 0;
+	void *ctx = NULL;
+	size_t pos = 0;
+	size_t len = 0;
+
+	*t = barrier_read_counter_timer();
+	for (pos = 0; pos < pc->size; pos += blk_size) {
+		len = MIN(blk_size, pc->size - pos);
+		tag_len = sizeof(tag);
+
+		res = crypto_authenc_alloc_ctx(&ctx, TEE_ALG_AES_GCM);
+		if (res)
+			return res;
+		res = crypto_authenc_init(ctx, TEE_MODE_ENCRYPT, key,
+					  sizeof(key), iv, sizeof(iv),
+					  sizeof(tag), 0, len);
+		if (!res)
+			res = crypto_authenc_enc_final(ctx, pc->buf + pos, len,
+						       pc->buf + pos, &len, tag,
+						       &tag_len);
+		crypto_authenc_final(ctx);
+		crypto_authenc_free_ctx(ctx);
+		if (res)
+			return res;
+	}
+	*t = barrier_read_counter_timer() - *t;
+
+	return TEE_SUCCESS;
+}
+#endif
+
+#ifdef CFG_RPMB_FS
+/* AES-CBC with ESSIV and HMAC-SHA256 of each RPMB block */
+static TEE_Result rpmb_crypto_time(struct perf_ctx *pc, uint64_t *t)
+{
+	uint8_t mac[TEE_SHA256_HASH_SIZE] = { };
+	uint8_t fek[TEE_FS_KM_FEK_SIZE] = { };
+	uint8_t key[TEE_SHA256_HASH_SIZE] = { };
+	TEE_Result res = TEE_SUCCESS;
+	void *ctx = NULL;
+	size_t pos = 0;
+
+	res = tee_fs_generate_fek(&pc->uuid, fek, sizeof(fek));
+	if (res)
+		return res;
+	res = crypto_mac_alloc_ctx(&ctx, TEE_ALG_HMAC_SHA256);
+	if (res)
+		return res;
+
+	*t = barrier_read_counter_timer();
+	for (pos = 0; pos < pc->size; pos += PERF_RPMB_BLOCK_SIZE) {
+		res = tee_fs_crypt_block(&pc->uuid, pc->buf + pos,
+					 pc->buf + pos, PERF_RPMB_BLOCK_SIZE,
+					 pos / PERF_RPMB_BLOCK_SIZE, fek,
+					 TEE_MODE_ENCRYPT);
+		if (res)
+			goto out;
+		res = crypto_mac_init(ctx, key, sizeof(key));
+		if (res)
+			goto out;
+		res = crypto_mac_update(ctx, pc->buf + pos,
+					PERF_RPMB_BLOCK_SIZE);
+		if (res)
+			goto out;
+		res = crypto_mac_final(ctx, mac, sizeof(mac));
+		if (res)
+			goto out;
+	}
+	*t = barrier_read_counter_timer() - *t;
+out:
+	crypto_mac_free_ctx(ctx);
+	return res;
+}
+#endif
+
+static TEE_Result get_crypto_time(struct perf_ctx *pc, uint32_t *us)
+{
+	TEE_Result res = TEE_ERROR_NOT_SUPPORTED;
+	uint64_t t = 0;
+
+#ifdef CFG_REE_FS
+	if (pc->storage_id == TEE_STORAGE_PRIVATE_REE)
+		res = ree_crypto_time(pc, &t);
+#endif
+#ifdef CFG_RPMB_FS
+	if (pc->storage_id == TEE_STORAGE_PRIVATE_RPMB)
+		res = rpmb_crypto_time(pc, &t);
+#endif
+	if (!res)
+		*us = ticks_to_us(t);
+
+	return res;
+}
+
+static void sort_samples(uint32_t *s, size_t num)
+{
+	uint32_t v = 0;
+	size_t n = 0;
+	size_t m = 0;
+
+	for (n = 1; n < num; n++) {
+		v = s[n];
+		for (m = n; m && s[m - 1] > v; m--)
+			s[m] = s[m - 1];
+		s[m] = v;
+	}
+}
+
+static void get_result(struct perf_ctx *pc,
+		       struct pta_invoke_tests_storage_perf *r)
+{
+	uint32_t *s = pc->samples;
+	size_t num = pc->num_samples;
+	uint64_t sum = 0;
+	size_t n = 0;
+
+	sort_samples(s, num);
+	for (n = 0; n < num; n++)
+		sum += s[n];
+
+	r->min_us = s[0];
+	r->p50_us = s[(num - 1) * 50 / 100];
+	r->p90_us = s[(num - 1) * 90 / 100];
+	r->p99_us = s[(num - 1) * 99 / 100];
+	r->max_us = s[num - 1];
+	r->avg_us = sum / num;
+	r->rpcs = pc->rpcs;
+}
+
+static TEE_Result run_op(struct perf_ctx *pc, uint32_t op)
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	if (op != PTA_INVOKE_TESTS_STORAGE_CREATE) {
+		for (n = 0; n < pc->count; n++) {
+			res = create_obj(pc, n, false);
+			if (res)
+				return res;
+		}
+	}
+
+	if (op == PTA_INVOKE_TESTS_STORAGE_ENUMERATE)
+		return do_enumerate(pc);
+
+	for (n = 0; n < pc->count; n++) {
+		switch (op) {
+		case PTA_INVOKE_TESTS_STORAGE_CREATE:
+			res = create_obj(pc, n, true);
+			break;
+		case PTA_INVOKE_TESTS_STORAGE_OPEN:
+		case PTA_INVOKE_TESTS_STORAGE_READ:
+		case PTA_INVOKE_TESTS_STORAGE_WRITE:
+		case PTA_INVOKE_TESTS_STORAGE_TRUNCATE:
+			res = do_file_op(pc, op, n);
+			break;
+		case PTA_INVOKE_TESTS_STORAGE_TRUNCATE_ABORT:
+			res = do_truncate_abort(pc, n);
+			break;
+		case PTA_INVOKE_TESTS_STORAGE_RENAME:
+			res = do_rename(pc, n);
+			break;
+		case PTA_INVOKE_TESTS_STORAGE_DELETE:
+			res = do_remove(pc, n);
+			break;
+		default:
+			return TEE_ERROR_BAD_PARAMETERS;
+		}
+		if (res)
+			return res;
+	}
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result core_storage_perf(uint32_t param_types,
+			     TEE_Param params[TEE_NUM_PARAMS])
+{
+	struct ts_session *sess = ts_get_current_session();
+	struct pta_invoke_tests_storage_perf *r = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	struct perf_ctx pc = { };
+	uint32_t op = 0;
+
+	if (param_types != TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+					   TEE_PARAM_TYPE_VALUE_INPUT,
+					   TEE_PARAM_TYPE_MEMREF_OUTPUT,
+					   TEE_PARAM_TYPE_NONE))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	pc.storage_id = params[0].value.a;
+	op = params[0].value.b;
+	pc.size = params[1].value.a;
+	pc.count = params[1].value.b;
+	if (op > PTA_INVOKE_TESTS_STORAGE_TRUNCATE_ABORT || !pc.size ||
+	    pc.size > PERF_MAX_SIZE || !pc.count || pc.count > PERF_MAX_COUNT)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (pc.storage_id != TEE_STORAGE_PRIVATE_REE &&
+	    pc.storage_id != TEE_STORAGE_PRIVATE_RPMB)
+		return TEE_ERROR_BAD_PARAMETERS;
+	pc.fops = tee_svc_storage_file_ops(pc.storage_id);
+	if (!pc.fops)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	if (params[2].memref.size < sizeof(*r)) {
+		params[2].memref.size = sizeof(*r);
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+	r = params[2].memref.buffer;
+	if (!r)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	pc.uuid = sess->ctx->uuid;
+	pc.buf = malloc(ROUNDUP(pc.size, PERF_RPMB_BLOCK_SIZE));
+	pc.samples = calloc(pc.count, sizeof(*pc.samples));
+	if (!pc.buf || !pc.samples) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto out;
+	}
+	memset(pc.buf, PERF_DATA_PATTERN, pc.size);
+
+	/* Start from a clean state in case a previous run was interrupted */
+	remove_objs(&pc);
+
+	res = run_op(&pc, op);
+	remove_objs(&pc);
+	if (res) {
+		EMSG("Storage operation %"PRIu32" failed: %#"PRIx32, op, res);
+		goto out;
+	}
+
+	memset(r, 0, sizeof(*r));
+	get_result(&pc, r);
+	res = get_crypto_time(&pc, &r->crypto_us);
+	params[2].memref.size = sizeof(*r);
+out:
+	free(pc.buf);
+	free(pc.samples);
+	return res;
+}
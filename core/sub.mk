@@ -19,9 +19,13 @@ recipe-ldelf = $(PYTHON3) scripts/gen_ldelf_hex.py --input $(out-dir)/ldelf/ldel
 			--output $(sub-dir-out)/ldelf_hex.c
 endif
 
+ifeq ($(CFG_EMBEDDED_TS_LZ4),y)
+embedded-ts-compress-algo = --compress-algo lz4
+endif
+
 ifeq ($(CFG_WITH_USER_TA)-$(CFG_EARLY_TA),y-y)
 ifeq ($(CFG_EARLY_TA_COMPRESS),y)
-early-ta-compress = --compress
+early-ta-compress = --compress $(embedded-ts-compress-algo)
 endif
 define process_early_ta
 early-ta-$1-uuid := $(firstword $(subst ., ,$(notdir $1)))
@@ -41,7 +45,8 @@ sp-$1-uuid := $(firstword $(subst ., ,$(notdir $1)))
 gensrcs-y += sp-$1
 produce-sp-$1 = sp_$$(sp-$1-uuid).c
 depends-sp-$1 = $1 scripts/ts_bin_to_c.py
-recipe-sp-$1 = $(PYTHON3) scripts/ts_bin_to_c.py --compress --sp $1 \
+recipe-sp-$1 = $(PYTHON3) scripts/ts_bin_to_c.py --compress \
+		$(embedded-ts-compress-algo) --sp $1 \
 		--out $(sub-dir-out)/sp_$$(sp-$1-uuid).c
 endef
 $(foreach f, $(SP_PATHS), $(eval $(call process_secure_partition,$(f))))
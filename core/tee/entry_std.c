@@ -13,6 +13,7 @@
 #include <kernel/msg_param.h>
 #include <kernel/notif.h>
 #include <kernel/panic.h>
+#include <kernel/ta_pool.h>
 #include <kernel/tee_misc.h>
 #include <mm/core_memprot.h>
 #include <mm/core_mmu.h>
@@ -377,6 +378,8 @@ static void entry_open_session(struct optee_msg_arg *arg, uint32_t num_params)
 	if (res != TEE_SUCCESS)
 		goto cleanup_shm_refs;
 
+	bm_stage(BM_STAGE_PARAM_IN);
+
 	res = tee_ta_open_session(&err_orig, &s, &tee_open_sessions, &uuid,
 				  &clnt_id, TEE_TIMEOUT_INFINITE, &param);
 	if (res != TEE_SUCCESS)
@@ -443,6 +446,8 @@ static void entry_invoke_command(struct optee_msg_arg *arg, uint32_t num_params)
 	if (res != TEE_SUCCESS)
 		goto cleanup_shm_refs;
 
+	bm_stage(BM_STAGE_PARAM_IN);
+
 	s = tee_ta_get_session(arg->session, true, &tee_open_sessions);
 	if (!s) {
 		res = TEE_ERROR_BAD_PARAMETERS;
@@ -552,8 +557,11 @@ uint32_t __tee_entry_std(struct optee_msg_arg *arg, uint32_t num_params)
 {
 	uint32_t rv = OPTEE_SMC_RETURN_OK;
 
+	bm_stage_cmd(arg->cmd);
+
 	/* Enable foreign interrupts for STD calls */
 	thread_set_foreign_intr(true);
+	ta_pool_fill_early_tas();
 	switch (arg->cmd) {
 	case OPTEE_MSG_CMD_OPEN_SESSION:
 		entry_open_session(arg, num_params);
@@ -5,18 +5,42 @@
 
 #include <assert.h>
 #include <bitstring.h>
+#include <fnv1a.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <tee/fs_dirfile.h>
 #include <types_ext.h>
+#include <util.h>
 
+#define DENT_HASH_BUCKETS	256
+
+/*
+ * struct dent_ref - in-memory index of a dirfile entry
+ * @key:	hash of the UUID and object ID of the entry, see dent_key()
+ * @next:	index of the next entry in the same bucket, -1 if none
+ * @used:	true if the entry is in use
+ */
+struct dent_ref {
+	uint32_t key;
+	int next;
+	bool used;
+};
+
+/*
+ * @refs has @nrefs elements indexed like the entries in the dirfile, used
+ * entries are linked from @buckets by their key. An entry is found by
+ * reading only the entries with a matching key.
+ */
 struct tee_fs_dirfile_dirh {
 	const struct tee_fs_dirfile_operations *fops;
 	struct tee_file_handle *fh;
 	int nbits;
 	bitstr_t *files;
 	size_t ndents;
+	struct dent_ref *refs;
+	size_t nrefs;
+	int buckets[DENT_HASH_BUCKETS];
 };
 
 struct dirfile_entry {
@@ -79,6 +103,67 @@ static bool test_file(struct tee_fs_dirfile_dirh *dirh, int idx)
 	return false;
 }
 
+static uint32_t dent_key(const TEE_UUID *uuid, const void *oid,
+			 size_t oidlen)
+{
+	uint32_t h = fnv1a_hash(FNV1A_INIT, uuid, sizeof(*uuid));
+
+	return fnv1a_hash(h, oid, oidlen);
+}
+
+static int *get_bucket(struct tee_fs_dirfile_dirh *dirh, uint32_t key)
+{
+	return dirh->buckets + key % DENT_HASH_BUCKETS;
+}
+
+static TEE_Result add_ref(struct tee_fs_dirfile_dirh *dirh, size_t idx,
+			  const struct dirfile_entry *dent)
+{
+	struct dent_ref *ref = NULL;
+	int *bucket = NULL;
+	size_t n = 0;
+
+	if (idx >= dirh->nrefs) {
+		n = MAX(idx + 1, dirh->nrefs * 2);
+		ref = realloc(dirh->refs, n * sizeof(*ref));
+		if (!ref)
+			return TEE_ERROR_OUT_OF_MEMORY;
+		memset(ref + dirh->nrefs, 0,
+		       (n - dirh->nrefs) * sizeof(*ref));
+		dirh->refs = ref;
+		dirh->nrefs = n;
+	}
+
+	ref = dirh->refs + idx;
+	assert(!ref->used);
+	ref->key = dent_key(&dent->uuid, dent->oid, dent->oidlen);
+	bucket = get_bucket(dirh, ref->key);
+	ref->next = *bucket;
+	ref->used = true;
+	*bucket = idx;
+
+	return TEE_SUCCESS;
+}
+
+static void remove_ref(struct tee_fs_dirfile_dirh *dirh, size_t idx)
+{
+	struct dent_ref *ref = NULL;
+	int *i = NULL;
+
+	if (idx >= dirh->nrefs || !dirh->refs[idx].used)
+		return;
+
+	ref = dirh->refs + idx;
+	for (i = get_bucket(dirh, ref->key); *i != -1;
+	     i = &dirh->refs[*i].next) {
+		if (*i == (int)idx) {
+			*i = ref->next;
+			break;
+		}
+	}
+	ref->used = false;
+}
+
 static TEE_Result read_dent(struct tee_fs_dirfile_dirh *dirh, int idx,
 			    struct dirfile_entry *dent)
 {
@@ -101,10 +186,17 @@ static TEE_Result write_dent(struct tee_fs_dirfile_dirh *dirh, size_t n,
 
 	res = dirh->fops->write(dirh->fh, sizeof(*dent) * n,
 				dent, sizeof(*dent));
-	if (!res && n >= dirh->ndents)
+	if (res)
+		return res;
+
+	if (n >= dirh->ndents)
 		dirh->ndents = n + 1;
 
-	return res;
+	remove_ref(dirh, n);
+	if (dent->oidlen)
+		return add_ref(dirh, n, dent);
+
+	return TEE_SUCCESS;
 }
 
 TEE_Result tee_fs_dirfile_open(bool create, uint8_t *hash,
@@ -118,6 +210,9 @@ TEE_Result tee_fs_dirfile_open(bool create, uint8_t *hash,
 	if (!dirh)
 		return TEE_ERROR_OUT_OF_MEMORY;
 
+	for (n = 0; n < ARRAY_SIZE(dirh->buckets); n++)
+		dirh->buckets[n] = -1;
+
 	dirh->fops = fops;
 	res = fops->open(create, hash, NULL, NULL, &dirh->fh);
 	if (res)
@@ -149,6 +244,10 @@ TEE_Result tee_fs_dirfile_open(bool create, uint8_t *hash,
 		res = set_file(dirh, dent.file_number);
 		if (res != TEE_SUCCESS)
 			goto out;
+
+		res = add_ref(dirh, n, &dent);
+		if (res != TEE_SUCCESS)
+			goto out;
 	}
 out:
 	if (!res) {
@@ -165,6 +264,7 @@ void tee_fs_dirfile_close(struct tee_fs_dirfile_dirh *dirh)
 	if (dirh) {
 		dirh->fops->close(dirh->fh);
 		free(dirh->files);
+		free(dirh->refs);
 		free(dirh);
 	}
 }
@@ -194,41 +294,52 @@ TEE_Result tee_fs_dirfile_get_tmp(struct tee_fs_dirfile_dirh *dirh,
 	return res;
 }
 
+/* Returns the index of the first unused entry, possibly past the end */
+static int find_free_dent(struct tee_fs_dirfile_dirh *dirh)
+{
+	size_t n = 0;
+
+	for (n = 0; n < dirh->ndents; n++)
+		if (n >= dirh->nrefs || !dirh->refs[n].used)
+			break;
+
+	return n;
+}
+
 TEE_Result tee_fs_dirfile_find(struct tee_fs_dirfile_dirh *dirh,
 			       const TEE_UUID *uuid, const void *oid,
 			       size_t oidlen, struct tee_fs_dirfile_fileh *dfh)
 {
 	TEE_Result res;
 	struct dirfile_entry dent;
+	uint32_t key = 0;
 	int n;
-	int first_free = -1;
 
-	for (n = 0;; n++) {
+	if (!oidlen) {
+		memset(&dent, 0, sizeof(dent));
+		n = find_free_dent(dirh);
+		goto out;
+	}
+
+	key = dent_key(uuid, oid, oidlen);
+	for (n = *get_bucket(dirh, key); n != -1; n = dirh->refs[n].next) {
+		if (dirh->refs[n].key != key)
+			continue;
+
 		res = read_dent(dirh, n, &dent);
-		if (res == TEE_ERROR_ITEM_NOT_FOUND && !oidlen) {
-			memset(&dent, 0, sizeof(dent));
-			if (first_free != -1)
-				n = first_free;
-			break;
-		}
 		if (res)
 			return res;
 
-		/* TODO check this loop when oidlen == 0 */
+		assert(test_file(dirh, dent.file_number));
 
-		if (!dent.oidlen && first_free == -1)
-			first_free = n;
-		if (dent.oidlen != oidlen)
-			continue;
-
-		assert(!oidlen || !dent.oidlen ||
-		       test_file(dirh, dent.file_number));
-
-		if (!memcmp(&dent.uuid, uuid, sizeof(dent.uuid)) &&
+		if (dent.oidlen == oidlen &&
+		    !memcmp(&dent.uuid, uuid, sizeof(dent.uuid)) &&
 		    !memcmp(&dent.oid, oid, oidlen))
-			break;
+			goto out;
 	}
 
+	return TEE_ERROR_ITEM_NOT_FOUND;
+out:
 	if (dfh) {
 		dfh->idx = n;
 		dfh->file_number = dent.file_number;
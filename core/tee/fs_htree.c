@@ -4,6 +4,7 @@
  */
 
 #include <assert.h>
+#include <config.h>
 #include <crypto/crypto.h>
 #include <initcall.h>
 #include <kernel/tee_common_otp.h>
@@ -11,6 +12,7 @@
 #include <string_ext.h>
 #include <string.h>
 #include <tee/fs_htree.h>
+#include <tee/fs_htree_cache.h>
 #include <tee/tee_fs_key_manager.h>
 #include <tee/tee_fs_rpc.h>
 #include <utee_defines.h>
@@ -30,6 +32,13 @@
 
 #define NODE_ID_TO_BLOCK_NUM(id)	((id) - 1)
 
+/*
+ * Maximum size of the data blocks of a cached file kept in secure memory
+ * until the hash tree is synchronized, further blocks are written to
+ * storage right away. At least one block is kept whatever the block size.
+ */
+#define HTREE_MAX_WB_SIZE		(16 * 1024)
+
 /*
  * The hash tree is implemented as a binary tree with the purpose to ensure
  * integrity of the data in the nodes. The data in the nodes their turn
@@ -81,6 +90,7 @@ struct htree_node {
 	bool dirty;
 	bool block_updated;
 	struct tee_fs_htree_node_image node;
+	void *wb_block; /* Updated block not written to storage yet */
 	struct htree_node *parent;
 	struct htree_node *child[2];
 };
@@ -94,6 +104,11 @@ struct tee_fs_htree {
 	const TEE_UUID *uuid;
 	const struct tee_fs_htree_storage *stor;
 	void *stor_aux;
+	bool cached;
+	uint32_t cache_id;
+	size_t cache_hits;
+	size_t num_wb_blocks;
+	size_t block_size;
 };
 
 struct traverse_arg;
@@ -113,6 +128,12 @@ static TEE_Result rpc_read(struct tee_fs_htree *ht, enum tee_fs_htree_type type,
 	size_t bytes;
 	void *p;
 
+	if (ht->cached && tee_fs_htree_cache_get(ht->cache_id, type, idx, vers,
+						 NULL, data, dlen)) {
+		ht->cache_hits++;
+		return TEE_SUCCESS;
+	}
+
 	res = ht->stor->rpc_read_init(ht->stor_aux, &op, type, idx, vers, &p);
 	if (res != TEE_SUCCESS)
 		return res;
@@ -125,6 +146,13 @@ static TEE_Result rpc_read(struct tee_fs_htree *ht, enum tee_fs_htree_type type,
 		return TEE_ERROR_CORRUPT_OBJECT;
 
 	memcpy(data, p, dlen);
+
+	if (ht->cached) {
+		tee_fs_htree_cache_count_rpc(false);
+		tee_fs_htree_cache_put(ht->cache_id, type, idx, vers, NULL,
+				       data, dlen);
+	}
+
 	return TEE_SUCCESS;
 }
 
@@ -151,12 +179,26 @@ static TEE_Result rpc_write(struct tee_fs_htree *ht,
 	struct tee_fs_rpc_operation op;
 	void *p;
 
+	/* Storage is in an unknown state if the write fails */
+	if (ht->cached)
+		tee_fs_htree_cache_remove(ht->cache_id, type, idx, vers);
+
 	res = ht->stor->rpc_write_init(ht->stor_aux, &op, type, idx, vers, &p);
 	if (res != TEE_SUCCESS)
 		return res;
 
 	memcpy(p, data, dlen);
-	return ht->stor->rpc_write_final(&op);
+	res = ht->stor->rpc_write_final(&op);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	if (ht->cached) {
+		tee_fs_htree_cache_count_rpc(true);
+		tee_fs_htree_cache_put(ht->cache_id, type, idx, vers, NULL,
+				       data, dlen);
+	}
+
+	return TEE_SUCCESS;
 }
 
 static TEE_Result rpc_write_head(struct tee_fs_htree *ht, size_t vers,
@@ -611,6 +653,60 @@ static TEE_Result init_root_node(struct tee_fs_htree *ht)
 	return res;
 }
 
+static TEE_Result init_block_size(struct tee_fs_htree *ht)
+{
+	uint32_t shift = ht->imeta.block_shift;
+
+	if (!shift) {
+		ht->block_size = ht->stor->block_size;
+	} else {
+		if (shift > TEE_FS_HTREE_MAX_BLOCK_SHIFT)
+			return TEE_ERROR_NOT_SUPPORTED;
+		ht->block_size = BIT(shift);
+	}
+
+	/* The location of nodes in storage may depend on the block size */
+	if (ht->stor->set_block_size)
+		ht->stor->set_block_size(ht->stor_aux, ht->block_size);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result open_from_data(struct tee_fs_htree *ht, uint8_t *hash)
+{
+	TEE_Result res;
+
+	res = init_head_from_data(ht, hash);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = verify_root(ht);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = init_block_size(ht);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = init_tree_from_data(ht);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	return verify_tree(ht);
+}
+
+static TEE_Result free_node(struct traverse_arg *targ,
+			    struct htree_node *node);
+
+static void reset_tree(struct tee_fs_htree *ht)
+{
+	htree_traverse_post_order(ht, free_node, NULL);
+	memset(&ht->root, 0, sizeof(ht->root));
+	memset(&ht->head, 0, sizeof(ht->head));
+	memset(&ht->imeta, 0, sizeof(ht->imeta));
+	memzero_explicit(ht->fek, sizeof(ht->fek));
+}
+
 TEE_Result tee_fs_htree_open(bool create, uint8_t *hash, const TEE_UUID *uuid,
 			     const struct tee_fs_htree_storage *stor,
 			     void *stor_aux, struct tee_fs_htree **ht_ret)
@@ -624,10 +720,21 @@ TEE_Result tee_fs_htree_open(bool create, uint8_t *hash, const TEE_UUID *uuid,
 	ht->uuid = uuid;
 	ht->stor = stor;
 	ht->stor_aux = stor_aux;
+	if (IS_ENABLED(CFG_REE_FS_BLOCK_CACHE) && stor->get_cache_id)
+		ht->cached = stor->get_cache_id(stor_aux, &ht->cache_id);
 
 	if (create) {
 		const struct tee_fs_htree_image dummy_head = { .counter = 0 };
 
+		/* The id may belong to a file which has been removed */
+		if (ht->cached)
+			tee_fs_htree_cache_remove_id(ht->cache_id);
+
+		ht->imeta.block_shift = stor->create_block_shift;
+		res = init_block_size(ht);
+		if (res != TEE_SUCCESS)
+			goto out;
+
 		res = crypto_rng_read(ht->fek, sizeof(ht->fek));
 		if (res != TEE_SUCCESS)
 			goto out;
@@ -647,19 +754,18 @@ TEE_Result tee_fs_htree_open(bool create, uint8_t *hash, const TEE_UUID *uuid,
 			goto out;
 		res = rpc_write_head(ht, 0, &dummy_head);
 	} else {
-		res = init_head_from_data(ht, hash);
-		if (res != TEE_SUCCESS)
-			goto out;
-
-		res = verify_root(ht);
-		if (res != TEE_SUCCESS)
-			goto out;
-
-		res = init_tree_from_data(ht);
-		if (res != TEE_SUCCESS)
-			goto out;
-
-		res = verify_tree(ht);
+		res = open_from_data(ht, hash);
+		if (res != TEE_SUCCESS && ht->cache_hits) {
+			/*
+			 * The cache is supposed to match the storage, but
+			 * rather than failing on a stale element drop the
+			 * cached elements of the file and read it again.
+			 */
+			DMSG("Retrying without cache: %#"PRIx32, res);
+			tee_fs_htree_cache_remove_id(ht->cache_id);
+			reset_tree(ht);
+			res = open_from_data(ht, hash);
+		}
 	}
 out:
 	if (res == TEE_SUCCESS)
@@ -674,15 +780,76 @@ struct tee_fs_htree_meta *tee_fs_htree_get_meta(struct tee_fs_htree *ht)
 	return &ht->imeta.meta;
 }
 
+size_t tee_fs_htree_get_block_size(struct tee_fs_htree *ht)
+{
+	return ht->block_size;
+}
+
 void tee_fs_htree_meta_set_dirty(struct tee_fs_htree *ht)
 {
 	ht->dirty = true;
 	ht->root.dirty = true;
 }
 
-static TEE_Result free_node(struct traverse_arg *targ __unused,
+static void free_wb_block(struct tee_fs_htree *ht, struct htree_node *node)
+{
+	if (!node->wb_block)
+		return;
+
+	memzero_explicit(node->wb_block, ht->block_size);
+	free(node->wb_block);
+	node->wb_block = NULL;
+	ht->num_wb_blocks--;
+}
+
+static TEE_Result write_block_to_storage(struct tee_fs_htree *ht,
+					 struct htree_node *node,
+					 const void *block)
+{
+	TEE_Result res;
+	struct tee_fs_rpc_operation op;
+	size_t block_num = NODE_ID_TO_BLOCK_NUM(node->id);
+	uint8_t block_vers = !!(node->node.flags & HTREE_NODE_COMMITTED_BLOCK);
+	void *ctx;
+	void *enc_block;
+
+	if (ht->cached)
+		tee_fs_htree_cache_remove(ht->cache_id, TEE_FS_HTREE_TYPE_BLOCK,
+					  block_num, block_vers);
+
+	res = ht->stor->rpc_write_init(ht->stor_aux, &op,
+				       TEE_FS_HTREE_TYPE_BLOCK, block_num,
+				       block_vers, &enc_block);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = authenc_init(&ctx, TEE_MODE_ENCRYPT, ht, &node->node,
+			   ht->block_size);
+	if (res != TEE_SUCCESS)
+		return res;
+	res = authenc_encrypt_final(ctx, node->node.tag, block,
+				    ht->block_size, enc_block);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = ht->stor->rpc_write_final(&op);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	if (ht->cached) {
+		tee_fs_htree_cache_count_rpc(true);
+		tee_fs_htree_cache_put(ht->cache_id, TEE_FS_HTREE_TYPE_BLOCK,
+				       block_num, block_vers, node->node.tag,
+				       block, ht->block_size);
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result free_node(struct traverse_arg *targ,
 			    struct htree_node *node)
 {
+	free_wb_block(targ->ht, node);
 	if (node->parent)
 		free(node);
 	return TEE_SUCCESS;
@@ -697,9 +864,32 @@ void tee_fs_htree_close(struct tee_fs_htree **ht)
 	*ht = NULL;
 }
 
-static TEE_Result htree_sync_node_to_storage(struct traverse_arg *targ,
-					     struct htree_node *node)
+/*
+ * struct dirty_node - a node hashed but not written to storage yet
+ * @node:	the node
+ * @vers:	version of the node image to write
+ */
+struct dirty_node {
+	struct htree_node *node;
+	uint8_t vers;
+};
+
+/*
+ * struct sync_arg - state of tee_fs_htree_sync_to_storage()
+ * @hash_ctx:	hash context used for all the nodes
+ * @nodes:	dirty nodes
+ * @num_nodes:	number of nodes in @nodes
+ */
+struct sync_arg {
+	void *hash_ctx;
+	struct dirty_node *nodes;
+	size_t num_nodes;
+};
+
+static TEE_Result htree_hash_dirty_node(struct traverse_arg *targ,
+					struct htree_node *node)
 {
+	struct sync_arg *sarg = targ->arg;
 	TEE_Result res;
 	uint8_t vers;
 	struct tee_fs_htree_meta *meta = NULL;
@@ -714,6 +904,14 @@ static TEE_Result htree_sync_node_to_storage(struct traverse_arg *targ,
 	if (!node->dirty)
 		return TEE_SUCCESS;
 
+	/* The tag of the block is part of the node, write it first */
+	if (node->wb_block) {
+		res = write_block_to_storage(targ->ht, node, node->wb_block);
+		if (res != TEE_SUCCESS)
+			return res;
+		free_wb_block(targ->ht, node);
+	}
+
 	if (node->parent) {
 		uint32_t f = HTREE_NODE_COMMITTED_CHILD(node->id & 1);
 
@@ -729,14 +927,51 @@ static TEE_Result htree_sync_node_to_storage(struct traverse_arg *targ,
 		meta = &targ->ht->imeta.meta;
 	}
 
-	res = calc_node_hash(node, meta, targ->arg, node->node.hash);
+	res = calc_node_hash(node, meta, sarg->hash_ctx, node->node.hash);
 	if (res != TEE_SUCCESS)
 		return res;
 
 	node->dirty = false;
 	node->block_updated = false;
 
-	return rpc_write_node(targ->ht, node->id, vers, &node->node);
+	sarg->nodes[sarg->num_nodes].node = node;
+	sarg->nodes[sarg->num_nodes].vers = vers;
+	sarg->num_nodes++;
+
+	return TEE_SUCCESS;
+}
+
+static int cmp_dirty_node(const void *a, const void *b)
+{
+	const struct dirty_node *dn_a = a;
+	const struct dirty_node *dn_b = b;
+
+	return CMP_TRILEAN(dn_a->node->id, dn_b->node->id);
+}
+
+static TEE_Result write_dirty_nodes(struct tee_fs_htree *ht,
+				    struct sync_arg *sarg)
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct dirty_node *dn = NULL;
+	size_t n = 0;
+
+	/*
+	 * Node images are stored in order of node id, writing them in
+	 * that order gives sequential writes to the storage.
+	 */
+	qsort(sarg->nodes, sarg->num_nodes, sizeof(*sarg->nodes),
+	      cmp_dirty_node);
+
+	for (n = 0; n < sarg->num_nodes; n++) {
+		dn = sarg->nodes + n;
+		res = rpc_write_node(ht, dn->node->id, dn->vers,
+				     &dn->node->node);
+		if (res != TEE_SUCCESS)
+			return res;
+	}
+
+	return TEE_SUCCESS;
 }
 
 static TEE_Result update_root(struct tee_fs_htree *ht)
@@ -759,7 +994,7 @@ TEE_Result tee_fs_htree_sync_to_storage(struct tee_fs_htree **ht_arg,
 {
 	TEE_Result res;
 	struct tee_fs_htree *ht = *ht_arg;
-	void *ctx;
+	struct sync_arg sarg = { };
 
 	if (!ht)
 		return TEE_ERROR_CORRUPT_OBJECT;
@@ -767,11 +1002,27 @@ TEE_Result tee_fs_htree_sync_to_storage(struct tee_fs_htree **ht_arg,
 	if (!ht->dirty)
 		return TEE_SUCCESS;
 
-	res = crypto_hash_alloc_ctx(&ctx, TEE_FS_HTREE_HASH_ALG);
+	/* The root node isn't accounted for in max_node_id until extended */
+	sarg.nodes = calloc(MAX(ht->imeta.max_node_id, 1U),
+			    sizeof(*sarg.nodes));
+	if (!sarg.nodes) {
+		res = TEE_ERROR_OUT_OF_MEMORY;
+		goto out;
+	}
+
+	res = crypto_hash_alloc_ctx(&sarg.hash_ctx, TEE_FS_HTREE_HASH_ALG);
 	if (res != TEE_SUCCESS)
-		return res;
+		goto out;
+
+	/*
+	 * Hash all dirty nodes in one pass with the same hash context,
+	 * then write them out.
+	 */
+	res = htree_traverse_post_order(ht, htree_hash_dirty_node, &sarg);
+	if (res != TEE_SUCCESS)
+		goto out;
 
-	res = htree_traverse_post_order(ht, htree_sync_node_to_storage, ctx);
+	res = write_dirty_nodes(ht, &sarg);
 	if (res != TEE_SUCCESS)
 		goto out;
 
@@ -788,7 +1039,8 @@ TEE_Result tee_fs_htree_sync_to_storage(struct tee_fs_htree **ht_arg,
 	if (hash)
 		memcpy(hash, ht->root.node.hash, sizeof(ht->root.node.hash));
 out:
-	crypto_hash_free_ctx(ctx);
+	crypto_hash_free_ctx(sarg.hash_ctx);
+	free(sarg.nodes);
 	if (res != TEE_SUCCESS)
 		tee_fs_htree_close(ht_arg);
 	return res;
@@ -812,11 +1064,7 @@ TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht_arg,
 {
 	struct tee_fs_htree *ht = *ht_arg;
 	TEE_Result res;
-	struct tee_fs_rpc_operation op;
 	struct htree_node *node = NULL;
-	uint8_t block_vers;
-	void *ctx;
-	void *enc_block;
 
 	if (!ht)
 		return TEE_ERROR_CORRUPT_OBJECT;
@@ -828,23 +1076,22 @@ TEE_Result tee_fs_htree_write_block(struct tee_fs_htree **ht_arg,
 	if (!node->block_updated)
 		node->node.flags ^= HTREE_NODE_COMMITTED_BLOCK;
 
-	block_vers = !!(node->node.flags & HTREE_NODE_COMMITTED_BLOCK);
-	res = ht->stor->rpc_write_init(ht->stor_aux, &op,
-				       TEE_FS_HTREE_TYPE_BLOCK, block_num,
-				       block_vers, &enc_block);
-	if (res != TEE_SUCCESS)
-		goto out;
-
-	res = authenc_init(&ctx, TEE_MODE_ENCRYPT, ht, &node->node,
-			   ht->stor->block_size);
-	if (res != TEE_SUCCESS)
-		goto out;
-	res = authenc_encrypt_final(ctx, node->node.tag, block,
-				    ht->stor->block_size, enc_block);
-	if (res != TEE_SUCCESS)
-		goto out;
+	/*
+	 * Blocks of cached files are written back when the hash tree is
+	 * synchronized, a block updated several times before that is only
+	 * encrypted and written once.
+	 */
+	if (ht->cached && !node->wb_block &&
+	    ht->num_wb_blocks * ht->block_size < HTREE_MAX_WB_SIZE) {
+		node->wb_block = malloc(ht->block_size);
+		if (node->wb_block)
+			ht->num_wb_blocks++;
+	}
 
-	res = ht->stor->rpc_write_final(&op);
+	if (node->wb_block)
+		memcpy(node->wb_block, block, ht->block_size);
+	else
+		res = write_block_to_storage(ht, node, block);
 	if (res != TEE_SUCCESS)
 		goto out;
 
@@ -876,7 +1123,18 @@ TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht_arg,
 	if (res != TEE_SUCCESS)
 		goto out;
 
+	if (node->wb_block) {
+		memcpy(block, node->wb_block, ht->block_size);
+		goto out;
+	}
+
 	block_vers = !!(node->node.flags & HTREE_NODE_COMMITTED_BLOCK);
+	if (ht->cached &&
+	    tee_fs_htree_cache_get(ht->cache_id, TEE_FS_HTREE_TYPE_BLOCK,
+				   block_num, block_vers, node->node.tag,
+				   block, ht->block_size))
+		goto out;
+
 	res = ht->stor->rpc_read_init(ht->stor_aux, &op,
 				      TEE_FS_HTREE_TYPE_BLOCK, block_num,
 				      block_vers, &enc_block);
@@ -886,18 +1144,24 @@ TEE_Result tee_fs_htree_read_block(struct tee_fs_htree **ht_arg,
 	res = ht->stor->rpc_read_final(&op, &len);
 	if (res != TEE_SUCCESS)
 		goto out;
-	if (len != ht->stor->block_size) {
+	if (len != ht->block_size) {
 		res = TEE_ERROR_CORRUPT_OBJECT;
 		goto out;
 	}
 
 	res = authenc_init(&ctx, TEE_MODE_DECRYPT, ht, &node->node,
-			   ht->stor->block_size);
+			   ht->block_size);
 	if (res != TEE_SUCCESS)
 		goto out;
 
 	res = authenc_decrypt_final(ctx, node->node.tag, enc_block,
-				    ht->stor->block_size, block);
+				    ht->block_size, block);
+	if (res == TEE_SUCCESS && ht->cached) {
+		tee_fs_htree_cache_count_rpc(false);
+		tee_fs_htree_cache_put(ht->cache_id, TEE_FS_HTREE_TYPE_BLOCK,
+				       block_num, block_vers, node->node.tag,
+				       block, ht->block_size);
+	}
 out:
 	if (res != TEE_SUCCESS)
 		tee_fs_htree_close(ht_arg);
@@ -920,6 +1184,9 @@ TEE_Result tee_fs_htree_truncate(struct tee_fs_htree **ht_arg, size_t block_num)
 		assert(node->parent);
 		assert(node->parent->child[node->id & 1] == node);
 		node->parent->child[node->id & 1] = NULL;
+		/* The hash of the parent covers the removed node */
+		node->parent->dirty = true;
+		free_wb_block(ht, node);
 		free(node);
 		ht->imeta.max_node_id--;
 		ht->dirty = true;
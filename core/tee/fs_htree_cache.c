@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#include <kernel/mutex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_ext.h>
+#include <sys/queue.h>
+#include <tee/fs_htree_cache.h>
+#include <trace.h>
+#include <util.h>
+
+#define CACHE_NUM_BUCKETS	64
+
+/* A data block and the header of its element must fit in the cache */
+#if CFG_REE_FS_BLOCK_CACHE_SIZE < (2 << CFG_REE_FS_BLOCK_SHIFT)
+#error CFG_REE_FS_BLOCK_CACHE_SIZE too small for CFG_REE_FS_BLOCK_SHIFT
+#endif
+
+/*
+ * struct cache_ent - a cached hash tree element
+ * @lru_link:	link in @cache_lru, most recently used first
+ * @hash_link:	link in the bucket of the element
+ * @id:		file id
+ * @idx:	index of the element
+ * @type:	enum tee_fs_htree_type
+ * @vers:	version of the element
+ * @tag:	authentication tag of a data block, unused for other elements
+ * @len:	size of @data
+ * @data:	the element, decrypted for data blocks
+ */
+struct cache_ent {
+	TAILQ_ENTRY(cache_ent) lru_link;
+	SLIST_ENTRY(cache_ent) hash_link;
+	uint32_t id;
+	uint32_t idx;
+	uint8_t type;
+	uint8_t vers;
+	uint8_t tag[TEE_FS_HTREE_TAG_SIZE];
+	size_t len;
+	uint8_t data[];
+};
+
+SLIST_HEAD(cache_bucket, cache_ent);
+
+static TAILQ_HEAD(cache_lru_head, cache_ent) cache_lru =
+	TAILQ_HEAD_INITIALIZER(cache_lru);
+static struct cache_bucket cache_buckets[CACHE_NUM_BUCKETS];
+static struct tee_fs_htree_cache_stats cache_stats = {
+	.max_size = CFG_REE_FS_BLOCK_CACHE_SIZE,
+};
+static struct mutex cache_mu = MUTEX_INITIALIZER;
+
+static size_t ent_size(size_t len)
+{
+	return sizeof(struct cache_ent) + len;
+}
+
+static struct cache_bucket *get_bucket(uint32_t id,
+				       enum tee_fs_htree_type type,
+				       size_t idx, uint8_t vers)
+{
+	uint32_t h = id * 31 + (idx << 3) + (type << 1) + vers;
+
+	return cache_buckets + (h % CACHE_NUM_BUCKETS);
+}
+
+/* Called with cache_mu held */
+static struct cache_ent *find_ent(uint32_t id, enum tee_fs_htree_type type,
+				  size_t idx, uint8_t vers)
+{
+	struct cache_bucket *b = get_bucket(id, type, idx, vers);
+	struct cache_ent *e = NULL;
+
+	SLIST_FOREACH(e, b, hash_link)
+		if (e->id == id && e->type == type && e->idx == idx &&
+		    e->vers == vers)
+			return e;
+
+	return NULL;
+}
+
+/* Called with cache_mu held */
+static void remove_ent(struct cache_ent *e)
+{
+	SLIST_REMOVE(get_bucket(e->id, e->type, e->idx, e->vers), e,
+		     cache_ent, hash_link);
+	TAILQ_REMOVE(&cache_lru, e, lru_link);
+	cache_stats.size -= ent_size(e->len);
+	cache_stats.count--;
+	/* Data blocks are plain text */
+	memzero_explicit(e->data, e->len);
+	free(e);
+}
+
+bool tee_fs_htree_cache_get(uint32_t id, enum tee_fs_htree_type type,
+			    size_t idx, uint8_t vers, const uint8_t *tag,
+			    void *data, size_t len)
+{
+	struct cache_ent *e = NULL;
+	bool ret = false;
+
+	mutex_lock(&cache_mu);
+	e = find_ent(id, type, idx, vers);
+	if (e && e->len == len &&
+	    (!tag || !consttime_memcmp(e->tag, tag, sizeof(e->tag)))) {
+		memcpy(data, e->data, len);
+		TAILQ_REMOVE(&cache_lru, e, lru_link);
+		TAILQ_INSERT_HEAD(&cache_lru, e, lru_link);
+		cache_stats.hits++;
+		ret = true;
+	} else {
+		cache_stats.misses++;
+	}
+	mutex_unlock(&cache_mu);
+
+	return ret;
+}
+
+void tee_fs_htree_cache_put(uint32_t id, enum tee_fs_htree_type type,
+			    size_t idx, uint8_t vers, const uint8_t *tag,
+			    const void *data, size_t len)
+{
+	struct cache_ent *e = NULL;
+
+	if (ent_size(len) > CFG_REE_FS_BLOCK_CACHE_SIZE)
+		return;
+
+	mutex_lock(&cache_mu);
+
+	e = find_ent(id, type, idx, vers);
+	if (e)
+		remove_ent(e);
+
+	while (cache_stats.size + ent_size(len) > CFG_REE_FS_BLOCK_CACHE_SIZE) {
+		remove_ent(TAILQ_LAST(&cache_lru, cache_lru_head));
+		cache_stats.evictions++;
+	}
+
+	e = malloc(ent_size(len));
+	if (!e)
+		goto out;
+
+	e->id = id;
+	e->idx = idx;
+	e->type = type;
+	e->vers = vers;
+	if (tag)
+		memcpy(e->tag, tag, sizeof(e->tag));
+	else
+		memset(e->tag, 0, sizeof(e->tag));
+	e->len = len;
+	memcpy(e->data, data, len);
+
+	SLIST_INSERT_HEAD(get_bucket(id, type, idx, vers), e, hash_link);
+	TAILQ_INSERT_HEAD(&cache_lru, e, lru_link);
+	cache_stats.size += ent_size(len);
+	cache_stats.count++;
+out:
+	mutex_unlock(&cache_mu);
+}
+
+void tee_fs_htree_cache_remove(uint32_t id, enum tee_fs_htree_type type,
+			       size_t idx, uint8_t vers)
+{
+	struct cache_ent *e = NULL;
+
+	mutex_lock(&cache_mu);
+	e = find_ent(id, type, idx, vers);
+	if (e)
+		remove_ent(e);
+	mutex_unlock(&cache_mu);
+}
+
+void tee_fs_htree_cache_remove_id(uint32_t id)
+{
+	struct cache_ent *next = NULL;
+	struct cache_ent *e = NULL;
+
+	mutex_lock(&cache_mu);
+	TAILQ_FOREACH_SAFE(e, &cache_lru, lru_link, next)
+		if (e->id == id)
+			remove_ent(e);
+	mutex_unlock(&cache_mu);
+}
+
+void tee_fs_htree_cache_count_rpc(bool write)
+{
+	mutex_lock(&cache_mu);
+	if (write)
+		cache_stats.rpc_writes++;
+	else
+		cache_stats.rpc_reads++;
+	mutex_unlock(&cache_mu);
+}
+
+void tee_fs_htree_cache_get_stats(struct tee_fs_htree_cache_stats *stats)
+{
+	mutex_lock(&cache_mu);
+	*stats = cache_stats;
+	mutex_unlock(&cache_mu);
+}
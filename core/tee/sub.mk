@@ -28,6 +28,7 @@ srcs-y += tee_obj.c
 srcs-y += tee_svc.c
 srcs-y += tee_svc_cryp.c
 srcs-y += tee_svc_storage.c
+srcs-$(CFG_STORAGE_HEAD_CACHE) += tee_svc_storage_cache.c
 cppflags-tee_svc.c-y += -DTEE_IMPL_VERSION=$(TEE_IMPL_VERSION)
 srcs-y += tee_time_generic.c
 srcs-$(CFG_SECSTOR_TA) += tadb.c
@@ -40,6 +41,7 @@ srcs-$(CFG_RPMB_FS) += tee_rpmb_fs.c
 srcs-$(CFG_REE_FS) += tee_ree_fs.c
 srcs-$(CFG_REE_FS) += fs_dirfile.c
 srcs-$(CFG_REE_FS) += fs_htree.c
+srcs-$(CFG_REE_FS_BLOCK_CACHE) += fs_htree_cache.c
 srcs-$(CFG_REE_FS) += tee_fs_rpc.c
 
 ifeq ($(call cfg-one-enabled,CFG_WITH_USER_TA _CFG_WITH_SECURE_STORAGE),y)
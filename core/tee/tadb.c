@@ -12,6 +12,7 @@
 #include <optee_rpc_cmd.h>
 #include <stdio.h>
 #include <string.h>
+#include <string_ext.h>
 #include <tee_api_defines_extensions.h>
 #include <tee/tadb.h>
 #include <tee/tee_fs.h>
@@ -73,10 +74,38 @@ struct tee_tadb_ta_read {
 	uint8_t *ta_buf;
 };
 
+/*
+ * struct tadb_index_ent - in-memory copy of the lookup fields of an entry
+ * @uuid:	 UUID of the TA, null if the entry is free
+ * @file_number: encrypted TA is stored in <file_number>.ta
+ */
+struct tadb_index_ent {
+	TEE_UUID uuid;
+	uint32_t file_number;
+};
+
+/*
+ * struct tadb_index - index of the entries in ta.db
+ * @ents:	Array of @num_ents entries, @ents[n] mirrors entry n of ta.db
+ * @num_ents:	Number of entries in ta.db
+ * @valid:	True if the index has been built and is up to date
+ *
+ * The index is built by reading ta.db once and is updated each time an
+ * entry is written. It outlives struct tee_tadb_dir so that loading a TA
+ * only reads the entry of that TA.
+ */
+struct tadb_index {
+	struct tadb_index_ent *ents;
+	size_t num_ents;
+	bool valid;
+};
+
 static const char tadb_obj_id[] = "ta.db";
 static struct tee_tadb_dir *tadb_db;
 static unsigned int tadb_db_refc;
 static struct mutex tadb_mutex = MUTEX_INITIALIZER;
+/* Protected by tadb_mutex */
+static struct tadb_index tadb_index;
 
 static void file_num_to_str(char *buf, size_t blen, uint32_t file_number)
 {
@@ -190,6 +219,39 @@ static bool test_file(struct tee_tadb_dir *db, int idx)
 	return false;
 }
 
+static void index_invalidate(void)
+{
+	free(tadb_index.ents);
+	tadb_index.ents = NULL;
+	tadb_index.num_ents = 0;
+	tadb_index.valid = false;
+}
+
+static void index_update(size_t idx, const struct tadb_entry *entry)
+{
+	struct tadb_index_ent *ents = NULL;
+	size_t n = 0;
+
+	if (!tadb_index.valid)
+		return;
+
+	if (idx >= tadb_index.num_ents) {
+		ents = realloc(tadb_index.ents, (idx + 1) * sizeof(*ents));
+		if (!ents) {
+			/* Rebuilt by the next lookup */
+			index_invalidate();
+			return;
+		}
+		for (n = tadb_index.num_ents; n < idx; n++)
+			memset(ents + n, 0, sizeof(*ents));
+		tadb_index.ents = ents;
+		tadb_index.num_ents = idx + 1;
+	}
+
+	tadb_index.ents[idx].uuid = entry->prop.uuid;
+	tadb_index.ents[idx].file_number = entry->file_number;
+}
+
 static TEE_Result read_ent(struct tee_tadb_dir *db, size_t idx,
 			   struct tadb_entry *entry)
 {
@@ -206,8 +268,44 @@ static TEE_Result write_ent(struct tee_tadb_dir *db, size_t idx,
 			    const struct tadb_entry *entry)
 {
 	const size_t l = sizeof(*entry);
+	TEE_Result res = db->ops->write(db->fh, idx * l, entry, l);
 
-	return db->ops->write(db->fh, idx * l, entry, l);
+	if (res)
+		index_invalidate();
+	else
+		index_update(idx, entry);
+
+	return res;
+}
+
+/* Reads all entries of ta.db once, unless the index is already valid */
+static TEE_Result index_build(struct tee_tadb_dir *db)
+{
+	struct tadb_entry entry = { };
+	TEE_Result res = TEE_SUCCESS;
+	size_t idx = 0;
+
+	if (tadb_index.valid)
+		return TEE_SUCCESS;
+
+	index_invalidate();
+	tadb_index.valid = true;
+	for (idx = 0;; idx++) {
+		res = read_ent(db, idx, &entry);
+		if (res) {
+			if (res == TEE_ERROR_ITEM_NOT_FOUND)
+				break;
+			index_invalidate();
+			return res;
+		}
+
+		index_update(idx, &entry);
+		if (!tadb_index.valid)
+			return TEE_ERROR_OUT_OF_MEMORY;
+	}
+	memzero_explicit(&entry, sizeof(entry));
+
+	return TEE_SUCCESS;
 }
 
 static TEE_Result tadb_open(struct tee_tadb_dir **db_ret)
@@ -225,9 +323,12 @@ static TEE_Result tadb_open(struct tee_tadb_dir **db_ret)
 	db->ops = tee_svc_storage_file_ops(TEE_STORAGE_PRIVATE);
 
 	res = db->ops->open(&po, NULL, &db->fh);
-	if (res == TEE_ERROR_ITEM_NOT_FOUND)
+	if (res == TEE_ERROR_ITEM_NOT_FOUND) {
+		/* The index may describe a ta.db which has been removed */
+		index_invalidate();
 		res = db->ops->create(&po, false, NULL, 0, NULL, 0, NULL, 0,
 				      &db->fh);
+	}
 
 	if (res)
 		free(db);
@@ -312,6 +413,8 @@ static TEE_Result tadb_update_payload(void *ctx, TEE_OperationMode mode,
 
 static TEE_Result populate_files(struct tee_tadb_dir *db)
 {
+	const struct tadb_entry null_entry = { { { 0 } } };
+	struct tadb_index_ent *ient = NULL;
 	TEE_Result res;
 	size_t idx;
 
@@ -322,10 +425,14 @@ static TEE_Result populate_files(struct tee_tadb_dir *db)
 	if (db->nbits)
 		return TEE_SUCCESS;
 
+	res = index_build(db);
+	if (res)
+		return res;
+
 	/*
-	 * Iterate over the TA database and set the bits in the bit field
-	 * for used file numbers. Note that set_file() will allocate and
-	 * grow the bitfield as needed.
+	 * Iterate over the TA database index and set the bits in the bit
+	 * field for used file numbers. Note that set_file() will allocate
+	 * and grow the bitfield as needed.
 	 *
 	 * At the same time clean out duplicate file numbers, the first
 	 * entry with the file number has precedence. Duplicate entries is
@@ -333,34 +440,28 @@ static TEE_Result populate_files(struct tee_tadb_dir *db)
 	 * to clean it out here instead of letting the error spread with
 	 * unexpected side effects.
 	 */
-	for (idx = 0;; idx++) {
-		struct tadb_entry entry;
-
-		res = read_ent(db, idx, &entry);
-		if (res) {
-			if (res == TEE_ERROR_ITEM_NOT_FOUND)
-				return TEE_SUCCESS;
-			goto err;
-		}
+	for (idx = 0; idx < tadb_index.num_ents; idx++) {
+		ient = tadb_index.ents + idx;
 
-		if (is_null_uuid(&entry.prop.uuid))
+		if (is_null_uuid(&ient->uuid))
 			continue;
 
-		if (test_file(db, entry.file_number)) {
+		if (test_file(db, ient->file_number)) {
 			IMSG("Clearing duplicate file number %" PRIu32,
-			     entry.file_number);
-			memset(&entry, 0, sizeof(entry));
-			res = write_ent(db, idx, &entry);
+			     ient->file_number);
+			res = write_ent(db, idx, &null_entry);
 			if (res)
 				goto err;
 			continue;
 		}
 
-		res = set_file(db, entry.file_number);
+		res = set_file(db, ient->file_number);
 		if (res)
 			goto err;
 	}
 
+	return TEE_SUCCESS;
+
 err:
 	free(db->files);
 	db->files = NULL;
@@ -492,11 +593,24 @@ void tee_tadb_ta_close_and_delete(struct tee_tadb_ta_write *ta)
 	free(ta);
 }
 
+static size_t index_find(const TEE_UUID *uuid)
+{
+	size_t idx = 0;
+
+	for (idx = 0; idx < tadb_index.num_ents; idx++)
+		if (!memcmp(&tadb_index.ents[idx].uuid, uuid, sizeof(*uuid)))
+			break;
+
+	return idx;
+}
+
 static TEE_Result find_ent(struct tee_tadb_dir *db, const TEE_UUID *uuid,
 			   size_t *idx_ret, struct tadb_entry *entry_ret)
 {
-	TEE_Result res;
-	size_t idx;
+	struct tadb_entry entry = { };
+	TEE_Result res = TEE_SUCCESS;
+	bool retried = false;
+	size_t idx = 0;
 
 	/*
 	 * Search for the provided uuid, if it's found return the index it
@@ -504,26 +618,38 @@ static TEE_Result find_ent(struct tee_tadb_dir *db, const TEE_UUID *uuid,
 	 *
 	 * If the uuid can't be found return the number indexes together
 	 * with TEE_ERROR_ITEM_NOT_FOUND.
+	 *
+	 * The search is done in the index, only the matching entry is read
+	 * from ta.db. If it doesn't match the index the index is rebuilt.
 	 */
-	for (idx = 0;; idx++) {
-		struct tadb_entry entry;
+again:
+	res = index_build(db);
+	if (res)
+		return res;
 
-		res = read_ent(db, idx, &entry);
-		if (res) {
-			if (res == TEE_ERROR_ITEM_NOT_FOUND)
-				break;
-			return res;
-		}
+	idx = index_find(uuid);
+	*idx_ret = idx;
+	if (idx == tadb_index.num_ents)
+		return TEE_ERROR_ITEM_NOT_FOUND;
 
-		if (!memcmp(&entry.prop.uuid, uuid, sizeof(*uuid))) {
-			if (entry_ret)
-				*entry_ret = entry;
-			break;
-		}
+	res = read_ent(db, idx, &entry);
+	if (res && res != TEE_ERROR_ITEM_NOT_FOUND)
+		return res;
+	if (res || memcmp(&entry.prop.uuid, uuid, sizeof(*uuid))) {
+		memzero_explicit(&entry, sizeof(entry));
+		if (retried)
+			return TEE_ERROR_CORRUPT_OBJECT;
+		IMSG("Stale TA database index, rebuilding");
+		index_invalidate();
+		retried = true;
+		goto again;
 	}
 
-	*idx_ret = idx;
-	return res;
+	if (entry_ret)
+		*entry_ret = entry;
+	memzero_explicit(&entry, sizeof(entry));
+
+	return TEE_SUCCESS;
 }
 
 static TEE_Result find_free_ent_idx(struct tee_tadb_dir *db, size_t *idx)
@@ -647,9 +773,10 @@ TEE_Result tee_tadb_ta_open(const TEE_UUID *uuid,
 	if (res)
 		goto err_free; /* Mustn't call tadb_put() */
 
-	mutex_read_lock(&tadb_mutex);
+	/* Not a read lock, find_ent() may have to build the index */
+	mutex_lock(&tadb_mutex);
 	res = find_ent(ta->db, uuid, &idx, &ta->entry);
-	mutex_read_unlock(&tadb_mutex);
+	mutex_unlock(&tadb_mutex);
 	if (res)
 		goto err;
 
@@ -4,6 +4,7 @@
  */
 
 #include <assert.h>
+#include <atomic.h>
 #include <kernel/tee_misc.h>
 #include <kernel/thread.h>
 #include <mm/core_memprot.h>
@@ -24,6 +25,8 @@ struct tee_fs_dir {
 	struct tee_fs_dirent d;
 };
 
+static uint32_t rpc_count;
+
 /* "/dirf.db" or "/<file number>" */
 static TEE_Result create_filename(void *buf, size_t blen,
 				  const struct tee_fs_dirfile_fileh *dfh)
@@ -46,9 +49,15 @@ static TEE_Result create_filename(void *buf, size_t blen,
 
 static TEE_Result operation_commit(struct tee_fs_rpc_operation *op)
 {
+	atomic_inc32(&rpc_count);
 	return thread_rpc_cmd(op->id, op->num_params, op->params);
 }
 
+uint32_t tee_fs_rpc_get_count(void)
+{
+	return atomic_load_u32(&rpc_count);
+}
+
 static TEE_Result operation_open_dfh(uint32_t id, unsigned int cmd,
 				 const struct tee_fs_dirfile_fileh *dfh,
 				 int *fd)
@@ -3,16 +3,29 @@
  * Copyright (c) 2014, STMicroelectronics International N.V.
  */
 
+#include <fnv1a.h>
 #include <kernel/mutex.h>
 #include <stdlib.h>
 #include <string.h>
 #include <tee/tee_pobj.h>
 #include <trace.h>
 
-static TAILQ_HEAD(tee_pobjs, tee_pobj) tee_pobjs =
-		TAILQ_HEAD_INITIALIZER(tee_pobjs);
+#define POBJ_HASH_BUCKETS	64
+
+/* Open objects hashed by UUID and object ID, protected by pobjs_mutex */
+static LIST_HEAD(tee_pobjs, tee_pobj) tee_pobjs[POBJ_HASH_BUCKETS];
 static struct mutex pobjs_mutex = MUTEX_INITIALIZER;
 
+static struct tee_pobjs *get_bucket(const TEE_UUID *uuid, const void *obj_id,
+				    uint32_t obj_id_len)
+{
+	uint32_t h = fnv1a_hash(FNV1A_INIT, uuid, sizeof(*uuid));
+
+	h = fnv1a_hash(h, obj_id, obj_id_len);
+
+	return tee_pobjs + h % POBJ_HASH_BUCKETS;
+}
+
 static TEE_Result tee_pobj_check_access(uint32_t oflags, uint32_t nflags)
 {
 	/* meta is exclusive */
@@ -63,18 +76,20 @@ TEE_Result tee_pobj_get(TEE_UUID *uuid, void *obj_id, uint32_t obj_id_len,
 			struct tee_pobj **obj)
 {
 	TEE_Result res = TEE_SUCCESS;
+	struct tee_pobjs *bucket = get_bucket(uuid, obj_id, obj_id_len);
 	struct tee_pobj *o = NULL;
 
 	*obj = NULL;
 
 	mutex_lock(&pobjs_mutex);
 	/* Check if file is open */
-	TAILQ_FOREACH(o, &tee_pobjs, link) {
+	LIST_FOREACH(o, bucket, link) {
 		if ((obj_id_len == o->obj_id_len) &&
 		    (memcmp(obj_id, o->obj_id, obj_id_len) == 0) &&
 		    (memcmp(uuid, &o->uuid, sizeof(TEE_UUID)) == 0) &&
 		    (fops == o->fops)) {
 			*obj = o;
+			break;
 		}
 	}
 
@@ -120,7 +135,7 @@ TEE_Result tee_pobj_get(TEE_UUID *uuid, void *obj_id, uint32_t obj_id_len,
 	memcpy(o->obj_id, obj_id, obj_id_len);
 	o->obj_id_len = obj_id_len;
 
-	TAILQ_INSERT_TAIL(&tee_pobjs, o, link);
+	LIST_INSERT_HEAD(bucket, o, link);
 	*obj = o;
 
 	res = TEE_SUCCESS;
@@ -147,7 +162,7 @@ TEE_Result tee_pobj_release(struct tee_pobj *obj)
 	mutex_lock(&pobjs_mutex);
 	obj->refcnt--;
 	if (obj->refcnt == 0) {
-		TAILQ_REMOVE(&tee_pobjs, obj, link);
+		LIST_REMOVE(obj, link);
 		free(obj->obj_id);
 		free(obj);
 	}
@@ -178,11 +193,14 @@ TEE_Result tee_pobj_rename(struct tee_pobj *obj, void *obj_id,
 	}
 	memcpy(new_obj_id, obj_id, obj_id_len);
 
-	/* update internal data */
+	/* update internal data, the new object ID may hash differently */
+	LIST_REMOVE(obj, link);
 	free(obj->obj_id);
 	obj->obj_id = new_obj_id;
 	obj->obj_id_len = obj_id_len;
 	new_obj_id = NULL;
+	LIST_INSERT_HEAD(get_bucket(&obj->uuid, obj->obj_id, obj->obj_id_len),
+			 obj, link);
 
 exit:
 	mutex_unlock(&pobjs_mutex);
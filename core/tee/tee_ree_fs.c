@@ -26,15 +26,46 @@
 #include <utee_defines.h>
 #include <util.h>
 
+/*
+ * Size of the blocks holding the node images, and of the data blocks of
+ * files created without a recorded block size
+ */
 #define BLOCK_SHIFT	12
 
 #define BLOCK_SIZE	(1 << BLOCK_SHIFT)
 
+#if CFG_REE_FS_BLOCK_SHIFT < BLOCK_SHIFT || \
+	CFG_REE_FS_BLOCK_SHIFT > TEE_FS_HTREE_MAX_BLOCK_SHIFT
+#error CFG_REE_FS_BLOCK_SHIFT out of range
+#endif
+
+/*
+ * @block_size is the size of the data blocks, supplied by the hash tree
+ * with ree_fs_set_block_size() while @ht is opened. Only the head and
+ * the root node are accessed before that.
+ *
+ * @in_trans is true while the file is part of a transaction, changes are
+ * then kept in @ht until the transaction is committed. @trans_hash is the
+ * hash of the file as committed when the transaction was started.
+ * @trans_shrunk is true if the file was truncated to a smaller size in the
+ * transaction, the file in storage is then truncated once committed.
+ *
+ * @wb_pending is the number of bytes written but not committed yet with
+ * CFG_REE_FS_WRITE_BEHIND, such files are linked into @wb_fds with
+ * @wb_link.
+ */
 struct tee_fs_fd {
 	struct tee_fs_htree *ht;
 	int fd;
+	bool is_dirf;
+	bool in_trans;
+	bool trans_shrunk;
+	size_t block_size;
+	size_t wb_pending;
 	struct tee_fs_dirfile_fileh dfh;
+	uint8_t trans_hash[TEE_FS_HTREE_HASH_SIZE];
 	const TEE_UUID *uuid;
+	TAILQ_ENTRY(tee_fs_fd) wb_link;
 };
 
 struct tee_fs_dir {
@@ -44,32 +75,41 @@ struct tee_fs_dir {
 	const TEE_UUID *uuid;
 };
 
-static int pos_to_block_num(int position)
+static int pos_to_block_num(struct tee_fs_fd *fdp, int position)
 {
-	return position >> BLOCK_SHIFT;
+	return position / fdp->block_size;
 }
 
 static struct mutex ree_fs_mutex = MUTEX_INITIALIZER;
+static TAILQ_HEAD(, tee_fs_fd) wb_fds = TAILQ_HEAD_INITIALIZER(wb_fds);
 
-static void *get_tmp_block(void)
+static void *get_tmp_block(struct tee_fs_fd *fdp)
 {
+	/* Larger blocks don't fit in the default memory pool */
+	if (fdp->block_size > BLOCK_SIZE)
+		return malloc(fdp->block_size);
+
 	return mempool_alloc(mempool_default, BLOCK_SIZE);
 }
 
-static void put_tmp_block(void *tmp_block)
+static void put_tmp_block(struct tee_fs_fd *fdp, void *tmp_block)
 {
-	mempool_free(mempool_default, tmp_block);
+	if (fdp->block_size > BLOCK_SIZE)
+		free(tmp_block);
+	else
+		mempool_free(mempool_default, tmp_block);
 }
 
 static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 				     const void *buf, size_t len)
 {
 	TEE_Result res;
-	size_t start_block_num = pos_to_block_num(pos);
-	size_t end_block_num = pos_to_block_num(pos + len - 1);
+	size_t block_size = fdp->block_size;
+	size_t start_block_num = pos_to_block_num(fdp, pos);
+	size_t end_block_num = pos_to_block_num(fdp, pos + len - 1);
 	size_t remain_bytes = len;
 	uint8_t *data_ptr = (uint8_t *)buf;
-	uint8_t *block;
+	uint8_t *block = NULL;
 	struct tee_fs_htree_meta *meta = tee_fs_htree_get_meta(fdp->ht);
 
 	/*
@@ -80,25 +120,42 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 	if (!len)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	block = get_tmp_block();
-	if (!block)
-		return TEE_ERROR_OUT_OF_MEMORY;
-
 	while (start_block_num <= end_block_num) {
-		size_t offset = pos % BLOCK_SIZE;
-		size_t size_to_write = MIN(remain_bytes, (size_t)BLOCK_SIZE);
+		size_t offset = pos % block_size;
+		size_t size_to_write = MIN(remain_bytes, block_size);
+
+		if (size_to_write + offset > block_size)
+			size_to_write = block_size - offset;
 
-		if (size_to_write + offset > BLOCK_SIZE)
-			size_to_write = BLOCK_SIZE - offset;
+		/*
+		 * A block written in full is encrypted straight from the
+		 * caller's buffer, there's no need to read the old content.
+		 */
+		if (data_ptr && size_to_write == block_size) {
+			res = tee_fs_htree_write_block(&fdp->ht,
+						       start_block_num,
+						       data_ptr);
+			if (res != TEE_SUCCESS)
+				goto exit;
+			goto next;
+		}
 
-		if (start_block_num * BLOCK_SIZE <
-		    ROUNDUP(meta->length, BLOCK_SIZE)) {
+		if (!block) {
+			block = get_tmp_block(fdp);
+			if (!block) {
+				res = TEE_ERROR_OUT_OF_MEMORY;
+				goto exit;
+			}
+		}
+
+		if (start_block_num * block_size <
+		    ROUNDUP(meta->length, block_size)) {
 			res = tee_fs_htree_read_block(&fdp->ht,
 						      start_block_num, block);
 			if (res != TEE_SUCCESS)
 				goto exit;
 		} else {
-			memset(block, 0, BLOCK_SIZE);
+			memset(block, 0, block_size);
 		}
 
 		if (data_ptr)
@@ -111,6 +168,7 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 		if (res != TEE_SUCCESS)
 			goto exit;
 
+next:
 		if (data_ptr)
 			data_ptr += size_to_write;
 		remain_bytes -= size_to_write;
@@ -125,11 +183,31 @@ static TEE_Result out_of_place_write(struct tee_fs_fd *fdp, size_t pos,
 
 exit:
 	if (block)
-		put_tmp_block(block);
+		put_tmp_block(fdp, block);
 	return res;
 }
 
-static TEE_Result get_offs_size(enum tee_fs_htree_type type, size_t idx,
+/*
+ * Returns the offset of physical block @pbn. Physical block 0 and the
+ * physical blocks holding node images are BLOCK_SIZE large, the others
+ * are data blocks of @block_size.
+ */
+static size_t pbn_to_offs(size_t pbn, size_t block_nodes, size_t block_size)
+{
+	size_t num_node_blocks = 0;
+
+	if (!pbn)
+		return 0;
+
+	/* Node image blocks in [1, pbn) */
+	num_node_blocks = (pbn + block_nodes * 2 - 2) / (block_nodes * 2);
+
+	return BLOCK_SIZE * (1 + num_node_blocks) +
+	       block_size * (pbn - 1 - num_node_blocks);
+}
+
+static TEE_Result get_offs_size(struct tee_fs_fd *fdp,
+				enum tee_fs_htree_type type, size_t idx,
 				uint8_t vers, size_t *offs, size_t *size)
 {
 	const size_t node_size = sizeof(struct tee_fs_htree_node_image);
@@ -140,7 +218,10 @@ static TEE_Result get_offs_size(enum tee_fs_htree_type type, size_t idx,
 	assert(vers == 0 || vers == 1);
 
 	/*
-	 * File layout
+	 * File layout, with a data block size of BLOCK_SIZE. Larger data
+	 * blocks only change the size of the physical blocks holding data
+	 * blocks, see pbn_to_offs(). The head and the root node stay at the
+	 * same offsets whatever the size of the data blocks.
 	 * [demo with input:
 	 * BLOCK_SIZE = 4096,
 	 * node_size = 66,
@@ -196,7 +277,7 @@ static TEE_Result get_offs_size(enum tee_fs_htree_type type, size_t idx,
 		return TEE_SUCCESS;
 	case TEE_FS_HTREE_TYPE_NODE:
 		pbn = 1 + ((idx / block_nodes) * block_nodes * 2);
-		*offs = pbn * BLOCK_SIZE +
+		*offs = pbn_to_offs(pbn, block_nodes, fdp->block_size) +
 			2 * node_size * (idx % block_nodes) +
 			node_size * vers;
 		*size = node_size;
@@ -204,14 +285,27 @@ static TEE_Result get_offs_size(enum tee_fs_htree_type type, size_t idx,
 	case TEE_FS_HTREE_TYPE_BLOCK:
 		bidx = 2 * idx + vers;
 		pbn = 2 + bidx + bidx / (block_nodes * 2 - 1);
-		*offs = pbn * BLOCK_SIZE;
-		*size = BLOCK_SIZE;
+		*offs = pbn_to_offs(pbn, block_nodes, fdp->block_size);
+		*size = fdp->block_size;
 		return TEE_SUCCESS;
 	default:
 		return TEE_ERROR_GENERIC;
 	}
 }
 
+/*
+ * With CFG_REE_FS_BLOCK_CACHE=y existing files are opened in normal world
+ * when first accessed, a file served from the cache needs no RPC at all.
+ */
+static TEE_Result get_fd(struct tee_fs_fd *fdp)
+{
+	if (fdp->fd != -1)
+		return TEE_SUCCESS;
+
+	return tee_fs_rpc_open_dfh(OPTEE_RPC_CMD_FS,
+				   fdp->is_dirf ? NULL : &fdp->dfh, &fdp->fd);
+}
+
 static TEE_Result ree_fs_rpc_read_init(void *aux,
 				       struct tee_fs_rpc_operation *op,
 				       enum tee_fs_htree_type type, size_t idx,
@@ -222,7 +316,11 @@ static TEE_Result ree_fs_rpc_read_init(void *aux,
 	size_t offs;
 	size_t size;
 
-	res = get_offs_size(type, idx, vers, &offs, &size);
+	res = get_offs_size(fdp, type, idx, vers, &offs, &size);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = get_fd(fdp);
 	if (res != TEE_SUCCESS)
 		return res;
 
@@ -240,7 +338,11 @@ static TEE_Result ree_fs_rpc_write_init(void *aux,
 	size_t offs;
 	size_t size;
 
-	res = get_offs_size(type, idx, vers, &offs, &size);
+	res = get_offs_size(fdp, type, idx, vers, &offs, &size);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = get_fd(fdp);
 	if (res != TEE_SUCCESS)
 		return res;
 
@@ -248,14 +350,68 @@ static TEE_Result ree_fs_rpc_write_init(void *aux,
 				     offs, size, data);
 }
 
+static bool ree_fs_get_cache_id(void *aux, uint32_t *id)
+{
+	struct tee_fs_fd *fdp = aux;
+
+	/* 0 is dirf.db, file numbers start at 0 */
+	if (fdp->is_dirf)
+		*id = 0;
+	else
+		*id = fdp->dfh.file_number + 1;
+
+	return true;
+}
+
+static void ree_fs_set_block_size(void *aux, size_t block_size)
+{
+	struct tee_fs_fd *fdp = aux;
+
+	fdp->block_size = block_size;
+}
+
 static const struct tee_fs_htree_storage ree_fs_storage_ops = {
+	.block_size = BLOCK_SIZE,
+	.create_block_shift = CFG_REE_FS_BLOCK_SHIFT,
+	.rpc_read_init = ree_fs_rpc_read_init,
+	.rpc_read_final = tee_fs_rpc_read_final,
+	.rpc_write_init = ree_fs_rpc_write_init,
+	.rpc_write_final = tee_fs_rpc_write_final,
+	.get_cache_id = ree_fs_get_cache_id,
+	.set_block_size = ree_fs_set_block_size,
+};
+
+/* dirf.db is made of small entries, it keeps the default block size */
+static const struct tee_fs_htree_storage ree_dirf_storage_ops = {
 	.block_size = BLOCK_SIZE,
 	.rpc_read_init = ree_fs_rpc_read_init,
 	.rpc_read_final = tee_fs_rpc_read_final,
 	.rpc_write_init = ree_fs_rpc_write_init,
 	.rpc_write_final = tee_fs_rpc_write_final,
+	.get_cache_id = ree_fs_get_cache_id,
+	.set_block_size = ree_fs_set_block_size,
 };
 
+/* Removes the blocks and nodes past the end of the file from storage */
+static TEE_Result truncate_storage(struct tee_fs_fd *fdp, size_t len)
+{
+	TEE_Result res;
+	size_t offs;
+	size_t sz;
+
+	res = get_offs_size(fdp, TEE_FS_HTREE_TYPE_BLOCK,
+			    ROUNDUP(len, fdp->block_size) / fdp->block_size,
+			    1, &offs, &sz);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = get_fd(fdp);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	return tee_fs_rpc_truncate(OPTEE_RPC_CMD_FS, fdp->fd, offs + sz);
+}
+
 static TEE_Result ree_fs_ftruncate_internal(struct tee_fs_fd *fdp,
 					    tee_fs_off_t new_file_len)
 {
@@ -269,24 +425,23 @@ static TEE_Result ree_fs_ftruncate_internal(struct tee_fs_fd *fdp,
 		if (res != TEE_SUCCESS)
 			return res;
 	} else {
-		size_t offs;
-		size_t sz;
-
-		res = get_offs_size(TEE_FS_HTREE_TYPE_BLOCK,
-				    ROUNDUP(new_file_len, BLOCK_SIZE) /
-					BLOCK_SIZE, 1, &offs, &sz);
-		if (res != TEE_SUCCESS)
-			return res;
-
 		res = tee_fs_htree_truncate(&fdp->ht,
-					    new_file_len / BLOCK_SIZE);
+					    new_file_len / fdp->block_size);
 		if (res != TEE_SUCCESS)
 			return res;
 
-		res = tee_fs_rpc_truncate(OPTEE_RPC_CMD_FS, fdp->fd,
-					  offs + sz);
-		if (res != TEE_SUCCESS)
-			return res;
+		/*
+		 * The committed version of the file may still use the
+		 * elements past the new end until the transaction is
+		 * committed.
+		 */
+		if (fdp->in_trans) {
+			fdp->trans_shrunk = true;
+		} else {
+			res = truncate_storage(fdp, new_file_len);
+			if (res != TEE_SUCCESS)
+				return res;
+		}
 
 		meta->length = new_file_len;
 		tee_fs_htree_meta_set_dirty(fdp->ht);
@@ -320,27 +475,42 @@ static TEE_Result ree_fs_read_primitive(struct tee_file_handle *fh, size_t pos,
 		goto exit;
 	}
 
-	start_block_num = pos_to_block_num(pos);
-	end_block_num = pos_to_block_num(pos + remain_bytes - 1);
-
-	block = get_tmp_block();
-	if (!block) {
-		res = TEE_ERROR_OUT_OF_MEMORY;
-		goto exit;
-	}
+	start_block_num = pos_to_block_num(fdp, pos);
+	end_block_num = pos_to_block_num(fdp, pos + remain_bytes - 1);
 
 	while (start_block_num <= end_block_num) {
-		size_t offset = pos % BLOCK_SIZE;
-		size_t size_to_read = MIN(remain_bytes, (size_t)BLOCK_SIZE);
+		size_t offset = pos % fdp->block_size;
+		size_t size_to_read = MIN(remain_bytes, fdp->block_size);
 
-		if (size_to_read + offset > BLOCK_SIZE)
-			size_to_read = BLOCK_SIZE - offset;
+		if (size_to_read + offset > fdp->block_size)
+			size_to_read = fdp->block_size - offset;
 
-		res = tee_fs_htree_read_block(&fdp->ht, start_block_num, block);
-		if (res != TEE_SUCCESS)
-			goto exit;
+		/* A block read in full is decrypted straight into @buf */
+		if (size_to_read == fdp->block_size) {
+			res = tee_fs_htree_read_block(&fdp->ht,
+						      start_block_num,
+						      data_ptr);
+			if (res != TEE_SUCCESS) {
+				/* Don't leave unauthenticated data behind */
+				memset(data_ptr, 0, size_to_read);
+				goto exit;
+			}
+		} else {
+			if (!block) {
+				block = get_tmp_block(fdp);
+				if (!block) {
+					res = TEE_ERROR_OUT_OF_MEMORY;
+					goto exit;
+				}
+			}
 
-		memcpy(data_ptr, block + offset, size_to_read);
+			res = tee_fs_htree_read_block(&fdp->ht,
+						      start_block_num, block);
+			if (res != TEE_SUCCESS)
+				goto exit;
+
+			memcpy(data_ptr, block + offset, size_to_read);
+		}
 
 		data_ptr += size_to_read;
 		remain_bytes -= size_to_read;
@@ -351,7 +521,7 @@ static TEE_Result ree_fs_read_primitive(struct tee_file_handle *fh, size_t pos,
 	res = TEE_SUCCESS;
 exit:
 	if (block)
-		put_tmp_block(block);
+		put_tmp_block(fdp, block);
 	return res;
 }
 
@@ -361,7 +531,10 @@ static TEE_Result ree_fs_read(struct tee_file_handle *fh, size_t pos,
 	TEE_Result res;
 
 	mutex_lock(&ree_fs_mutex);
-	res = ree_fs_read_primitive(fh, pos, buf, len);
+	if (((struct tee_fs_fd *)fh)->ht)
+		res = ree_fs_read_primitive(fh, pos, buf, len);
+	else
+		res = TEE_ERROR_BAD_STATE;
 	mutex_unlock(&ree_fs_mutex);
 
 	return res;
@@ -404,24 +577,30 @@ static TEE_Result ree_fs_open_primitive(bool create, uint8_t *hash,
 		return TEE_ERROR_OUT_OF_MEMORY;
 	fdp->fd = -1;
 	fdp->uuid = uuid;
+	if (dfh) {
+		fdp->dfh = *dfh;
+	} else {
+		fdp->dfh.idx = -1;
+		fdp->is_dirf = true;
+	}
 
 	if (create)
 		res = tee_fs_rpc_create_dfh(OPTEE_RPC_CMD_FS,
 					    dfh, &fdp->fd);
-	else
+	else if (!IS_ENABLED(CFG_REE_FS_BLOCK_CACHE))
 		res = tee_fs_rpc_open_dfh(OPTEE_RPC_CMD_FS, dfh, &fdp->fd);
+	else
+		res = TEE_SUCCESS;
 
 	if (res != TEE_SUCCESS)
 		goto out;
 
-	res = tee_fs_htree_open(create, hash, uuid, &ree_fs_storage_ops,
+	res = tee_fs_htree_open(create, hash, uuid,
+				fdp->is_dirf ? &ree_dirf_storage_ops :
+					       &ree_fs_storage_ops,
 				fdp, &fdp->ht);
 out:
 	if (res == TEE_SUCCESS) {
-		if (dfh)
-			fdp->dfh = *dfh;
-		else
-			fdp->dfh.idx = -1;
 		*fh = (struct tee_file_handle *)fdp;
 	} else {
 		if (res == TEE_ERROR_SECURITY)
@@ -442,7 +621,8 @@ static void ree_fs_close_primitive(struct tee_file_handle *fh)
 
 	if (fdp) {
 		tee_fs_htree_close(&fdp->ht);
-		tee_fs_rpc_close(OPTEE_RPC_CMD_FS, fdp->fd);
+		if (fdp->fd != -1)
+			tee_fs_rpc_close(OPTEE_RPC_CMD_FS, fdp->fd);
 		free(fdp);
 	}
 }
@@ -614,6 +794,77 @@ static void put_dirh(struct tee_fs_dirfile_dirh *dirh, bool close)
 	}
 }
 
+/* Functions below handling @wb_pending are called with ree_fs_mutex held */
+static void wb_add(struct tee_fs_fd *fdp, size_t len)
+{
+	if (!fdp->wb_pending)
+		TAILQ_INSERT_TAIL(&wb_fds, fdp, wb_link);
+	fdp->wb_pending += len;
+}
+
+static void wb_clear(struct tee_fs_fd *fdp)
+{
+	if (fdp->wb_pending) {
+		TAILQ_REMOVE(&wb_fds, fdp, wb_link);
+		fdp->wb_pending = 0;
+	}
+}
+
+/*
+ * Forgets pending writes of a file which is removed from the directory
+ * file, committing them later would update an entry which may have been
+ * reused by another file.
+ */
+static void wb_drop_file(uint32_t file_number)
+{
+	struct tee_fs_fd *next = NULL;
+	struct tee_fs_fd *fdp = NULL;
+
+	TAILQ_FOREACH_SAFE(fdp, &wb_fds, wb_link, next)
+		if (fdp->dfh.file_number == file_number)
+			wb_clear(fdp);
+}
+
+/* Commits the changes of the file, called with ree_fs_mutex held */
+static TEE_Result commit_fd(struct tee_fs_dirfile_dirh *dirh,
+			    struct tee_fs_fd *fdp)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	res = tee_fs_htree_sync_to_storage(&fdp->ht, fdp->dfh.hash);
+	if (res)
+		return res;
+
+	res = tee_fs_dirfile_update_hash(dirh, &fdp->dfh);
+	if (res)
+		return res;
+
+	res = commit_dirh_writes(dirh);
+	if (!res)
+		wb_clear(fdp);
+
+	return res;
+}
+
+/* Commits writes held back by CFG_REE_FS_WRITE_BEHIND */
+static TEE_Result flush_fd(struct tee_fs_fd *fdp)
+{
+	struct tee_fs_dirfile_dirh *dirh = NULL;
+	TEE_Result res = TEE_SUCCESS;
+
+	if (!fdp->wb_pending || fdp->in_trans)
+		return TEE_SUCCESS;
+
+	res = get_dirh(&dirh);
+	if (res)
+		return res;
+
+	res = commit_fd(dirh, fdp);
+	put_dirh(dirh, res);
+
+	return res;
+}
+
 static TEE_Result ree_fs_open(struct tee_pobj *po, size_t *size,
 			      struct tee_file_handle **fh)
 {
@@ -684,16 +935,24 @@ static TEE_Result set_name(struct tee_fs_dirfile_dirh *dirh,
 	if (res)
 		return res;
 
-	if (have_old_dfh)
+	if (have_old_dfh) {
+		wb_drop_file(old_dfh.file_number);
 		tee_fs_rpc_remove_dfh(OPTEE_RPC_CMD_FS, &old_dfh);
+	}
 
 	return TEE_SUCCESS;
 }
 
 static void ree_fs_close(struct tee_file_handle **fh)
 {
+	TEE_Result res = TEE_SUCCESS;
+
 	if (*fh) {
 		mutex_lock(&ree_fs_mutex);
+		res = flush_fd((struct tee_fs_fd *)*fh);
+		if (res)
+			EMSG("Failed to commit written data: %#"PRIx32, res);
+		wb_clear((struct tee_fs_fd *)*fh);
 		put_dirh_primitive(false);
 		ree_fs_close_primitive(*fh);
 		*fh = NULL;
@@ -778,22 +1037,27 @@ static TEE_Result ree_fs_write(struct tee_file_handle *fh, size_t pos,
 
 	mutex_lock(&ree_fs_mutex);
 
+	/* The file couldn't be reverted after a failed transaction */
+	if (!fdp->ht) {
+		res = TEE_ERROR_BAD_STATE;
+		goto out;
+	}
+
 	res = get_dirh(&dirh);
 	if (res)
 		goto out;
 
 	res = ree_fs_write_primitive(fh, pos, buf, len);
-	if (res)
+	if (res || fdp->in_trans)
 		goto out;
 
-	res = tee_fs_htree_sync_to_storage(&fdp->ht, fdp->dfh.hash);
-	if (res)
-		goto out;
+	if (IS_ENABLED(CFG_REE_FS_WRITE_BEHIND)) {
+		wb_add(fdp, len);
+		if (fdp->wb_pending < CFG_REE_FS_WRITE_BEHIND_SIZE)
+			goto out;
+	}
 
-	res = tee_fs_dirfile_update_hash(dirh, &fdp->dfh);
-	if (res)
-		goto out;
-	res = commit_dirh_writes(dirh);
+	res = commit_fd(dirh, fdp);
 out:
 	put_dirh(dirh, res);
 	mutex_unlock(&ree_fs_mutex);
@@ -844,8 +1108,10 @@ static TEE_Result ree_fs_rename(struct tee_pobj *old, struct tee_pobj *new,
 	if (res)
 		goto out;
 
-	if (remove_dfh.idx != -1)
+	if (remove_dfh.idx != -1) {
+		wb_drop_file(remove_dfh.file_number);
 		tee_fs_rpc_remove_dfh(OPTEE_RPC_CMD_FS, &remove_dfh);
+	}
 
 out:
 	put_dirh(dirh, res);
@@ -879,6 +1145,7 @@ static TEE_Result ree_fs_remove(struct tee_pobj *po)
 	if (res)
 		goto out;
 
+	wb_drop_file(dfh.file_number);
 	tee_fs_rpc_remove_dfh(OPTEE_RPC_CMD_FS, &dfh);
 
 	assert(tee_fs_dirfile_find(dirh, &po->uuid, po->obj_id, po->obj_id_len,
@@ -898,29 +1165,172 @@ static TEE_Result ree_fs_truncate(struct tee_file_handle *fh, size_t len)
 
 	mutex_lock(&ree_fs_mutex);
 
+	/* The file couldn't be reverted after a failed transaction */
+	if (!fdp->ht) {
+		res = TEE_ERROR_BAD_STATE;
+		goto out;
+	}
+
 	res = get_dirh(&dirh);
 	if (res)
 		goto out;
 
 	res = ree_fs_ftruncate_internal(fdp, len);
-	if (res)
+	if (res || fdp->in_trans)
 		goto out;
 
-	res = tee_fs_htree_sync_to_storage(&fdp->ht, fdp->dfh.hash);
+	res = commit_fd(dirh, fdp);
+out:
+	put_dirh(dirh, res);
+	mutex_unlock(&ree_fs_mutex);
+
+	return res;
+}
+
+static TEE_Result ree_fs_sync(struct tee_file_handle *fh)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	mutex_lock(&ree_fs_mutex);
+	res = flush_fd((struct tee_fs_fd *)fh);
+	mutex_unlock(&ree_fs_mutex);
+
+	return res;
+}
+
+static TEE_Result ree_fs_begin_transaction(struct tee_file_handle *fh)
+{
+	struct tee_fs_fd *fdp = (struct tee_fs_fd *)fh;
+	TEE_Result res = TEE_SUCCESS;
+
+	mutex_lock(&ree_fs_mutex);
+	if (!fdp->ht) {
+		res = TEE_ERROR_BAD_STATE;
+	} else if (!fdp->in_trans) {
+		/* Earlier writes aren't part of the transaction */
+		res = flush_fd(fdp);
+		if (!res) {
+			memcpy(fdp->trans_hash, fdp->dfh.hash,
+			       sizeof(fdp->trans_hash));
+			fdp->in_trans = true;
+		}
+	}
+	mutex_unlock(&ree_fs_mutex);
+
+	return res;
+}
+
+/*
+ * Reverts the file to the state it had when the transaction started.
+ * Blocks and nodes written since then are in the unused version of each
+ * element and a smaller file is only truncated in storage once committed,
+ * so there's nothing to undo in storage, only the hash tree in memory
+ * needs to be reloaded.
+ */
+static void trans_rollback(struct tee_fs_fd *fdp)
+{
+	struct tee_fs_htree *ht = NULL;
+	TEE_Result res = TEE_SUCCESS;
+
+	if (!fdp->in_trans)
+		return;
+	fdp->in_trans = false;
+	fdp->trans_shrunk = false;
+
+	res = tee_fs_htree_open(false, fdp->trans_hash, fdp->uuid,
+				&ree_fs_storage_ops, fdp, &ht);
+	if (res) {
+		EMSG("Failed to revert file: %#"PRIx32, res);
+		/* The changes must not be committed by a later write */
+		tee_fs_htree_close(&fdp->ht);
+		return;
+	}
+
+	tee_fs_htree_close(&fdp->ht);
+	fdp->ht = ht;
+	memcpy(fdp->dfh.hash, fdp->trans_hash, sizeof(fdp->dfh.hash));
+}
+
+/*
+ * Truncates a file made smaller by a committed transaction. The elements
+ * past the end are unused by then, failing to remove them only wastes
+ * storage.
+ */
+static void trans_truncate(struct tee_fs_fd *fdp)
+{
+	struct tee_fs_htree_meta *meta = tee_fs_htree_get_meta(fdp->ht);
+	TEE_Result res = TEE_SUCCESS;
+
+	fdp->trans_shrunk = false;
+	res = truncate_storage(fdp, meta->length);
 	if (res)
-		goto out;
+		DMSG("Failed to truncate file: %#"PRIx32, res);
+}
 
-	res = tee_fs_dirfile_update_hash(dirh, &fdp->dfh);
+/*
+ * The hash tree of each file is synced, but since dirf.db still refers
+ * to the previous version of the files nothing is visible until dirf.db
+ * is committed. A single commit of dirf.db makes all the files of the
+ * transaction visible at once. Files which were made smaller are
+ * truncated in storage after that.
+ */
+static TEE_Result ree_fs_commit_transaction(struct tee_file_handle **fh,
+					    size_t num)
+{
+	struct tee_fs_dirfile_dirh *dirh = NULL;
+	struct tee_fs_fd *fdp = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	mutex_lock(&ree_fs_mutex);
+
+	res = get_dirh(&dirh);
 	if (res)
 		goto out;
+
+	for (n = 0; n < num; n++) {
+		fdp = (struct tee_fs_fd *)fh[n];
+		if (!fdp->in_trans)
+			continue;
+
+		res = tee_fs_htree_sync_to_storage(&fdp->ht, fdp->dfh.hash);
+		if (res)
+			goto out;
+
+		res = tee_fs_dirfile_update_hash(dirh, &fdp->dfh);
+		if (res)
+			goto out;
+	}
+
 	res = commit_dirh_writes(dirh);
 out:
+	for (n = 0; n < num; n++) {
+		fdp = (struct tee_fs_fd *)fh[n];
+		if (res) {
+			trans_rollback(fdp);
+		} else {
+			fdp->in_trans = false;
+			wb_clear(fdp);
+			if (fdp->trans_shrunk)
+				trans_truncate(fdp);
+		}
+	}
 	put_dirh(dirh, res);
 	mutex_unlock(&ree_fs_mutex);
 
 	return res;
 }
 
+static void ree_fs_abort_transaction(struct tee_file_handle **fh, size_t num)
+{
+	size_t n = 0;
+
+	mutex_lock(&ree_fs_mutex);
+	for (n = 0; n < num; n++)
+		trans_rollback((struct tee_fs_fd *)fh[n]);
+	mutex_unlock(&ree_fs_mutex);
+}
+
 static TEE_Result ree_fs_opendir_rpc(const TEE_UUID *uuid,
 				     struct tee_fs_dir **dir)
 
@@ -989,6 +1399,33 @@ static TEE_Result ree_fs_readdir_rpc(struct tee_fs_dir *d,
 	return res;
 }
 
+static TEE_Result ree_fs_readdir_batch_rpc(struct tee_fs_dir *d,
+					   struct tee_fs_dirent *ents,
+					   size_t *num)
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t n = 0;
+
+	mutex_lock(&ree_fs_mutex);
+
+	for (n = 0; n < *num; n++) {
+		ents[n].oidlen = sizeof(ents[n].oid);
+		res = tee_fs_dirfile_get_next(d->dirh, d->uuid, &d->idx,
+					      ents[n].oid, &ents[n].oidlen);
+		if (res)
+			break;
+	}
+
+	mutex_unlock(&ree_fs_mutex);
+
+	/* Return what was read before the end or an error */
+	if (n) {
+		*num = n;
+		return TEE_SUCCESS;
+	}
+	return res;
+}
+
 const struct tee_file_operations ree_fs_ops = {
 	.open = ree_fs_open,
 	.create = ree_fs_create,
@@ -996,9 +1433,14 @@ const struct tee_file_operations ree_fs_ops = {
 	.read = ree_fs_read,
 	.write = ree_fs_write,
 	.truncate = ree_fs_truncate,
+	.sync = ree_fs_sync,
 	.rename = ree_fs_rename,
 	.remove = ree_fs_remove,
 	.opendir = ree_fs_opendir_rpc,
 	.closedir = ree_fs_closedir_rpc,
 	.readdir = ree_fs_readdir_rpc,
+	.readdir_batch = ree_fs_readdir_batch_rpc,
+	.begin_transaction = ree_fs_begin_transaction,
+	.commit_transaction = ree_fs_commit_transaction,
+	.abort_transaction = ree_fs_abort_transaction,
 };
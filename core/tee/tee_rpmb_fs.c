@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <config.h>
 #include <crypto/crypto.h>
+#include <fnv1a.h>
 #include <kernel/huk_subkey.h>
 #include <kernel/misc.h>
 #include <kernel/msg_param.h>
@@ -57,6 +58,9 @@
 #define RPMB_BUF_MAX_ENTRIES (CFG_RPMB_FS_CACHE_ENTRIES + \
 			      CFG_RPMB_FS_RD_ENTRIES)
 
+/* Number of file name hash buckets with CFG_RPMB_FS_FAT_INDEX=y */
+#define RPMB_FAT_HASH_BUCKETS	64
+
 /**
  * FS parameters: Information often used by internal functions.
  * fat_start_address will be set by rpmb_fs_setup().
@@ -79,6 +83,12 @@ struct rpmb_fat_entry {
 	char filename[TEE_RPMB_FS_FILENAME_LENGTH];
 };
 
+/* A range of RPMB storage, in bytes */
+struct rpmb_extent {
+	uint32_t start;
+	uint32_t size;
+};
+
 /**
  * Structure that describes buffered/cached FAT FS entries in RPMB storage.
  * This structure is used in functions traversing the FAT FS.
@@ -99,6 +109,21 @@ struct rpmb_fat_entry_dir {
 	uint32_t num_total_read;
 	/* Indicates that last FAT FS entry was read. */
 	bool last_reached;
+	/*
+	 * With CFG_RPMB_FS_FAT_INDEX=y the buffer holds all FAT FS entries
+	 * and the active ones are hashed by file name. Each bucket and
+	 * element of hash_next holds the index + 1 of an entry, 0 ends the
+	 * chain.
+	 */
+	uint32_t *hash_next;
+	uint32_t hash_buckets[RPMB_FAT_HASH_BUCKETS];
+	/*
+	 * Free RPMB storage with CFG_RPMB_FS_FAT_INDEX=y, sorted by address
+	 * and coalesced. Derived from the FAT and kept up to date as FAT
+	 * entries are written.
+	 */
+	struct rpmb_extent *free_ext;
+	size_t num_free_ext;
 };
 
 /**
@@ -254,6 +279,9 @@ struct rpmb_dev_info {
  * @key_derived      Flag indicating if key has been generated.
  * @key_verified     Flag indicating the key generated is verified ok.
  * @dev_info_synced  Flag indicating if dev info has been retrieved from RPMB.
+ * @mac_key_ctx      HMAC context keyed with @key, never updated.
+ * @mac_ctx          HMAC context for MAC computations, copied from
+ *                   @mac_key_ctx to avoid hashing the key each time.
  */
 struct tee_rpmb_ctx {
 	uint8_t key[RPMB_KEY_MAC_SIZE];
@@ -266,10 +294,33 @@ struct tee_rpmb_ctx {
 	bool key_derived;
 	bool key_verified;
 	bool dev_info_synced;
+	void *mac_key_ctx;
+	void *mac_ctx;
 };
 
 static struct tee_rpmb_ctx *rpmb_ctx;
 
+#if CFG_RPMB_FS_BLOCK_CACHE_ENTRIES
+/*
+ * A decrypted data block, @fek and @uuid are those used to decrypt it,
+ * @uuid is all zero if NULL.
+ */
+struct rpmb_blk_cache_ent {
+	uint8_t data[RPMB_DATA_SIZE];
+	uint8_t fek[TEE_FS_KM_FEK_SIZE];
+	TEE_UUID uuid;
+	uint32_t last_used;
+	uint16_t blk_idx;
+	bool has_fek;
+	bool valid;
+};
+
+static struct rpmb_blk_cache_ent
+	rpmb_blk_cache[CFG_RPMB_FS_BLOCK_CACHE_ENTRIES];
+static uint32_t rpmb_blk_cache_tick;
+#endif
+static struct tee_rpmb_fs_stats rpmb_fs_stats;
+
 /* If set to true, don't try to access RPMB until rebooted */
 static bool rpmb_dead;
 
@@ -366,8 +417,48 @@ static void get_op_result_bits(uint8_t *bytes, uint8_t *res)
 	*res = *(bytes + 1) & RPMB_RESULT_MASK;
 }
 
+static void tee_rpmb_mac_ctx_free(void)
+{
+	crypto_mac_free_ctx(rpmb_ctx->mac_key_ctx);
+	crypto_mac_free_ctx(rpmb_ctx->mac_ctx);
+	rpmb_ctx->mac_key_ctx = NULL;
+	rpmb_ctx->mac_ctx = NULL;
+}
+
+/* Sets up the HMAC contexts once the key is derived */
+static TEE_Result tee_rpmb_mac_ctx_init(void)
+{
+	TEE_Result res = TEE_ERROR_GENERIC;
+
+	tee_rpmb_mac_ctx_free();
+
+	res = crypto_mac_alloc_ctx(&rpmb_ctx->mac_key_ctx, TEE_ALG_HMAC_SHA256);
+	if (res)
+		goto err;
+	res = crypto_mac_alloc_ctx(&rpmb_ctx->mac_ctx, TEE_ALG_HMAC_SHA256);
+	if (res)
+		goto err;
+	res = crypto_mac_init(rpmb_ctx->mac_key_ctx, rpmb_ctx->key,
+			      RPMB_KEY_MAC_SIZE);
+	if (res)
+		goto err;
+
+	return TEE_SUCCESS;
+err:
+	tee_rpmb_mac_ctx_free();
+	return res;
+}
+
+/* Returns a HMAC context keyed with the RPMB key, ready for updates */
+static void *tee_rpmb_mac_start(void)
+{
+	assert(rpmb_ctx->mac_ctx && rpmb_ctx->mac_key_ctx);
+
+	crypto_mac_copy_state(rpmb_ctx->mac_ctx, rpmb_ctx->mac_key_ctx);
+	return rpmb_ctx->mac_ctx;
+}
+
 static TEE_Result tee_rpmb_mac_calc(uint8_t *mac, uint32_t macsize,
-				    uint8_t *key, uint32_t keysize,
 				    struct rpmb_data_frame *datafrms,
 				    uint16_t blkcnt)
 {
@@ -375,33 +466,19 @@ static TEE_Result tee_rpmb_mac_calc(uint8_t *mac, uint32_t macsize,
 	int i;
 	void *ctx = NULL;
 
-	if (!mac || !key || !datafrms)
+	if (!mac || !datafrms)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	res = crypto_mac_alloc_ctx(&ctx, TEE_ALG_HMAC_SHA256);
-	if (res)
-		return res;
-
-	res = crypto_mac_init(ctx, key, keysize);
-	if (res != TEE_SUCCESS)
-		goto func_exit;
+	ctx = tee_rpmb_mac_start();
 
 	for (i = 0; i < blkcnt; i++) {
 		res = crypto_mac_update(ctx, datafrms[i].data,
 					RPMB_MAC_PROTECT_DATA_SIZE);
 		if (res != TEE_SUCCESS)
-			goto func_exit;
+			return res;
 	}
 
-	res = crypto_mac_final(ctx, mac, macsize);
-	if (res != TEE_SUCCESS)
-		goto func_exit;
-
-	res = TEE_SUCCESS;
-
-func_exit:
-	crypto_mac_free_ctx(ctx);
-	return res;
+	return crypto_mac_final(ctx, mac, macsize);
 }
 
 struct tee_rpmb_mem {
@@ -472,6 +549,7 @@ static TEE_Result tee_rpmb_invoke(struct tee_rpmb_mem *mem)
 					  mem->resp_size),
 	};
 
+	rpmb_fs_stats.rpc_count++;
 	return thread_rpc_cmd(OPTEE_RPC_CMD_RPMB, 2, params);
 }
 
@@ -617,11 +695,9 @@ static TEE_Result tee_rpmb_req_pack(struct rpmb_req *req,
 
 	if (rawdata->key_mac) {
 		if (rawdata->msg_type == RPMB_MSG_TYPE_REQ_AUTH_DATA_WRITE) {
-			res =
-			    tee_rpmb_mac_calc(rawdata->key_mac,
-					      RPMB_KEY_MAC_SIZE, rpmb_ctx->key,
-					      RPMB_KEY_MAC_SIZE, datafrm,
-					      nbr_frms);
+			res = tee_rpmb_mac_calc(rawdata->key_mac,
+						RPMB_KEY_MAC_SIZE, datafrm,
+						nbr_frms);
 			if (res != TEE_SUCCESS)
 				goto func_exit;
 		}
@@ -657,8 +733,7 @@ static TEE_Result data_cpy_mac_calc_1b(struct rpmb_raw_data *rawdata,
 	if (rawdata->len + rawdata->byte_offset > RPMB_DATA_SIZE)
 		return TEE_ERROR_BAD_PARAMETERS;
 
-	res = tee_rpmb_mac_calc(rawdata->key_mac, RPMB_KEY_MAC_SIZE,
-				rpmb_ctx->key, RPMB_KEY_MAC_SIZE, frm, 1);
+	res = tee_rpmb_mac_calc(rawdata->key_mac, RPMB_KEY_MAC_SIZE, frm, 1);
 	if (res != TEE_SUCCESS)
 		return res;
 
@@ -696,13 +771,7 @@ static TEE_Result tee_rpmb_data_cpy_mac_calc(struct rpmb_data_frame *datafrm,
 
 	data = rawdata->data;
 
-	res = crypto_mac_alloc_ctx(&ctx, TEE_ALG_HMAC_SHA256);
-	if (res)
-		goto func_exit;
-
-	res = crypto_mac_init(ctx, rpmb_ctx->key, RPMB_KEY_MAC_SIZE);
-	if (res != TEE_SUCCESS)
-		goto func_exit;
+	ctx = tee_rpmb_mac_start();
 
 	/*
 	 * Note: JEDEC JESD84-B51: "In every packet the address is the start
@@ -764,7 +833,6 @@ static TEE_Result tee_rpmb_data_cpy_mac_calc(struct rpmb_data_frame *datafrm,
 	res = TEE_SUCCESS;
 
 func_exit:
-	crypto_mac_free_ctx(ctx);
 	return res;
 }
 
@@ -862,8 +930,6 @@ static TEE_Result tee_rpmb_resp_unpack_verify(struct rpmb_data_frame *datafrm,
 				return TEE_ERROR_GENERIC;
 
 			res = tee_rpmb_mac_calc(rawdata->key_mac,
-						RPMB_KEY_MAC_SIZE,
-						rpmb_ctx->key,
 						RPMB_KEY_MAC_SIZE,
 						&lastfrm, 1);
 
@@ -1105,6 +1171,7 @@ static TEE_Result tee_rpmb_init(uint16_t dev_id)
 		if (!rpmb_ctx)
 			return TEE_ERROR_OUT_OF_MEMORY;
 	} else if (rpmb_ctx->dev_id != dev_id) {
+		tee_rpmb_mac_ctx_free();
 		memset(rpmb_ctx, 0x00, sizeof(struct tee_rpmb_ctx));
 	}
 
@@ -1137,8 +1204,9 @@ static TEE_Result tee_rpmb_init(uint16_t dev_id)
 
 		memcpy(rpmb_ctx->cid, dev_info.cid, RPMB_EMMC_CID_SIZE);
 
-#ifdef RPMB_DRIVER_MULTIPLE_WRITE_FIXED
-		rpmb_ctx->rel_wr_blkcnt = dev_info.rel_wr_sec_c * 2;
+#if defined(RPMB_DRIVER_MULTIPLE_WRITE_FIXED) || \
+	defined(CFG_RPMB_WRITE_MULTIPLE_BLOCKS)
+		rpmb_ctx->rel_wr_blkcnt = MAX(dev_info.rel_wr_sec_c * 2, 1);
 #else
 		rpmb_ctx->rel_wr_blkcnt = 1;
 #endif
@@ -1157,6 +1225,10 @@ static TEE_Result tee_rpmb_init(uint16_t dev_id)
 			goto func_exit;
 		}
 
+		res = tee_rpmb_mac_ctx_init();
+		if (res != TEE_SUCCESS)
+			goto func_exit;
+
 		rpmb_ctx->key_derived = true;
 	}
 
@@ -1375,6 +1447,104 @@ out_of_retries:
 	return TEE_ERROR_COMMUNICATION;
 }
 
+#if CFG_RPMB_FS_BLOCK_CACHE_ENTRIES
+static bool blk_cache_match(struct rpmb_blk_cache_ent *e, uint16_t blk_idx,
+			    const uint8_t *fek, const TEE_UUID *uuid)
+{
+	static const TEE_UUID zero_uuid;
+
+	if (!e->valid || e->blk_idx != blk_idx || e->has_fek != !!fek)
+		return false;
+	if (fek && memcmp(e->fek, fek, sizeof(e->fek)))
+		return false;
+
+	return !memcmp(&e->uuid, uuid ? uuid : &zero_uuid, sizeof(e->uuid));
+}
+
+static bool blk_cache_get(uint16_t blk_idx, uint8_t *data,
+			  const uint8_t *fek, const TEE_UUID *uuid)
+{
+	struct rpmb_blk_cache_ent *e = NULL;
+	size_t n = 0;
+
+	for (n = 0; n < CFG_RPMB_FS_BLOCK_CACHE_ENTRIES; n++) {
+		e = rpmb_blk_cache + n;
+		if (blk_cache_match(e, blk_idx, fek, uuid)) {
+			memcpy(data, e->data, RPMB_DATA_SIZE);
+			e->last_used = ++rpmb_blk_cache_tick;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void blk_cache_put(uint16_t blk_idx, const uint8_t *data,
+			  const uint8_t *fek, const TEE_UUID *uuid)
+{
+	struct rpmb_blk_cache_ent *e = NULL;
+	size_t n = 0;
+
+	/* Reuse a matching entry, else a free one, else the oldest one */
+	for (n = 0; n < CFG_RPMB_FS_BLOCK_CACHE_ENTRIES; n++) {
+		if (blk_cache_match(rpmb_blk_cache + n, blk_idx, fek, uuid)) {
+			e = rpmb_blk_cache + n;
+			break;
+		}
+		if (!e || (e->valid && (!rpmb_blk_cache[n].valid ||
+					rpmb_blk_cache[n].last_used <
+					e->last_used)))
+			e = rpmb_blk_cache + n;
+	}
+
+	memcpy(e->data, data, RPMB_DATA_SIZE);
+	e->has_fek = fek;
+	if (fek)
+		memcpy(e->fek, fek, sizeof(e->fek));
+	if (uuid)
+		e->uuid = *uuid;
+	else
+		memset(&e->uuid, 0, sizeof(e->uuid));
+	e->blk_idx = blk_idx;
+	e->last_used = ++rpmb_blk_cache_tick;
+	e->valid = true;
+}
+
+/* Drops cached blocks about to be written */
+static void blk_cache_invalidate(uint16_t blk_idx, uint16_t blkcnt)
+{
+	struct rpmb_blk_cache_ent *e = NULL;
+	size_t n = 0;
+
+	for (n = 0; n < CFG_RPMB_FS_BLOCK_CACHE_ENTRIES; n++) {
+		e = rpmb_blk_cache + n;
+		if (e->valid && e->blk_idx >= blk_idx &&
+		    e->blk_idx - blk_idx < blkcnt) {
+			memzero_explicit(e, sizeof(*e));
+		}
+	}
+}
+#else
+static bool blk_cache_get(uint16_t blk_idx __unused, uint8_t *data __unused,
+			  const uint8_t *fek __unused,
+			  const TEE_UUID *uuid __unused)
+{
+	return false;
+}
+
+static void blk_cache_put(uint16_t blk_idx __unused,
+			  const uint8_t *data __unused,
+			  const uint8_t *fek __unused,
+			  const TEE_UUID *uuid __unused)
+{
+}
+
+static void blk_cache_invalidate(uint16_t blk_idx __unused,
+				 uint16_t blkcnt __unused)
+{
+}
+#endif /*CFG_RPMB_FS_BLOCK_CACHE_ENTRIES*/
+
 static TEE_Result tee_rpmb_write_blk(uint16_t dev_id, uint16_t blk_idx,
 				     const uint8_t *data_blks, uint16_t blkcnt,
 				     const uint8_t *fek, const TEE_UUID *uuid)
@@ -1400,6 +1570,8 @@ static TEE_Result tee_rpmb_write_blk(uint16_t dev_id, uint16_t blk_idx,
 	if (res != TEE_SUCCESS)
 		return res;
 
+	blk_cache_invalidate(blk_idx, blkcnt);
+
 	/*
 	 * We need to split data when block count
 	 * is bigger than reliable block write count.
@@ -1458,6 +1630,25 @@ static bool tee_rpmb_write_is_atomic(uint16_t dev_id __unused, uint32_t addr,
 	return (blkcnt <= rpmb_ctx->rel_wr_blkcnt);
 }
 
+/*
+ * Reads the block @blk_idx, partially overwritten by a write, into @data.
+ * @nread is incremented if the block had to be read from RPMB.
+ */
+static TEE_Result read_edge_blk(uint16_t dev_id, uint16_t blk_idx,
+				uint8_t *data, const uint8_t *fek,
+				const TEE_UUID *uuid, uint16_t *nread)
+{
+	if (blk_cache_get(blk_idx, data, fek, uuid)) {
+		rpmb_fs_stats.cache_hits++;
+		return TEE_SUCCESS;
+	}
+
+	rpmb_fs_stats.cache_misses++;
+	(*nread)++;
+	return tee_rpmb_read(dev_id, blk_idx * RPMB_DATA_SIZE, data,
+			     RPMB_DATA_SIZE, fek, uuid);
+}
+
 /*
  * Write RPMB data in bytes.
  *
@@ -1473,6 +1664,8 @@ static TEE_Result tee_rpmb_write(uint16_t dev_id, uint32_t addr,
 {
 	TEE_Result res = TEE_ERROR_GENERIC;
 	uint8_t *data_tmp = NULL;
+	uint8_t *last_blk = NULL;
+	uint16_t nread = 0;
 	uint16_t blk_idx;
 	uint16_t blkcnt;
 	uint8_t byte_offset;
@@ -1495,11 +1688,21 @@ static TEE_Result tee_rpmb_write(uint16_t dev_id, uint32_t addr,
 			goto func_exit;
 		}
 
-		/* Read the complete blocks */
-		res = tee_rpmb_read(dev_id, blk_idx * RPMB_DATA_SIZE, data_tmp,
-				    blkcnt * RPMB_DATA_SIZE, fek, uuid);
-		if (res != TEE_SUCCESS)
-			goto func_exit;
+		/* Only the first and last blocks are partially updated */
+		last_blk = data_tmp + (blkcnt - 1) * RPMB_DATA_SIZE;
+		if (byte_offset) {
+			res = read_edge_blk(dev_id, blk_idx, data_tmp, fek,
+					    uuid, &nread);
+			if (res != TEE_SUCCESS)
+				goto func_exit;
+		}
+		if ((byte_offset + len) % RPMB_DATA_SIZE &&
+		    (blkcnt > 1 || !byte_offset)) {
+			res = read_edge_blk(dev_id, blk_idx + blkcnt - 1,
+					    last_blk, fek, uuid, &nread);
+			if (res != TEE_SUCCESS)
+				goto func_exit;
+		}
 
 		/* Partial update of the data blocks */
 		memcpy(data_tmp + byte_offset, data, len);
@@ -1508,6 +1711,14 @@ static TEE_Result tee_rpmb_write(uint16_t dev_id, uint32_t addr,
 					 fek, uuid);
 		if (res != TEE_SUCCESS)
 			goto func_exit;
+
+		blk_cache_put(blk_idx, data_tmp, fek, uuid);
+		if (blkcnt > 1)
+			blk_cache_put(blk_idx + blkcnt - 1, last_blk, fek,
+				      uuid);
+
+		rpmb_fs_stats.partial_writes++;
+		rpmb_fs_stats.frames_saved += blkcnt - nread;
 	}
 
 	res = TEE_SUCCESS;
@@ -1588,11 +1799,379 @@ static void fat_entry_dir_free(void)
 {
 	if (fat_entry_dir) {
 		free(fat_entry_dir->rpmb_fat_entry_buf);
+		free(fat_entry_dir->hash_next);
+		free(fat_entry_dir->free_ext);
 		free(fat_entry_dir);
 		fat_entry_dir = NULL;
 	}
 }
 
+static uint32_t *fat_index_bucket(const char *filename)
+{
+	size_t len = strnlen(filename, TEE_RPMB_FS_FILENAME_LENGTH);
+	uint32_t h = fnv1a_hash(FNV1A_INIT, filename, len);
+
+	return fat_entry_dir->hash_buckets + h % RPMB_FAT_HASH_BUCKETS;
+}
+
+/* Adds entry @idx to the file name index if it's active */
+static void fat_index_add(uint32_t idx)
+{
+	struct rpmb_fat_entry *fe = fat_entry_dir->rpmb_fat_entry_buf + idx;
+	uint32_t *bucket = NULL;
+
+	if (!(fe->flags & FILE_IS_ACTIVE))
+		return;
+
+	bucket = fat_index_bucket(fe->filename);
+	fat_entry_dir->hash_next[idx] = *bucket;
+	*bucket = idx + 1;
+}
+
+/* Removes entry @idx from the file name index if it's active */
+static void fat_index_remove(uint32_t idx)
+{
+	struct rpmb_fat_entry *fe = fat_entry_dir->rpmb_fat_entry_buf + idx;
+	uint32_t *i = NULL;
+
+	if (!(fe->flags & FILE_IS_ACTIVE))
+		return;
+
+	for (i = fat_index_bucket(fe->filename); *i;
+	     i = fat_entry_dir->hash_next + *i - 1) {
+		if (*i == idx + 1) {
+			*i = fat_entry_dir->hash_next[idx];
+			return;
+		}
+	}
+}
+
+static uint32_t data_ext_size(uint32_t data_size)
+{
+	return ROUNDUP(data_size, RPMB_DATA_SIZE);
+}
+
+/* Removes a range from the free extents, the range may be partly used */
+static TEE_Result fat_index_reserve(uint32_t start, uint32_t size)
+{
+	struct rpmb_extent *ext = NULL;
+	uint32_t end = 0;
+	uint32_t ext_end = 0;
+	size_t n = 0;
+
+	if (ADD_OVERFLOW(start, size, &end))
+		return TEE_ERROR_CORRUPT_OBJECT;
+
+	while (n < fat_entry_dir->num_free_ext) {
+		ext = fat_entry_dir->free_ext + n;
+		ext_end = ext->start + ext->size;
+
+		if (ext_end <= start) {
+			n++;
+			continue;
+		}
+		if (ext->start >= end)
+			break;
+
+		if (ext->start < start && ext_end > end) {
+			/* Split the extent in two */
+			ext = realloc(fat_entry_dir->free_ext,
+				      (fat_entry_dir->num_free_ext + 1) *
+				      sizeof(*ext));
+			if (!ext)
+				return TEE_ERROR_OUT_OF_MEMORY;
+			fat_entry_dir->free_ext = ext;
+			ext += n;
+			memmove(ext + 1, ext, (fat_entry_dir->num_free_ext - n) *
+					      sizeof(*ext));
+			fat_entry_dir->num_free_ext++;
+			ext[0].size = start - ext[0].start;
+			ext[1].start = end;
+			ext[1].size = ext_end - end;
+			break;
+		}
+
+		if (ext->start < start) {
+			ext->size = start - ext->start;
+			n++;
+		} else if (ext_end > end) {
+			ext->start = end;
+			ext->size = ext_end - end;
+			break;
+		} else {
+			fat_entry_dir->num_free_ext--;
+			memmove(ext, ext + 1, (fat_entry_dir->num_free_ext - n) *
+					      sizeof(*ext));
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+/* Returns a used range to the free extents */
+static TEE_Result fat_index_release(uint32_t start, uint32_t size)
+{
+	struct rpmb_extent *ext = fat_entry_dir->free_ext;
+	size_t num = fat_entry_dir->num_free_ext;
+	bool merge_prev = false;
+	bool merge_next = false;
+	size_t n = 0;
+
+	while (n < num && ext[n].start < start)
+		n++;
+
+	/* The range must not overlap a free extent */
+	if (n && ext[n - 1].start + ext[n - 1].size > start)
+		return TEE_ERROR_GENERIC;
+	if (n < num && start + size > ext[n].start)
+		return TEE_ERROR_GENERIC;
+
+	merge_prev = n && ext[n - 1].start + ext[n - 1].size == start;
+	merge_next = n < num && start + size == ext[n].start;
+
+	if (merge_prev && merge_next) {
+		ext[n - 1].size += size + ext[n].size;
+		memmove(ext + n, ext + n + 1, (num - n - 1) * sizeof(*ext));
+		fat_entry_dir->num_free_ext--;
+	} else if (merge_prev) {
+		ext[n - 1].size += size;
+	} else if (merge_next) {
+		ext[n].start = start;
+		ext[n].size += size;
+	} else {
+		ext = realloc(ext, (num + 1) * sizeof(*ext));
+		if (!ext)
+			return TEE_ERROR_OUT_OF_MEMORY;
+		fat_entry_dir->free_ext = ext;
+		memmove(ext + n + 1, ext + n, (num - n) * sizeof(*ext));
+		ext[n].start = start;
+		ext[n].size = size;
+		fat_entry_dir->num_free_ext++;
+	}
+
+	return TEE_SUCCESS;
+}
+
+static bool fat_index_is_free(uint32_t start, uint32_t size)
+{
+	struct rpmb_extent *ext = NULL;
+	size_t n = 0;
+
+	for (n = 0; n < fat_entry_dir->num_free_ext; n++) {
+		ext = fat_entry_dir->free_ext + n;
+		if (ext->start <= start &&
+		    ext->start + ext->size >= start + size)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Builds the free extents from the FAT area, which ends at @fat_end, and
+ * the data of the active entries.
+ */
+static TEE_Result fat_index_init_free(uint32_t fat_end)
+{
+	struct rpmb_fat_entry *fe = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t n = 0;
+
+	fat_entry_dir->free_ext = malloc(sizeof(struct rpmb_extent));
+	if (!fat_entry_dir->free_ext)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	fat_entry_dir->free_ext->start = RPMB_STORAGE_START_ADDRESS;
+	fat_entry_dir->free_ext->size = fs_par->max_rpmb_address -
+					RPMB_STORAGE_START_ADDRESS;
+	fat_entry_dir->num_free_ext = 1;
+
+	res = fat_index_reserve(RPMB_STORAGE_START_ADDRESS,
+				fat_end - RPMB_STORAGE_START_ADDRESS);
+	if (res)
+		return res;
+
+	for (n = 0; n < fat_entry_dir->num_buffered; n++) {
+		fe = fat_entry_dir->rpmb_fat_entry_buf + n;
+		if ((fe->flags & FILE_IS_ACTIVE) && fe->data_size) {
+			res = fat_index_reserve(fe->start_address,
+						data_ext_size(fe->data_size));
+			if (res)
+				return res;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Reads all FAT FS entries, up to and including the last one, into the
+ * buffer and indexes them.
+ */
+static TEE_Result fat_index_init(uint32_t fat_address)
+{
+	struct rpmb_fat_entry *fe = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t num = 0;
+	uint32_t n = 0;
+
+	while (true) {
+		if (fat_address + (num + CFG_RPMB_FS_RD_ENTRIES) * sizeof(*fe) >
+		    fs_par->max_rpmb_address)
+			return TEE_ERROR_CORRUPT_OBJECT;
+
+		fe = realloc(fat_entry_dir->rpmb_fat_entry_buf,
+			     (num + CFG_RPMB_FS_RD_ENTRIES) * sizeof(*fe));
+		if (!fe)
+			return TEE_ERROR_OUT_OF_MEMORY;
+		fat_entry_dir->rpmb_fat_entry_buf = fe;
+
+		res = tee_rpmb_read(CFG_RPMB_FS_DEV_ID,
+				    fat_address + num * sizeof(*fe),
+				    (uint8_t *)(fe + num),
+				    CFG_RPMB_FS_RD_ENTRIES * sizeof(*fe),
+				    NULL, NULL);
+		if (res)
+			return res;
+
+		for (n = num; n < num + CFG_RPMB_FS_RD_ENTRIES; n++)
+			if (fe[n].flags & FILE_IS_LAST_ENTRY)
+				break;
+		if (n < num + CFG_RPMB_FS_RD_ENTRIES) {
+			num = n + 1;
+			break;
+		}
+		num += CFG_RPMB_FS_RD_ENTRIES;
+	}
+
+	fat_entry_dir->num_buffered = num;
+	fat_entry_dir->hash_next = calloc(num, sizeof(uint32_t));
+	if (!fat_entry_dir->hash_next)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	for (n = 0; n < num; n++)
+		fat_index_add(n);
+
+	return fat_index_init_free(fat_address + num * sizeof(*fe));
+}
+
+/*
+ * Updates entry @idx of the index and the free extents after it was
+ * written, @idx is at most one past the last entry when the FAT is
+ * expanded.
+ */
+static TEE_Result fat_index_update(struct rpmb_fat_entry *fat_entry,
+				   uint32_t idx)
+{
+	struct rpmb_fat_entry *fe = NULL;
+	uint32_t *next = NULL;
+	uint32_t num = fat_entry_dir->num_buffered;
+
+	if (idx == num) {
+		fe = realloc(fat_entry_dir->rpmb_fat_entry_buf,
+			     (num + 1) * sizeof(*fe));
+		if (fe)
+			fat_entry_dir->rpmb_fat_entry_buf = fe;
+		next = realloc(fat_entry_dir->hash_next,
+			       (num + 1) * sizeof(*next));
+		if (next)
+			fat_entry_dir->hash_next = next;
+		if (!fe || !next)
+			goto err;
+
+		memset(fe + num, 0, sizeof(*fe));
+		fat_entry_dir->num_buffered++;
+
+		if (fat_index_reserve(RPMB_FS_FAT_START_ADDRESS +
+				      idx * sizeof(*fe), sizeof(*fe)))
+			goto err;
+	} else if (idx > num) {
+		goto err;
+	}
+
+	fe = fat_entry_dir->rpmb_fat_entry_buf + idx;
+	if ((fe->flags & FILE_IS_ACTIVE) && fe->data_size &&
+	    fat_index_release(fe->start_address,
+			      data_ext_size(fe->data_size)))
+		goto err;
+
+	fat_index_remove(idx);
+	memcpy(fe, fat_entry, sizeof(*fat_entry));
+	fat_index_add(idx);
+
+	if ((fe->flags & FILE_IS_ACTIVE) && fe->data_size &&
+	    fat_index_reserve(fe->start_address, data_ext_size(fe->data_size)))
+		goto err;
+
+	return TEE_SUCCESS;
+err:
+	/*
+	 * The entry is written already, drop the index and read the FAT
+	 * again next time. This also recovers free extents which don't
+	 * match the FAT.
+	 */
+	fat_entry_dir_free();
+	return TEE_SUCCESS;
+}
+
+/*
+ * fat_entry_dir_find: Find an active FAT FS entry by file name
+ * Only with CFG_RPMB_FS_FAT_INDEX=y. Like a traversal of the FAT, the
+ * first matching entry is returned.
+ */
+static struct rpmb_fat_entry *fat_entry_dir_find(const char *filename,
+						 uint32_t *fat_address)
+{
+	struct rpmb_fat_entry *fe = NULL;
+	uint32_t best = UINT32_MAX;
+	uint32_t i = 0;
+
+	for (i = *fat_index_bucket(filename); i;
+	     i = fat_entry_dir->hash_next[i - 1]) {
+		fe = fat_entry_dir->rpmb_fat_entry_buf + i - 1;
+		if (i - 1 < best && !strcmp(fe->filename, filename))
+			best = i - 1;
+	}
+
+	if (best == UINT32_MAX)
+		return NULL;
+
+	*fat_address = RPMB_FS_FAT_START_ADDRESS + best * sizeof(*fe);
+	return fat_entry_dir->rpmb_fat_entry_buf + best;
+}
+
+/*
+ * fat_index_alloc: Find room for @size bytes of file data
+ * Only with CFG_RPMB_FS_FAT_INDEX=y. Picks the smallest free extent which
+ * is large enough and returns the address at its upper end, keeping
+ * the lower addresses free for the FAT to grow. The extent is taken once
+ * a FAT entry referring to it is written.
+ */
+static TEE_Result fat_index_alloc(size_t size, uintptr_t *addr)
+{
+	struct rpmb_extent *best = NULL;
+	struct rpmb_extent *ext = NULL;
+	uint32_t ext_size = 0;
+	size_t n = 0;
+
+	assert(fat_entry_dir);
+
+	if (size > UINT32_MAX - RPMB_DATA_SIZE)
+		return TEE_ERROR_STORAGE_NO_SPACE;
+	ext_size = data_ext_size(size);
+
+	for (n = 0; n < fat_entry_dir->num_free_ext; n++) {
+		ext = fat_entry_dir->free_ext + n;
+		if (ext->size >= ext_size && (!best || ext->size <= best->size))
+			best = ext;
+	}
+
+	if (!best)
+		return TEE_ERROR_STORAGE_NO_SPACE;
+
+	*addr = best->start + best->size - ext_size;
+	return TEE_SUCCESS;
+}
+
 /**
  * fat_entry_dir_init: Initialize the FAT FS entry buffer/cache
  * This function must be called before reading FAT FS entries using the
@@ -1621,6 +2200,13 @@ static TEE_Result fat_entry_dir_init(void)
 	if (!fat_entry_dir)
 		return TEE_ERROR_OUT_OF_MEMORY;
 
+	if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
+		res = fat_index_init(fat_address);
+		if (res)
+			goto out;
+		return TEE_SUCCESS;
+	}
+
 	/*
 	 * If caching is enabled, read in up to the maximum cache size, but
 	 * never more than the single read in size. Otherwise, read in as many
@@ -1675,7 +2261,7 @@ static void fat_entry_dir_deinit(void)
 	if (!fat_entry_dir)
 		return;
 
-	if (!CFG_RPMB_FS_CACHE_ENTRIES) {
+	if (!CFG_RPMB_FS_CACHE_ENTRIES && !IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
 		fat_entry_dir_free();
 		return;
 	}
@@ -1685,6 +2271,10 @@ static void fat_entry_dir_deinit(void)
 	fat_entry_dir->num_total_read = 0;
 	fat_entry_dir->last_reached = false;
 
+	/* The index keeps all entries */
+	if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX))
+		return;
+
 	if (fat_entry_dir->num_buffered > CFG_RPMB_FS_CACHE_ENTRIES) {
 		fat_entry_dir->num_buffered = CFG_RPMB_FS_CACHE_ENTRIES;
 
@@ -1725,6 +2315,9 @@ static TEE_Result __maybe_unused fat_entry_dir_update
 	fat_entry_buf_idx = (fat_address - RPMB_FS_FAT_START_ADDRESS) /
 			     sizeof(struct rpmb_fat_entry);
 
+	if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX))
+		return fat_index_update(fat_entry, fat_entry_buf_idx);
+
 	/* Only need to write if index points to an entry in cache. */
 	if (fat_entry_buf_idx < fat_entry_dir->num_buffered &&
 	    fat_entry_buf_idx < max_cache_entries) {
@@ -1774,9 +2367,12 @@ static TEE_Result fat_entry_dir_get_next(struct rpmb_fat_entry **fat_entry,
 
 	/*
 	 * We've read all so-far buffered elements, so we need to
-	 * read in more entries from RPMB storage.
+	 * read in more entries from RPMB storage. This doesn't happen with
+	 * CFG_RPMB_FS_FAT_INDEX=y since the last entry is buffered.
 	 */
 	if (fat_entry_dir->idx_curr >= fat_entry_dir->num_buffered) {
+		assert(!IS_ENABLED(CFG_RPMB_FS_FAT_INDEX));
+
 		/*
 		 * This is the case where we do not cache entries, so just read
 		 * in next set of FAT FS entries into the buffer.
@@ -2015,7 +2611,8 @@ static TEE_Result write_fat_entry(struct rpmb_file_handle *fh,
 	dump_fat();
 
 	/* If caching enabled, update a successfully written entry in cache. */
-	if (CFG_RPMB_FS_CACHE_ENTRIES && !res)
+	if ((CFG_RPMB_FS_CACHE_ENTRIES || IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) &&
+	    !res)
 		res = fat_entry_dir_update(&fh->fat_entry,
 					   fh->rpmb_fat_address);
 
@@ -2184,6 +2781,18 @@ static TEE_Result read_fat(struct rpmb_file_handle *fh, tee_mm_pool_t *p)
 	if (res)
 		goto out;
 
+	/* Look up the file name directly unless the pool is to be built */
+	if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX) && !p) {
+		fe = fat_entry_dir_find(fh->filename, &fat_address);
+		if (fe) {
+			fh->rpmb_fat_address = fat_address;
+			memcpy(&fh->fat_entry, fe, sizeof(*fe));
+		} else if (!fh->rpmb_fat_address) {
+			res = TEE_ERROR_ITEM_NOT_FOUND;
+		}
+		goto out;
+	}
+
 	/*
 	 * The pool is used to represent the current RPMB layout. To find
 	 * a slot for the file tee_mm_alloc is called on the pool. Thus
@@ -2290,6 +2899,54 @@ out:
 	return res;
 }
 
+/*
+ * read_fat_slot: Like read_fat() with a pool, but using the FAT index
+ * Returns the matching FAT entry or else the first unused one, expanding
+ * the FAT if that's the last entry.
+ */
+static TEE_Result read_fat_slot(struct rpmb_file_handle *fh)
+{
+	TEE_Result res = TEE_ERROR_GENERIC;
+	struct rpmb_fat_entry *fe = NULL;
+	struct rpmb_file_handle last_fh = { };
+	uint32_t fat_address = 0;
+	uint32_t n = 0;
+
+	res = fat_entry_dir_init();
+	if (res)
+		return res;
+
+	fe = fat_entry_dir_find(fh->filename, &fat_address);
+	if (!fe) {
+		for (n = 0; n < fat_entry_dir->num_buffered; n++) {
+			fe = fat_entry_dir->rpmb_fat_entry_buf + n;
+			if (!(fe->flags & FILE_IS_ACTIVE))
+				break;
+		}
+		/* The last entry is never active */
+		if (n == fat_entry_dir->num_buffered)
+			return TEE_ERROR_CORRUPT_OBJECT;
+		fat_address = RPMB_FS_FAT_START_ADDRESS + n * sizeof(*fe);
+	}
+
+	fh->rpmb_fat_address = fat_address;
+	memcpy(&fh->fat_entry, fe, sizeof(*fe));
+
+	if (fh->fat_entry.flags & FILE_IS_LAST_ENTRY) {
+		/* The FAT needs to be expanded with a new last entry */
+		last_fh.fat_entry.flags = FILE_IS_LAST_ENTRY;
+		last_fh.rpmb_fat_address = fat_address + sizeof(*fe);
+		if (!fat_index_is_free(last_fh.rpmb_fat_address, sizeof(*fe)))
+			return TEE_ERROR_STORAGE_NO_SPACE;
+
+		res = write_fat_entry(&last_fh, true);
+		if (res)
+			return res;
+	}
+
+	return TEE_SUCCESS;
+}
+
 static TEE_Result generate_fek(struct rpmb_fat_entry *fe, const TEE_UUID *uuid)
 {
 	TEE_Result res;
@@ -2318,7 +2975,11 @@ static TEE_Result rpmb_fs_open_internal(struct rpmb_file_handle *fh,
 		goto out;
 
 	fh->uuid = uuid;
-	if (create) {
+	if (create && IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
+		res = read_fat_slot(fh);
+		if (res != TEE_SUCCESS)
+			goto out;
+	} else if (create) {
 		/* Upper memory allocation must be used for RPMB_FS. */
 		pool_result = tee_mm_init(&p,
 					  RPMB_STORAGE_START_ADDRESS,
@@ -2513,18 +3174,22 @@ static TEE_Result rpmb_fs_write_primitive(struct rpmb_file_handle *fh,
 
 	dump_fh(fh);
 
-	/* Upper memory allocation must be used for RPMB_FS. */
-	pool_result = tee_mm_init(&p,
-				  RPMB_STORAGE_START_ADDRESS,
-				  fs_par->max_rpmb_address,
-				  RPMB_BLOCK_SIZE_SHIFT,
-				  TEE_MM_POOL_HI_ALLOC);
-	if (!pool_result) {
-		res = TEE_ERROR_OUT_OF_MEMORY;
-		goto out;
-	}
+	if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
+		res = read_fat(fh, NULL);
+	} else {
+		/* Upper memory allocation must be used for RPMB_FS. */
+		pool_result = tee_mm_init(&p,
+					  RPMB_STORAGE_START_ADDRESS,
+					  fs_par->max_rpmb_address,
+					  RPMB_BLOCK_SIZE_SHIFT,
+					  TEE_MM_POOL_HI_ALLOC);
+		if (!pool_result) {
+			res = TEE_ERROR_OUT_OF_MEMORY;
+			goto out;
+		}
 
-	res = read_fat(fh, &p);
+		res = read_fat(fh, &p);
+	}
 	if (res != TEE_SUCCESS)
 		goto out;
 
@@ -2552,18 +3217,24 @@ static TEE_Result rpmb_fs_write_primitive(struct rpmb_file_handle *fh,
 		 * read, update, write.
 		 */
 		size_t new_size = MAX(end, fh->fat_entry.data_size);
-		tee_mm_entry_t *mm = tee_mm_alloc(&p, new_size);
+		tee_mm_entry_t *mm = NULL;
 		uintptr_t new_fat_entry = 0;
 
 		DMSG("Need to re-allocate");
-		if (!mm) {
+		if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
+			res = fat_index_alloc(new_size, &new_fat_entry);
+		} else {
+			mm = tee_mm_alloc(&p, new_size);
+			if (mm)
+				new_fat_entry = tee_mm_get_smem(mm);
+			else
+				res = TEE_ERROR_STORAGE_NO_SPACE;
+		}
+		if (res) {
 			DMSG("RPMB: No space left");
-			res = TEE_ERROR_STORAGE_NO_SPACE;
 			goto out;
 		}
 
-		new_fat_entry = tee_mm_get_smem(mm);
-
 		res = update_write_helper(fh, pos, buf, size,
 					  new_fat_entry, new_size);
 		if (res == TEE_SUCCESS) {
@@ -2725,22 +3396,34 @@ static TEE_Result rpmb_fs_truncate(struct tee_file_handle *tfh, size_t length)
 	if (newsize > fh->fat_entry.data_size) {
 		/* Extend file */
 
-		pool_result = tee_mm_init(&p,
-					  RPMB_STORAGE_START_ADDRESS,
-					  fs_par->max_rpmb_address,
-					  RPMB_BLOCK_SIZE_SHIFT,
-					  TEE_MM_POOL_HI_ALLOC);
-		if (!pool_result) {
-			res = TEE_ERROR_OUT_OF_MEMORY;
-			goto out;
+		if (IS_ENABLED(CFG_RPMB_FS_FAT_INDEX)) {
+			res = fat_index_alloc(newsize, &newaddr);
+			if (res != TEE_SUCCESS)
+				goto out;
+		} else {
+			pool_result = tee_mm_init(&p,
+						  RPMB_STORAGE_START_ADDRESS,
+						  fs_par->max_rpmb_address,
+						  RPMB_BLOCK_SIZE_SHIFT,
+						  TEE_MM_POOL_HI_ALLOC);
+			if (!pool_result) {
+				res = TEE_ERROR_OUT_OF_MEMORY;
+				goto out;
+			}
+			res = read_fat(fh, &p);
+			if (res != TEE_SUCCESS)
+				goto out;
+
+			mm = tee_mm_alloc(&p, newsize);
+			if (!mm) {
+				res = TEE_ERROR_OUT_OF_MEMORY;
+				goto out;
+			}
+			newaddr = tee_mm_get_smem(mm);
 		}
-		res = read_fat(fh, &p);
-		if (res != TEE_SUCCESS)
-			goto out;
 
-		mm = tee_mm_alloc(&p, newsize);
 		newbuf = calloc(1, newsize);
-		if (!mm || !newbuf) {
+		if (!newbuf) {
 			res = TEE_ERROR_OUT_OF_MEMORY;
 			goto out;
 		}
@@ -2754,7 +3437,6 @@ static TEE_Result rpmb_fs_truncate(struct tee_file_handle *tfh, size_t length)
 				goto out;
 		}
 
-		newaddr = tee_mm_get_smem(mm);
 		res = tee_rpmb_write(CFG_RPMB_FS_DEV_ID, newaddr, newbuf,
 				     newsize, fh->fat_entry.fek, fh->uuid);
 		if (res != TEE_SUCCESS)
@@ -2937,6 +3619,32 @@ static TEE_Result rpmb_fs_readdir(struct tee_fs_dir *dir,
 	return TEE_SUCCESS;
 }
 
+static TEE_Result rpmb_fs_readdir_batch(struct tee_fs_dir *dir,
+					struct tee_fs_dirent *ents, size_t *num)
+{
+	struct tee_rpmb_fs_dirent *e = NULL;
+	size_t n = 0;
+
+	if (!dir)
+		return TEE_ERROR_GENERIC;
+
+	/* All entries were read by rpmb_fs_opendir() */
+	for (n = 0; n < *num; n++) {
+		e = SIMPLEQ_FIRST(&dir->next);
+		if (!e)
+			break;
+		SIMPLEQ_REMOVE_HEAD(&dir->next, link);
+		ents[n] = e->entry;
+		free(e);
+	}
+
+	if (!n)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	*num = n;
+	return TEE_SUCCESS;
+}
+
 static void rpmb_fs_closedir(struct tee_fs_dir *dir)
 {
 	if (dir) {
@@ -3048,8 +3756,16 @@ const struct tee_file_operations rpmb_fs_ops = {
 	.opendir = rpmb_fs_opendir,
 	.closedir = rpmb_fs_closedir,
 	.readdir = rpmb_fs_readdir,
+	.readdir_batch = rpmb_fs_readdir_batch,
 };
 
+void tee_rpmb_fs_get_stats(struct tee_rpmb_fs_stats *stats)
+{
+	mutex_lock(&rpmb_mutex);
+	*stats = rpmb_fs_stats;
+	mutex_unlock(&rpmb_mutex);
+}
+
 TEE_Result tee_rpmb_fs_raw_open(const char *fname, bool create,
 				struct tee_file_handle **ret_fh)
 {
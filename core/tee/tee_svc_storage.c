@@ -13,6 +13,7 @@
 #include <kernel/user_access.h>
 #include <mm/vm.h>
 #include <string.h>
+#include <string_ext.h>
 #include <tee_api_defines_extensions.h>
 #include <tee_api_defines.h>
 #include <tee/tee_fs.h>
@@ -21,6 +22,7 @@
 #include <tee/tee_svc_cryp.h>
 #include <tee/tee_svc.h>
 #include <tee/tee_svc_storage.h>
+#include <tee/tee_svc_storage_cache.h>
 #include <trace.h>
 
 /* Header of GP formated secure storage files */
@@ -33,10 +35,25 @@ struct tee_svc_storage_head {
 	uint32_t have_attrs;
 };
 
+/* Number of directory entries read at a time with readdir_batch() */
+#define ENUM_BATCH_SIZE		16
+
+/*
+ * struct tee_storage_enum - a persistent object enumerator
+ * @link:	link in the list of enumerators of the TA
+ * @dir:	directory being enumerated
+ * @fops:	file operations of the storage of @dir
+ * @ents:	entries read ahead from @dir, allocated on first use
+ * @num_ents:	number of valid entries in @ents
+ * @next_ent:	index of the next entry in @ents to return
+ */
 struct tee_storage_enum {
 	TAILQ_ENTRY(tee_storage_enum) link;
 	struct tee_fs_dir *dir;
 	const struct tee_file_operations *fops;
+	struct tee_fs_dirent *ents;
+	size_t num_ents;
+	size_t next_ent;
 };
 
 static TEE_Result tee_svc_storage_get_enum(struct user_ta_ctx *utc,
@@ -68,6 +85,7 @@ static TEE_Result tee_svc_close_enum(struct user_ta_ctx *utc,
 	e->dir = NULL;
 	e->fops = NULL;
 
+	free(e->ents);
 	free(e);
 
 	return TEE_SUCCESS;
@@ -76,47 +94,106 @@ static TEE_Result tee_svc_close_enum(struct user_ta_ctx *utc,
 static TEE_Result tee_svc_storage_remove_corrupt_obj(struct ts_session *sess,
 						     struct tee_obj *o)
 {
+	tee_svc_storage_cache_remove(o->pobj);
 	o->pobj->fops->remove(o->pobj);
+	tee_svc_storage_cache_remove(o->pobj);
 	tee_obj_close(to_user_ta_ctx(sess->ctx), o);
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result tee_svc_storage_read_head(struct tee_obj *o)
+/*
+ * Reads the head and attributes of an opened object from storage into an
+ * allocated buffer
+ */
+static TEE_Result read_head_from_storage(struct tee_obj *o, size_t size,
+					 uint8_t **data, size_t *len)
 {
 	TEE_Result res = TEE_SUCCESS;
 	size_t bytes;
 	struct tee_svc_storage_head head;
 	const struct tee_file_operations *fops = o->pobj->fops;
-	void *attr = NULL;
-	size_t size;
+	uint8_t *buf = NULL;
 	size_t tmp = 0;
 
-	assert(!o->fh);
-	res = fops->open(o->pobj, &size, &o->fh);
-	if (res != TEE_SUCCESS)
-		goto exit;
-
 	/* read head */
 	bytes = sizeof(struct tee_svc_storage_head);
 	res = fops->read(o->fh, 0, &head, &bytes);
 	if (res != TEE_SUCCESS) {
 		if (res == TEE_ERROR_CORRUPT_OBJECT)
 			EMSG("Head corrupt");
-		goto exit;
+		return res;
 	}
 
-	if (ADD_OVERFLOW(sizeof(head), head.attr_size, &tmp)) {
-		res = TEE_ERROR_OVERFLOW;
-		goto exit;
+	if (ADD_OVERFLOW(sizeof(head), head.attr_size, &tmp))
+		return TEE_ERROR_OVERFLOW;
+	if (tmp > size)
+		return TEE_ERROR_CORRUPT_OBJECT;
+
+	if (bytes != sizeof(struct tee_svc_storage_head))
+		return TEE_ERROR_BAD_FORMAT;
+
+	buf = malloc(tmp);
+	if (!buf)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	memcpy(buf, &head, sizeof(head));
+
+	if (head.attr_size) {
+		/* read meta */
+		bytes = head.attr_size;
+		res = fops->read(o->fh, sizeof(struct tee_svc_storage_head),
+				 buf + sizeof(head), &bytes);
+		if (res != TEE_SUCCESS && res != TEE_ERROR_OUT_OF_MEMORY)
+			res = TEE_ERROR_CORRUPT_OBJECT;
+		if (!res && bytes != head.attr_size)
+			res = TEE_ERROR_CORRUPT_OBJECT;
+		if (res) {
+			free(buf);
+			return res;
+		}
 	}
-	if (tmp > size) {
-		res = TEE_ERROR_CORRUPT_OBJECT;
+
+	*data = buf;
+	*len = tmp;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tee_svc_storage_read_head(struct tee_obj *o)
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_svc_storage_head head;
+	const struct tee_file_operations *fops = o->pobj->fops;
+	bool cached = false;
+	uint8_t *buf = NULL;
+	size_t len = 0;
+	size_t size;
+	uint32_t gen = 0;
+
+	assert(!o->fh);
+	/*
+	 * Taken before the object is opened, an object changed after that
+	 * can't have its previous head cached.
+	 */
+	gen = tee_svc_storage_cache_get_gen();
+	res = fops->open(o->pobj, &size, &o->fh);
+	if (res != TEE_SUCCESS)
 		goto exit;
+
+	/*
+	 * The object has been opened, and thus authenticated, by the
+	 * storage, so a cached head can be used instead of reading it again.
+	 */
+	cached = tee_svc_storage_cache_get(o->pobj, (void **)&buf, &len);
+	if (!cached) {
+		res = read_head_from_storage(o, size, &buf, &len);
+		if (res != TEE_SUCCESS)
+			goto exit;
 	}
 
-	if (bytes != sizeof(struct tee_svc_storage_head)) {
-		res = TEE_ERROR_BAD_FORMAT;
+	memcpy(&head, buf, sizeof(head));
+	if (len > size) {
+		res = TEE_ERROR_CORRUPT_OBJECT;
 		goto exit;
 	}
 
@@ -124,39 +201,25 @@ static TEE_Result tee_svc_storage_read_head(struct tee_obj *o)
 	if (res != TEE_SUCCESS)
 		goto exit;
 
-	o->ds_pos = tmp;
-
-	if (head.attr_size) {
-		attr = malloc(head.attr_size);
-		if (!attr) {
-			res = TEE_ERROR_OUT_OF_MEMORY;
-			goto exit;
-		}
-
-		/* read meta */
-		bytes = head.attr_size;
-		res = fops->read(o->fh, sizeof(struct tee_svc_storage_head),
-				 attr, &bytes);
-		if (res == TEE_ERROR_OUT_OF_MEMORY)
-			goto exit;
-		if (res != TEE_SUCCESS || bytes != head.attr_size)
-			res = TEE_ERROR_CORRUPT_OBJECT;
-		if (res)
-			goto exit;
-	}
+	o->ds_pos = len;
 
-	res = tee_obj_attr_from_binary(o, attr, head.attr_size);
+	res = tee_obj_attr_from_binary(o, buf + sizeof(head), head.attr_size);
 	if (res != TEE_SUCCESS)
 		goto exit;
 
-	o->info.dataSize = size - sizeof(head) - head.attr_size;
+	o->info.dataSize = size - len;
 	o->info.keySize = head.keySize;
 	o->info.objectUsage = head.objectUsage;
 	o->info.objectType = head.objectType;
 	o->have_attrs = head.have_attrs;
 
+	if (!cached)
+		tee_svc_storage_cache_put(o->pobj, gen, buf, len);
+
 exit:
-	free(attr);
+	if (buf)
+		memzero_explicit(buf, len);
+	free(buf);
 
 	return res;
 }
@@ -294,8 +357,14 @@ static TEE_Result tee_svc_storage_init_file(struct tee_obj *o, bool overwrite,
 	head.objectType = o->info.objectType;
 	head.have_attrs = o->have_attrs;
 
+	/*
+	 * The head is removed from the cache both before and after the
+	 * object is changed, it can't be served or added in between.
+	 */
+	tee_svc_storage_cache_remove(o->pobj);
 	res = fops->create(o->pobj, overwrite, &head, sizeof(head), attr,
 			   attr_size, data, len, &o->fh);
+	tee_svc_storage_cache_remove(o->pobj);
 
 	if (!res)
 		o->info.dataSize = len;
@@ -404,8 +473,11 @@ oclose:
 err:
 	if (res == TEE_ERROR_NO_DATA || res == TEE_ERROR_BAD_FORMAT)
 		res = TEE_ERROR_CORRUPT_OBJECT;
-	if (res == TEE_ERROR_CORRUPT_OBJECT && po)
+	if (res == TEE_ERROR_CORRUPT_OBJECT && po) {
+		tee_svc_storage_cache_remove(po);
 		fops->remove(po);
+		tee_svc_storage_cache_remove(po);
+	}
 	if (o) {
 		fops->close(&o->fh);
 		tee_obj_free(o);
@@ -448,7 +520,9 @@ TEE_Result syscall_storage_obj_del(unsigned long obj)
 		free(data);
 	}
 
+	tee_svc_storage_cache_remove(o->pobj);
 	res = o->pobj->fops->remove(o->pobj);
+	tee_svc_storage_cache_remove(o->pobj);
 	tee_obj_close(utc, o);
 
 	return res;
@@ -502,7 +576,11 @@ TEE_Result syscall_storage_obj_rename(unsigned long obj, void *object_id,
 		goto exit;
 
 	/* move */
+	tee_svc_storage_cache_remove(o->pobj);
+	tee_svc_storage_cache_remove(po);
 	res = fops->rename(o->pobj, po, false /* no overwrite */);
+	tee_svc_storage_cache_remove(o->pobj);
+	tee_svc_storage_cache_remove(po);
 	if (res)
 		goto exit;
 
@@ -532,6 +610,9 @@ TEE_Result syscall_storage_alloc_enum(uint32_t *obj_enum)
 
 	e->dir = NULL;
 	e->fops = NULL;
+	e->ents = NULL;
+	e->num_ents = 0;
+	e->next_ent = 0;
 	TAILQ_INSERT_TAIL(&utc->storage_enums, e, link);
 
 	return copy_kaddr_to_uref(obj_enum, e);
@@ -569,6 +650,8 @@ TEE_Result syscall_storage_reset_enum(unsigned long obj_enum)
 		e->dir = NULL;
 	}
 	assert(!e->dir);
+	e->num_ents = 0;
+	e->next_ent = 0;
 
 	return TEE_SUCCESS;
 }
@@ -591,6 +674,8 @@ TEE_Result syscall_storage_start_enum(unsigned long obj_enum,
 		e->fops->closedir(e->dir);
 		e->dir = NULL;
 	}
+	e->num_ents = 0;
+	e->next_ent = 0;
 
 	if (!fops)
 		return TEE_ERROR_ITEM_NOT_FOUND;
@@ -600,6 +685,42 @@ TEE_Result syscall_storage_start_enum(unsigned long obj_enum,
 	return fops->opendir(&sess->ctx->uuid, &e->dir);
 }
 
+/*
+ * Returns the next directory entry of the enumerator, entries are read
+ * ENUM_BATCH_SIZE at a time if the storage supports it.
+ */
+static TEE_Result enum_next_dirent(struct tee_storage_enum *e,
+				   struct tee_fs_dirent **d)
+{
+	TEE_Result res = TEE_SUCCESS;
+	size_t num = ENUM_BATCH_SIZE;
+
+	if (!e->fops)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	if (!e->fops->readdir_batch)
+		return e->fops->readdir(e->dir, d);
+
+	if (e->next_ent == e->num_ents) {
+		if (!e->ents) {
+			e->ents = calloc(ENUM_BATCH_SIZE, sizeof(*e->ents));
+			if (!e->ents)
+				return TEE_ERROR_OUT_OF_MEMORY;
+		}
+
+		res = e->fops->readdir_batch(e->dir, e->ents, &num);
+		if (res)
+			return res;
+		e->num_ents = num;
+		e->next_ent = 0;
+	}
+
+	*d = e->ents + e->next_ent;
+	e->next_ent++;
+
+	return TEE_SUCCESS;
+}
+
 TEE_Result syscall_storage_next_enum(unsigned long obj_enum,
 			TEE_ObjectInfo *info, void *obj_id, uint64_t *len)
 {
@@ -626,30 +747,36 @@ TEE_Result syscall_storage_next_enum(unsigned long obj_enum,
 	if (res != TEE_SUCCESS)
 		goto exit;
 
-	if (!e->fops) {
-		res = TEE_ERROR_ITEM_NOT_FOUND;
-		goto exit;
-	}
-
-	res = e->fops->readdir(e->dir, &d);
-	if (res != TEE_SUCCESS)
-		goto exit;
-
 	o = tee_obj_alloc();
 	if (o == NULL) {
 		res = TEE_ERROR_OUT_OF_MEMORY;
 		goto exit;
 	}
 
-	res = tee_pobj_get(&sess->ctx->uuid, d->oid, d->oidlen, 0,
-			   TEE_POBJ_USAGE_ENUM, e->fops, &o->pobj);
-	if (res)
-		goto exit;
+	while (true) {
+		res = enum_next_dirent(e, &d);
+		if (res != TEE_SUCCESS)
+			goto exit;
+
+		res = tee_pobj_get(&sess->ctx->uuid, d->oid, d->oidlen, 0,
+				   TEE_POBJ_USAGE_ENUM, e->fops, &o->pobj);
+		if (res)
+			goto exit;
 
-	o->info.handleFlags = o->pobj->flags | TEE_HANDLE_FLAG_PERSISTENT |
-			      TEE_HANDLE_FLAG_INITIALIZED;
+		o->info.handleFlags = o->pobj->flags |
+				      TEE_HANDLE_FLAG_PERSISTENT |
+				      TEE_HANDLE_FLAG_INITIALIZED;
 
-	res = tee_svc_storage_read_head(o);
+		res = tee_svc_storage_read_head(o);
+		if (res != TEE_ERROR_ITEM_NOT_FOUND)
+			break;
+
+		/* Removed since the entry was read ahead, skip it */
+		o->pobj->fops->close(&o->fh);
+		tee_pobj_release(o->pobj);
+		o->pobj = NULL;
+		memset(&o->info, 0, sizeof(o->info));
+	}
 	if (res != TEE_SUCCESS)
 		goto exit;
 
@@ -671,6 +798,201 @@ exit:
 	return res;
 }
 
+/*
+ * Returns the IDs of up to *count objects without opening them, cheaper
+ * than syscall_storage_next_enum() when the object info isn't needed.
+ */
+TEE_Result syscall_storage_next_enum_ids(unsigned long obj_enum,
+					 void *obj_ids, uint32_t *obj_id_lens,
+					 uint64_t *count)
+{
+	struct ts_session *sess = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
+	struct tee_storage_enum *e = NULL;
+	struct tee_fs_dirent *d = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	uint8_t *ids = obj_ids;
+	uint64_t cnt = 0;
+	uint32_t l = 0;
+	size_t sz = 0;
+	size_t n = 0;
+
+	res = tee_svc_storage_get_enum(utc, uref_to_vaddr(obj_enum), &e);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	res = copy_from_user_private(&cnt, count, sizeof(cnt));
+	if (res != TEE_SUCCESS)
+		return res;
+	if (!cnt)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* check rights of the provided buffers */
+	if (MUL_OVERFLOW(cnt, TEE_OBJECT_ID_MAX_LEN, &sz))
+		return TEE_ERROR_OVERFLOW;
+	res = vm_check_access_rights(&utc->uctx, TEE_MEMORY_ACCESS_WRITE,
+				     (uaddr_t)obj_ids, sz);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	if (MUL_OVERFLOW(cnt, sizeof(*obj_id_lens), &sz))
+		return TEE_ERROR_OVERFLOW;
+	res = vm_check_access_rights(&utc->uctx, TEE_MEMORY_ACCESS_WRITE,
+				     (uaddr_t)obj_id_lens, sz);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	for (n = 0; n < cnt; n++) {
+		res = enum_next_dirent(e, &d);
+		if (res != TEE_SUCCESS)
+			break;
+
+		res = copy_to_user(ids + n * TEE_OBJECT_ID_MAX_LEN, d->oid,
+				   d->oidlen);
+		if (res != TEE_SUCCESS)
+			return res;
+		l = d->oidlen;
+		res = copy_to_user(obj_id_lens + n, &l, sizeof(l));
+		if (res != TEE_SUCCESS)
+			return res;
+	}
+
+	/* Return what was found before reaching the end */
+	if (!n)
+		return res;
+
+	cnt = n;
+	return copy_to_user_private(count, &cnt, sizeof(cnt));
+}
+
+/*
+ * Adds the object to the storage transaction of the TA, if one is started
+ * and the storage supports transactions. Objects on other storages are
+ * updated right away as usual.
+ */
+static TEE_Result trans_join(struct user_ta_ctx *utc, struct tee_obj *o)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	if (!utc->storage_trans || o->in_trans ||
+	    !o->pobj->fops->begin_transaction)
+		return TEE_SUCCESS;
+
+	res = o->pobj->fops->begin_transaction(o->fh);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	o->in_trans = true;
+	o->trans_data_size = o->info.dataSize;
+
+	return TEE_SUCCESS;
+}
+
+static void trans_abort_obj(struct tee_obj *o)
+{
+	o->pobj->fops->abort_transaction(&o->fh, 1);
+	o->info.dataSize = o->trans_data_size;
+	o->in_trans = false;
+}
+
+/*
+ * Commits the objects of the transaction one storage at a time, all
+ * objects on the same storage are committed atomically. Once a commit
+ * has failed the remaining objects are reverted.
+ *
+ * TEE_ERROR_OUT_OF_MEMORY is only returned if nothing has been committed
+ * or reverted, a storage running out of memory reports
+ * TEE_ERROR_GENERIC instead since the transaction is gone by then.
+ */
+static TEE_Result trans_commit(struct user_ta_ctx *utc)
+{
+	const struct tee_file_operations *fops = NULL;
+	struct tee_file_handle **fhs = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_obj *o = NULL;
+	size_t num = 0;
+
+	TAILQ_FOREACH(o, &utc->objects, link)
+		if (o->in_trans)
+			num++;
+	if (!num)
+		return TEE_SUCCESS;
+
+	fhs = calloc(num, sizeof(*fhs));
+	if (!fhs)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	while (true) {
+		fops = NULL;
+		num = 0;
+		TAILQ_FOREACH(o, &utc->objects, link) {
+			if (!o->in_trans)
+				continue;
+			if (!fops)
+				fops = o->pobj->fops;
+			if (o->pobj->fops == fops) {
+				fhs[num] = o->fh;
+				num++;
+			}
+		}
+		if (!fops)
+			break;
+
+		if (res == TEE_SUCCESS)
+			res = fops->commit_transaction(fhs, num);
+		else
+			fops->abort_transaction(fhs, num);
+
+		TAILQ_FOREACH(o, &utc->objects, link) {
+			if (!o->in_trans || o->pobj->fops != fops)
+				continue;
+			if (res != TEE_SUCCESS)
+				o->info.dataSize = o->trans_data_size;
+			o->in_trans = false;
+		}
+	}
+
+	free(fhs);
+	if (res == TEE_ERROR_OUT_OF_MEMORY)
+		return TEE_ERROR_GENERIC;
+	return res;
+}
+
+TEE_Result syscall_storage_transaction(unsigned long op)
+{
+	struct ts_session *sess = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_obj *o = NULL;
+
+	switch (op) {
+	case UTEE_STORAGE_TRANS_BEGIN:
+		if (utc->storage_trans)
+			return TEE_ERROR_BAD_STATE;
+		utc->storage_trans = true;
+		return TEE_SUCCESS;
+	case UTEE_STORAGE_TRANS_COMMIT:
+		if (!utc->storage_trans)
+			return TEE_ERROR_BAD_STATE;
+		res = trans_commit(utc);
+		/* Nothing done, keep the transaction to be committed again */
+		if (res == TEE_ERROR_OUT_OF_MEMORY)
+			return res;
+		utc->storage_trans = false;
+		return res;
+	case UTEE_STORAGE_TRANS_ABORT:
+		if (!utc->storage_trans)
+			return TEE_ERROR_BAD_STATE;
+		TAILQ_FOREACH(o, &utc->objects, link)
+			if (o->in_trans)
+				trans_abort_obj(o);
+		utc->storage_trans = false;
+		return TEE_SUCCESS;
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+}
+
 TEE_Result syscall_storage_obj_read(unsigned long obj, void *data, size_t len,
 				    uint64_t *count)
 {
@@ -768,6 +1090,10 @@ TEE_Result syscall_storage_obj_write(unsigned long obj, void *data, size_t len)
 		res = TEE_ERROR_ACCESS_CONFLICT;
 		goto exit;
 	}
+	res = trans_join(utc, o);
+	if (res != TEE_SUCCESS)
+		goto exit;
+
 	res = o->pobj->fops->write(o->fh, pos_tmp, data, len);
 	if (res != TEE_SUCCESS)
 		goto exit;
@@ -783,12 +1109,13 @@ exit:
 TEE_Result syscall_storage_obj_trunc(unsigned long obj, size_t len)
 {
 	struct ts_session *sess = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
 	TEE_Result res = TEE_SUCCESS;
 	struct tee_obj *o = NULL;
 	size_t off = 0;
 	size_t attr_size = 0;
 
-	res = tee_obj_get(to_user_ta_ctx(sess->ctx), uref_to_vaddr(obj), &o);
+	res = tee_obj_get(utc, uref_to_vaddr(obj), &o);
 	if (res != TEE_SUCCESS)
 		goto exit;
 
@@ -815,6 +1142,11 @@ TEE_Result syscall_storage_obj_trunc(unsigned long obj, size_t len)
 		res = TEE_ERROR_OVERFLOW;
 		goto exit;
 	}
+
+	res = trans_join(utc, o);
+	if (res != TEE_SUCCESS)
+		goto exit;
+
 	res = o->pobj->fops->truncate(o->fh, off);
 	switch (res) {
 	case TEE_SUCCESS:
@@ -877,6 +1209,33 @@ TEE_Result syscall_storage_obj_seek(unsigned long obj, int32_t offset,
 	return TEE_SUCCESS;
 }
 
+TEE_Result syscall_storage_obj_sync(unsigned long obj)
+{
+	struct ts_session *sess = ts_get_current_session();
+	struct user_ta_ctx *utc = to_user_ta_ctx(sess->ctx);
+	TEE_Result res = TEE_SUCCESS;
+	struct tee_obj *o = NULL;
+
+	res = tee_obj_get(utc, uref_to_vaddr(obj), &o);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	if (!(o->info.handleFlags & TEE_HANDLE_FLAG_PERSISTENT))
+		return TEE_ERROR_BAD_STATE;
+
+	/* Changes in a transaction are stored when it's committed */
+	if (!o->pobj->fops->sync || o->in_trans)
+		return TEE_SUCCESS;
+
+	res = o->pobj->fops->sync(o->fh);
+	if (res == TEE_ERROR_CORRUPT_OBJECT) {
+		EMSG("Object corruption");
+		(void)tee_svc_storage_remove_corrupt_obj(sess, o);
+	}
+
+	return res;
+}
+
 void tee_svc_storage_close_all_enum(struct user_ta_ctx *utc)
 {
 	struct tee_storage_enum_head *eh = &utc->storage_enums;
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: BSD-2-Clause
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#include <kernel/mutex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_ext.h>
+#include <sys/queue.h>
+#include <tee_api_defines.h>
+#include <tee/tee_svc_storage_cache.h>
+#include <util.h>
+
+/*
+ * struct cache_ent - cached head of a persistent object
+ * @link:	link in @cache_lru, most recently used first
+ * @uuid:	UUID of the TA owning the object
+ * @fops:	storage of the object
+ * @obj_id:	object ID
+ * @obj_id_len:	size of @obj_id
+ * @len:	size of @data
+ * @data:	head and attributes of the object as stored
+ */
+struct cache_ent {
+	TAILQ_ENTRY(cache_ent) link;
+	TEE_UUID uuid;
+	const struct tee_file_operations *fops;
+	uint8_t obj_id[TEE_OBJECT_ID_MAX_LEN];
+	uint32_t obj_id_len;
+	size_t len;
+	uint8_t data[];
+};
+
+static TAILQ_HEAD(cache_lru_head, cache_ent) cache_lru =
+	TAILQ_HEAD_INITIALIZER(cache_lru);
+static size_t cache_size;
+static uint32_t cache_gen;
+static struct mutex cache_mu = MUTEX_INITIALIZER;
+
+static size_t ent_size(size_t len)
+{
+	return sizeof(struct cache_ent) + len;
+}
+
+/* Called with cache_mu held */
+static struct cache_ent *find_ent(const struct tee_pobj *po)
+{
+	struct cache_ent *e = NULL;
+
+	TAILQ_FOREACH(e, &cache_lru, link)
+		if (e->fops == po->fops && e->obj_id_len == po->obj_id_len &&
+		    !memcmp(&e->uuid, &po->uuid, sizeof(e->uuid)) &&
+		    !memcmp(e->obj_id, po->obj_id, po->obj_id_len))
+			return e;
+
+	return NULL;
+}
+
+/* Called with cache_mu held */
+static void remove_ent(struct cache_ent *e)
+{
+	TAILQ_REMOVE(&cache_lru, e, link);
+	cache_size -= ent_size(e->len);
+	/* The attributes may hold key material */
+	memzero_explicit(e->data, e->len);
+	free(e);
+}
+
+uint32_t tee_svc_storage_cache_get_gen(void)
+{
+	uint32_t gen = 0;
+
+	mutex_lock(&cache_mu);
+	gen = cache_gen;
+	mutex_unlock(&cache_mu);
+
+	return gen;
+}
+
+bool tee_svc_storage_cache_get(const struct tee_pobj *po, void **data,
+			       size_t *len)
+{
+	struct cache_ent *e = NULL;
+	bool ret = false;
+
+	mutex_lock(&cache_mu);
+	e = find_ent(po);
+	if (e) {
+		*data = malloc(e->len);
+		if (*data) {
+			memcpy(*data, e->data, e->len);
+			*len = e->len;
+			TAILQ_REMOVE(&cache_lru, e, link);
+			TAILQ_INSERT_HEAD(&cache_lru, e, link);
+			ret = true;
+		}
+	}
+	mutex_unlock(&cache_mu);
+
+	return ret;
+}
+
+void tee_svc_storage_cache_put(const struct tee_pobj *po, uint32_t gen,
+			       const void *data, size_t len)
+{
+	struct cache_ent *e = NULL;
+
+	if (ent_size(len) > CFG_STORAGE_HEAD_CACHE_SIZE ||
+	    po->obj_id_len > sizeof(e->obj_id))
+		return;
+
+	mutex_lock(&cache_mu);
+
+	/* The object may have changed since @data was read */
+	if (gen != cache_gen)
+		goto out;
+
+	e = find_ent(po);
+	if (e)
+		remove_ent(e);
+
+	while (cache_size + ent_size(len) > CFG_STORAGE_HEAD_CACHE_SIZE)
+		remove_ent(TAILQ_LAST(&cache_lru, cache_lru_head));
+
+	e = malloc(ent_size(len));
+	if (!e)
+		goto out;
+
+	e->uuid = po->uuid;
+	e->fops = po->fops;
+	memcpy(e->obj_id, po->obj_id, po->obj_id_len);
+	e->obj_id_len = po->obj_id_len;
+	e->len = len;
+	memcpy(e->data, data, len);
+
+	TAILQ_INSERT_HEAD(&cache_lru, e, link);
+	cache_size += ent_size(len);
+out:
+	mutex_unlock(&cache_mu);
+}
+
+void tee_svc_storage_cache_remove(const struct tee_pobj *po)
+{
+	struct cache_ent *e = NULL;
+
+	mutex_lock(&cache_mu);
+	cache_gen++;
+	e = find_ent(po);
+	if (e)
+		remove_ent(e);
+	mutex_unlock(&cache_mu);
+}
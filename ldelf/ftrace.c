@@ -4,7 +4,9 @@
  */
 
 #include <assert.h>
+#include <config.h>
 #include <printk.h>
+#include <string.h>
 #include <sys/queue.h>
 #include <types_ext.h>
 #include <util.h>
@@ -59,12 +61,57 @@ bool ftrace_init(struct ftrace_buf **fbuf_ptr)
 	fbuf->max_size = fbuf_size - sizeof(struct ftrace_buf) - count;
 	fbuf->syscall_trace_enabled = false;
 	fbuf->syscall_trace_suspended = false;
+	fbuf->last_time = 0;
+	fbuf->rec_off = 0;
+	fbuf->cntfrq = 0;
+
+	if (IS_ENABLED(CFG_FTRACE_BINARY)) {
+		size_t rec_size = sizeof(struct ftrace_rec);
+
+		/* Binary records are kept aligned, whole records only */
+		fbuf->buf_off = ROUNDUP(fbuf->buf_off, sizeof(uint64_t));
+		fbuf->max_size = ROUNDDOWN(fbuf_size - fbuf->buf_off, rec_size);
+	}
 
 	*fbuf_ptr = fbuf;
 
 	return true;
 }
 
+/*
+ * Dumps the text header followed by a struct ftrace_bin_hdr and the
+ * records of the ring buffer, oldest first. The header line is kept
+ * byte-for-byte identical to the text format so that the decoder can
+ * locate the start of the binary data.
+ */
+static void copy_bin_buf(struct ta_elf *elf, void *pctx,
+			 void (*copy_func)(void *pctx, void *b, size_t bl))
+{
+	char *recs = (char *)fbuf + fbuf->buf_off;
+	struct ftrace_bin_hdr hdr = {
+		.magic = FTRACE_BIN_MAGIC,
+		.version = FTRACE_BIN_VERSION,
+		.rec_size = sizeof(struct ftrace_rec),
+		.cntfrq = fbuf->cntfrq,
+		.num_recs = fbuf->curr_size / sizeof(struct ftrace_rec),
+		.last_time = fbuf->last_time,
+	};
+	size_t hlen = 0;
+
+	if (elf->is_32bit)
+		hdr.flags |= FTRACE_BIN_FLAG_32BIT;
+
+	hlen = strnlen((char *)fbuf + fbuf->head_off, MAX_HEADER_STRLEN);
+	copy_func(pctx, (char *)fbuf + fbuf->head_off, hlen);
+	copy_func(pctx, &hdr, sizeof(hdr));
+
+	/* Records older than rec_off are only present if the ring wrapped */
+	if (fbuf->curr_size > fbuf->rec_off)
+		copy_func(pctx, recs + fbuf->rec_off,
+			  fbuf->curr_size - fbuf->rec_off);
+	copy_func(pctx, recs, fbuf->rec_off);
+}
+
 void ftrace_copy_buf(void *pctx, void (*copy_func)(void *pctx, void *b,
 						   size_t bl))
 {
@@ -74,7 +121,11 @@ void ftrace_copy_buf(void *pctx, void (*copy_func)(void *pctx, void *b,
 				   fbuf->curr_size;
 
 		assert(elf && elf->is_main);
-		copy_func(pctx, (char *)fbuf + fbuf->head_off, dump_size);
+		if (IS_ENABLED(CFG_FTRACE_BINARY))
+			copy_bin_buf(elf, pctx, copy_func);
+		else
+			copy_func(pctx, (char *)fbuf + fbuf->head_off,
+				  dump_size);
 	}
 }
 
@@ -4,6 +4,7 @@
  */
 
 #include <assert.h>
+#include <config.h>
 #include <ldelf.h>
 #include <malloc.h>
 #include <printk.h>
@@ -130,6 +131,9 @@ void ldelf(struct ldelf_arg *arg)
 {
 	TEE_Result res = TEE_SUCCESS;
 	struct ta_elf *elf = NULL;
+	uint64_t load_start = sys_get_time_us();
+	uint64_t reloc_start = 0;
+	uint64_t reloc_end = 0;
 
 	DMSG("Loading TS %pUl", (void *)&arg->uuid);
 	res = sys_map_zi(mpool_size, 0, &mpool_base, 0, 0);
@@ -151,10 +155,12 @@ void ldelf(struct ldelf_arg *arg)
 	TAILQ_FOREACH(elf, &main_elf_queue, link)
 		ta_elf_load_dependency(elf, arg->is_32bit);
 
+	reloc_start = sys_get_time_us();
 	TAILQ_FOREACH(elf, &main_elf_queue, link) {
 		ta_elf_relocate(elf);
 		ta_elf_finalize_mappings(elf);
 	}
+	reloc_end = sys_get_time_us();
 
 	ta_elf_finalize_load_main(&arg->entry_func);
 
@@ -168,6 +174,17 @@ void ldelf(struct ldelf_arg *arg)
 		DMSG("ELF (%pUl) at %#"PRIxVA,
 		     (void *)&elf->uuid, elf->load_addr);
 
+	if (IS_ENABLED(CFG_LDELF_TIMING)) {
+		size_t relocs = 0;
+		size_t lookups = 0;
+		size_t hits = 0;
+
+		ta_elf_get_reloc_stats(&relocs, &lookups, &hits);
+		DMSG("Loaded in %"PRIu64" us, %zu relocations in %"PRIu64" us, %zu symbol lookups (%zu cached)",
+		     sys_get_time_us() - load_start, relocs,
+		     reloc_end - reloc_start, lookups, hits);
+	}
+
 #if TRACE_LEVEL >= TRACE_ERROR
 	arg->dump_entry = (vaddr_t)(void *)dump_ta_state;
 #else
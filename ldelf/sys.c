@@ -28,6 +28,39 @@ void __panic(const char *file __maybe_unused, const int line __maybe_unused,
 		;
 }
 
+#ifdef CFG_LDELF_TIMING
+uint64_t sys_get_time_us(void)
+{
+	uint64_t cnt = 0;
+	uint64_t frq = 0;
+
+#ifdef ARM64
+	asm volatile ("isb");
+#ifdef CFG_CORE_SEL2_SPMC
+	asm volatile ("mrs %0, cntvct_el0" : "=r" (cnt));
+#else
+	asm volatile ("mrs %0, cntpct_el0" : "=r" (cnt));
+#endif
+	asm volatile ("mrs %0, cntfrq_el0" : "=r" (frq));
+#else
+	uint32_t frq32 = 0;
+
+	asm volatile ("isb");
+#ifdef CFG_CORE_SEL2_SPMC
+	asm volatile ("mrrc p15, 1, %Q0, %R0, c14" : "=r" (cnt));
+#else
+	asm volatile ("mrrc p15, 0, %Q0, %R0, c14" : "=r" (cnt));
+#endif
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (frq32));
+	frq = frq32;
+#endif
+	if (!frq)
+		return 0;
+
+	return cnt / frq * 1000000 + (cnt % frq) * 1000000 / frq;
+}
+#endif /*CFG_LDELF_TIMING*/
+
 void sys_return_cleanup(void)
 {
 	_ldelf_return(0);
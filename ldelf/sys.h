@@ -49,4 +49,14 @@ TEE_Result sys_remap(vaddr_t old_va, vaddr_t *new_va, size_t num_bytes,
 		     size_t pad_begin, size_t pad_end);
 TEE_Result sys_gen_random_num(void *buf, size_t blen);
 
+#ifdef CFG_LDELF_TIMING
+/* Returns a timestamp in microseconds based on the system counter */
+uint64_t sys_get_time_us(void);
+#else
+static inline uint64_t sys_get_time_us(void)
+{
+	return 0;
+}
+#endif
+
 #endif /*SYS_H*/
@@ -215,10 +215,10 @@ static void save_hashtab_from_segment(struct ta_elf *elf, unsigned int type,
 
 	for (n = 0; n < num_dyns; n++) {
 		read_dyn(elf, addr, n, &tag, &val);
-		if (tag == DT_HASH) {
+		if (tag == DT_HASH)
 			elf->hashtab = (void *)(val + elf->load_addr);
-			break;
-		}
+		else if (tag == DT_GNU_HASH)
+			elf->gnu_hashtab = (void *)(val + elf->load_addr);
 	}
 }
 
@@ -262,6 +262,42 @@ static void check_hashtab(struct ta_elf *elf, void *ptr, size_t num_buckets,
 	check_range(elf, "DT_HASH", ptr, sz);
 }
 
+static void check_gnu_hashtab(struct ta_elf *elf)
+{
+	/*
+	 * The DT_GNU_HASH table starts with four 32-bit words: nbuckets,
+	 * symoffset, bloom_size and bloom_shift. They are followed by
+	 * bloom_size Bloom filter words of the ELF class size, nbuckets
+	 * 32-bit buckets and one 32-bit chain entry for each symbol from
+	 * symoffset.
+	 */
+	uint32_t *hashtab = elf->gnu_hashtab;
+	size_t bloom_wsz = elf->is_32bit ? sizeof(uint32_t) : sizeof(uint64_t);
+	size_t num_words = 0;
+	size_t sz = 0;
+	size_t bsz = 0;
+
+	if (!IS_ALIGNED((vaddr_t)elf->gnu_hashtab, bloom_wsz))
+		err(TEE_ERROR_BAD_FORMAT, "Bad alignment of DT_GNU_HASH %p",
+		    elf->gnu_hashtab);
+	check_range(elf, "DT_GNU_HASH", hashtab, 4 * sizeof(uint32_t));
+
+	if (!hashtab[0] || !hashtab[2] || hashtab[1] > elf->num_dynsyms ||
+	    hashtab[3] >= 32)
+		err(TEE_ERROR_BAD_FORMAT, "Bad DT_GNU_HASH header");
+
+	num_words = 4;
+	if (ADD_OVERFLOW(num_words, hashtab[0], &num_words) ||
+	    ADD_OVERFLOW(num_words, elf->num_dynsyms - hashtab[1],
+			 &num_words) ||
+	    MUL_OVERFLOW(num_words, sizeof(uint32_t), &sz) ||
+	    MUL_OVERFLOW(hashtab[2], bloom_wsz, &bsz) ||
+	    ADD_OVERFLOW(sz, bsz, &sz))
+		err(TEE_ERROR_BAD_FORMAT, "DT_GNU_HASH overflow");
+
+	check_range(elf, "DT_GNU_HASH", hashtab, sz);
+}
+
 static void save_hashtab(struct ta_elf *elf)
 {
 	uint32_t *hashtab = NULL;
@@ -283,6 +319,13 @@ static void save_hashtab(struct ta_elf *elf)
 						  phdr[n].p_memsz);
 	}
 
+	/* DT_GNU_HASH is used when available, DT_HASH is required otherwise */
+	if (elf->gnu_hashtab) {
+		check_gnu_hashtab(elf);
+		elf->hashtab = NULL;
+		return;
+	}
+
 	check_hashtab(elf, elf->hashtab, 0, 0);
 	hashtab = elf->hashtab;
 	check_hashtab(elf, elf->hashtab, hashtab[0], hashtab[1]);
@@ -817,6 +860,15 @@ static void populate_segments(struct ta_elf *elf)
 				pad_begin = 0;
 			}
 
+			/*
+			 * Read-only segments are mapped shareable: the core
+			 * keeps their pages in slices of a struct file
+			 * identified by the tag (signed hash) of the binary,
+			 * so all instances of a TA, and all TAs using a
+			 * shared library, map the same physical pages while
+			 * at least one of them is loaded. Only writeable
+			 * segments are private copies.
+			 */
 			if (seg->flags & PF_W)
 				flags |= LDELF_MAP_FLAG_WRITEABLE;
 			else
@@ -57,7 +57,11 @@ struct ta_elf {
 	const char *dynstr;
 	size_t dynstr_size;
 
-	/* DT_HASH hash table for faster resolution of external symbols */
+	/*
+	 * DT_GNU_HASH or DT_HASH hash table for faster resolution of
+	 * external symbols, only one of them is used
+	 */
+	void *gnu_hashtab;
 	void *hashtab;
 
 	/* DT_SONAME */
@@ -124,6 +128,12 @@ static inline void ta_elf_stack_trace_a64(uint64_t fp __unused,
 
 TEE_Result ta_elf_resolve_sym(const char *name, vaddr_t *val,
 			      struct ta_elf **found_elf, struct ta_elf *elf);
+/*
+ * Number of relocations applied, of symbols resolved for relocations and of
+ * these how many hit the cache
+ */
+void ta_elf_get_reloc_stats(size_t *relocs, size_t *lookups,
+			    size_t *cache_hits);
 TEE_Result ta_elf_add_library(const TEE_UUID *uuid);
 TEE_Result ta_elf_set_init_fini_info_compat(bool is_32bit);
 TEE_Result ta_elf_set_elf_phdr_info(bool is_32bit);
@@ -16,6 +16,25 @@
 #include "sys.h"
 #include "ta_elf.h"
 
+/*
+ * Direct mapped cache of symbols resolved for relocations, indexed by the
+ * GNU hash of the name. Modules are only appended to main_elf_queue so a
+ * symbol once resolved keeps resolving to the same module and value.
+ */
+#define SYM_CACHE_SIZE		128
+
+struct sym_cache_entry {
+	const char *name;
+	struct ta_elf *elf;
+	vaddr_t val;
+	uint32_t hash;
+};
+
+static struct sym_cache_entry sym_cache[SYM_CACHE_SIZE];
+static size_t sym_lookups;
+static size_t sym_cache_hits;
+static size_t num_relocs;
+
 static uint32_t elf_hash(const char *name)
 {
 	const unsigned char *p = (const unsigned char *)name;
@@ -32,6 +51,16 @@ static uint32_t elf_hash(const char *name)
 	return h;
 }
 
+static uint32_t gnu_hash(const char *name)
+{
+	const unsigned char *p = (const unsigned char *)name;
+	uint32_t h = 5381;
+
+	while (*p)
+		h = (h << 5) + h + *p++;
+	return h;
+}
+
 static bool __resolve_sym(struct ta_elf *elf, unsigned int st_bind,
 			  unsigned int st_type, size_t st_shndx,
 			  size_t st_name, size_t st_value, const char *name,
@@ -78,9 +107,29 @@ static bool __resolve_sym(struct ta_elf *elf, unsigned int st_bind,
 	return true;
 }
 
-static TEE_Result resolve_sym_helper(uint32_t hash, const char *name,
-				     vaddr_t *val, struct ta_elf *elf,
-				     bool weak_ok)
+static bool resolve_sym_idx(struct ta_elf *elf, size_t n, const char *name,
+			    vaddr_t *val, bool weak_ok)
+{
+	if (elf->is_32bit) {
+		Elf32_Sym *sym = elf->dynsymtab;
+
+		return __resolve_sym(elf, ELF32_ST_BIND(sym[n].st_info),
+				     ELF32_ST_TYPE(sym[n].st_info),
+				     sym[n].st_shndx, sym[n].st_name,
+				     sym[n].st_value, name, val, weak_ok);
+	} else {
+		Elf64_Sym *sym = elf->dynsymtab;
+
+		return __resolve_sym(elf, ELF64_ST_BIND(sym[n].st_info),
+				     ELF64_ST_TYPE(sym[n].st_info),
+				     sym[n].st_shndx, sym[n].st_name,
+				     sym[n].st_value, name, val, weak_ok);
+	}
+}
+
+static TEE_Result resolve_sym_sysv(uint32_t hash, const char *name,
+				   vaddr_t *val, struct ta_elf *elf,
+				   bool weak_ok)
 {
 	/*
 	 * Using uint32_t here for convenience because both Elf64_Word
@@ -93,55 +142,94 @@ static TEE_Result resolve_sym_helper(uint32_t hash, const char *name,
 	uint32_t *chain = &bucket[nbuckets];
 	size_t n = 0;
 
-	if (elf->is_32bit) {
-		Elf32_Sym *sym = elf->dynsymtab;
+	for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
+		if (n >= nchains || n >= elf->num_dynsyms)
+			err(TEE_ERROR_BAD_FORMAT, "Index out of range");
+		/*
+		 * We're loading values from sym[] which later
+		 * will be used to load something.
+		 * => Spectre V1 pattern, need to cap the index
+		 * against speculation.
+		 */
+		n = confine_array_index(n, elf->num_dynsyms);
+		if (resolve_sym_idx(elf, n, name, val, weak_ok))
+			return TEE_SUCCESS;
+	}
 
-		for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
-			if (n >= nchains || n >= elf->num_dynsyms)
-				err(TEE_ERROR_BAD_FORMAT,
-				    "Index out of range");
-			/*
-			 * We're loading values from sym[] which later
-			 * will be used to load something.
-			 * => Spectre V1 pattern, need to cap the index
-			 * against speculation.
-			 */
-			n = confine_array_index(n, elf->num_dynsyms);
-			if (__resolve_sym(elf,
-					  ELF32_ST_BIND(sym[n].st_info),
-					  ELF32_ST_TYPE(sym[n].st_info),
-					  sym[n].st_shndx,
-					  sym[n].st_name,
-					  sym[n].st_value, name, val, weak_ok))
-				return TEE_SUCCESS;
-		}
-	} else {
-		Elf64_Sym *sym = elf->dynsymtab;
+	return TEE_ERROR_ITEM_NOT_FOUND;
+}
 
-		for (n = bucket[hash % nbuckets]; n; n = chain[n]) {
-			if (n >= nchains || n >= elf->num_dynsyms)
-				err(TEE_ERROR_BAD_FORMAT,
-				    "Index out of range");
-			/*
-			 * We're loading values from sym[] which later
-			 * will be used to load something.
-			 * => Spectre V1 pattern, need to cap the index
-			 * against speculation.
-			 */
-			n = confine_array_index(n, elf->num_dynsyms);
-			if (__resolve_sym(elf,
-					  ELF64_ST_BIND(sym[n].st_info),
-					  ELF64_ST_TYPE(sym[n].st_info),
-					  sym[n].st_shndx,
-					  sym[n].st_name,
-					  sym[n].st_value, name, val, weak_ok))
-				return TEE_SUCCESS;
-		}
+static TEE_Result resolve_sym_gnu(uint32_t hash, const char *name,
+				  vaddr_t *val, struct ta_elf *elf,
+				  bool weak_ok)
+{
+	/* Layout checked by check_gnu_hashtab() */
+	uint32_t *hashtab = elf->gnu_hashtab;
+	uint32_t nbuckets = hashtab[0];
+	uint32_t symoffs = hashtab[1];
+	uint32_t bloom_size = hashtab[2];
+	uint32_t bloom_shift = hashtab[3];
+	uint32_t *bucket = NULL;
+	uint32_t *chain = NULL;
+	uint32_t h = 0;
+	size_t n = 0;
+
+	/* Reject most missing symbols with the Bloom filter */
+	if (elf->is_32bit) {
+		uint32_t *bloom = hashtab + 4;
+		uint32_t word = bloom[(hash / 32) % bloom_size];
+		uint32_t mask = BIT32(hash % 32) |
+				BIT32((hash >> bloom_shift) % 32);
+
+		if ((word & mask) != mask)
+			return TEE_ERROR_ITEM_NOT_FOUND;
+		bucket = bloom + bloom_size;
+	} else {
+		uint64_t *bloom = (uint64_t *)(hashtab + 4);
+		uint64_t word = bloom[(hash / 64) % bloom_size];
+		uint64_t mask = BIT64(hash % 64) |
+				BIT64((hash >> bloom_shift) % 64);
+
+		if ((word & mask) != mask)
+			return TEE_ERROR_ITEM_NOT_FOUND;
+		bucket = (uint32_t *)(bloom + bloom_size);
 	}
+	chain = bucket + nbuckets;
+
+	n = bucket[hash % nbuckets];
+	if (!n)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	/* The lowest bit of a chain entry marks the end of the chain */
+	do {
+		if (n < symoffs || n >= elf->num_dynsyms)
+			err(TEE_ERROR_BAD_FORMAT, "Index out of range");
+		/* Spectre V1, see comment in resolve_sym_sysv() */
+		n = confine_array_index(n, elf->num_dynsyms);
+		h = chain[n - symoffs];
+		if ((h | 1) == (hash | 1) &&
+		    resolve_sym_idx(elf, n, name, val, weak_ok))
+			return TEE_SUCCESS;
+		n++;
+	} while (!(h & 1));
 
 	return TEE_ERROR_ITEM_NOT_FOUND;
 }
 
+struct sym_hashes {
+	uint32_t sysv;
+	uint32_t gnu;
+};
+
+static TEE_Result resolve_sym_helper(const struct sym_hashes *hashes,
+				     const char *name, vaddr_t *val,
+				     struct ta_elf *elf, bool weak_ok)
+{
+	if (elf->gnu_hashtab)
+		return resolve_sym_gnu(hashes->gnu, name, val, elf, weak_ok);
+	return resolve_sym_sysv(hashes->sysv, name, val, elf, weak_ok);
+}
+
 /*
  * Look for named symbol in @elf, or all modules if @elf == NULL. Global symbols
  * are searched first, then weak ones. Last option, when at least one weak but
@@ -154,24 +242,27 @@ TEE_Result ta_elf_resolve_sym(const char *name, vaddr_t *val,
 			      struct ta_elf **found_elf,
 			      struct ta_elf *elf)
 {
-	uint32_t hash = elf_hash(name);
+	struct sym_hashes hashes = {
+		.sysv = elf_hash(name),
+		.gnu = gnu_hash(name),
+	};
 
 	if (elf) {
 		/* Search global symbols */
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hashes, name, val, elf,
 					false /* !weak_ok */))
 			goto success;
 		/* Search weak symbols */
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hashes, name, val, elf,
 					true /* weak_ok */))
 			goto success;
 	}
 
 	TAILQ_FOREACH(elf, &main_elf_queue, link) {
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hashes, name, val, elf,
 					false /* !weak_ok */))
 			goto success;
-		if (!resolve_sym_helper(hash, name, val, elf,
+		if (!resolve_sym_helper(&hashes, name, val, elf,
 					true /* weak_ok */))
 			goto success;
 	}
@@ -202,12 +293,46 @@ static void e32_get_sym_name(const Elf32_Sym *sym_tab, size_t num_syms,
 	*name = str_tab + name_idx;
 }
 
+void ta_elf_get_reloc_stats(size_t *relocs, size_t *lookups,
+			    size_t *cache_hits)
+{
+	*relocs = num_relocs;
+	*lookups = sym_lookups;
+	*cache_hits = sym_cache_hits;
+}
+
+/*
+ * @name points into the string table of the module being relocated, which
+ * stays mapped as long as the module, so it can be kept in sym_cache[].
+ */
 static void resolve_sym(const char *name, vaddr_t *val, struct ta_elf **mod)
 {
-	TEE_Result res = ta_elf_resolve_sym(name, val, mod, NULL);
+	uint32_t hash = gnu_hash(name);
+	struct sym_cache_entry *ce = sym_cache + hash % SYM_CACHE_SIZE;
+	struct ta_elf *found_elf = NULL;
+	TEE_Result res = TEE_SUCCESS;
+	vaddr_t v = 0;
+
+	sym_lookups++;
+	if (ce->name && ce->hash == hash &&
+	    (ce->name == name || !strcmp(ce->name, name))) {
+		sym_cache_hits++;
+		found_elf = ce->elf;
+		v = ce->val;
+	} else {
+		res = ta_elf_resolve_sym(name, &v, &found_elf, NULL);
+		if (res)
+			err(res, "Symbol %s not found", name);
+		ce->name = name;
+		ce->elf = found_elf;
+		ce->val = v;
+		ce->hash = hash;
+	}
 
-	if (res)
-		err(res, "Symbol %s not found", name);
+	if (val)
+		*val = v;
+	if (mod)
+		*mod = found_elf;
 }
 
 static void e32_process_dyn_rel(const Elf32_Sym *sym_tab, size_t num_syms,
@@ -321,6 +446,7 @@ static void e32_relocate(struct ta_elf *elf, unsigned int rel_sidx)
 	rel = (Elf32_Rel *)(elf->load_addr + shdr[rel_sidx].sh_addr);
 
 	rel_end = rel + shdr[rel_sidx].sh_size / sizeof(Elf32_Rel);
+	num_relocs += rel_end - rel;
 	for (; rel < rel_end; rel++) {
 		struct ta_elf *mod = NULL;
 		Elf32_Addr *where = NULL;
@@ -549,6 +675,7 @@ static void e64_relocate(struct ta_elf *elf, unsigned int rel_sidx)
 	rela = (Elf64_Rela *)(elf->load_addr + shdr[rel_sidx].sh_addr);
 
 	rela_end = rela + shdr[rel_sidx].sh_size / sizeof(Elf64_Rela);
+	num_relocs += rela_end - rela;
 	for (; rela < rela_end; rela++) {
 		Elf64_Addr *where = NULL;
 		size_t sym_idx = 0;
@@ -615,6 +742,146 @@ static void __noreturn e64_relocate(struct ta_elf *elf __unused,
 }
 #endif /*ARM64*/
 
+/*
+ * Checks the address of a SHT_RELR section and returns the number of
+ * entries of @entsize bytes
+ */
+static size_t relr_get_num_ents(struct ta_elf *elf, size_t sh_addr,
+				size_t sh_size, size_t sh_entsize,
+				size_t entsize)
+{
+	size_t sh_end = 0;
+
+	if (sh_entsize != entsize)
+		err(TEE_ERROR_BAD_FORMAT, "Bad .relr.dyn/RELR entry size");
+
+	/* Check the address is inside TA memory */
+	if (ADD_OVERFLOW(sh_addr, sh_size, &sh_end))
+		err(TEE_ERROR_BAD_FORMAT, "Overflow");
+	if (sh_end >= (elf->max_addr - elf->load_addr))
+		err(TEE_ERROR_BAD_FORMAT, ".relr.dyn/RELR out of range");
+
+	return sh_size / entsize;
+}
+
+/*
+ * Applies SHT_RELR relative relocations. Each entry is either an even
+ * address of a word to relocate, or an odd bitmap where bit n (n > 0) set
+ * means that the word n - 1 words after the current position must be
+ * relocated. The current position is just after the last address, and
+ * advances by (bits per word - 1) words after each bitmap.
+ *
+ * A relative relocation adds the load address to the word in place, for
+ * REL as well as RELA based architectures.
+ */
+static void e32_relr_relocate(struct ta_elf *elf, unsigned int rel_sidx)
+{
+	Elf32_Shdr *shdr = elf->shdr;
+	size_t max_offs = elf->max_addr - elf->load_addr;
+	const size_t wsz = sizeof(Elf32_Addr);
+	Elf32_Word *relr = NULL;
+	Elf32_Word *relr_end = NULL;
+	Elf32_Addr *where = NULL;
+	size_t offs = 0;
+	size_t n = 0;
+
+	assert(shdr[rel_sidx].sh_type == SHT_RELR);
+
+	n = relr_get_num_ents(elf, shdr[rel_sidx].sh_addr,
+			      shdr[rel_sidx].sh_size,
+			      shdr[rel_sidx].sh_entsize, sizeof(Elf32_Word));
+	relr = (Elf32_Word *)(elf->load_addr + shdr[rel_sidx].sh_addr);
+	relr_end = relr + n;
+
+	for (; relr < relr_end; relr++) {
+		Elf32_Word ent = *relr;
+
+		if (!(ent & 1)) {
+			offs = ent;
+			/* Check the address is inside TA memory */
+			if (offs >= max_offs)
+				err(TEE_ERROR_BAD_FORMAT,
+				    "Relocation offset out of range");
+			where = (Elf32_Addr *)(elf->load_addr + offs);
+			*where += elf->load_addr;
+			num_relocs++;
+			offs += wsz;
+			continue;
+		}
+
+		for (n = 0, ent >>= 1; ent; n++, ent >>= 1) {
+			if (!(ent & 1))
+				continue;
+			if (offs >= max_offs || n * wsz >= max_offs - offs)
+				err(TEE_ERROR_BAD_FORMAT,
+				    "Relocation offset out of range");
+			where = (Elf32_Addr *)(elf->load_addr + offs + n * wsz);
+			*where += elf->load_addr;
+			num_relocs++;
+		}
+		if (ADD_OVERFLOW(offs, (sizeof(ent) * 8 - 1) * wsz, &offs))
+			err(TEE_ERROR_BAD_FORMAT, "Overflow");
+	}
+}
+
+#ifdef ARM64
+static void e64_relr_relocate(struct ta_elf *elf, unsigned int rel_sidx)
+{
+	Elf64_Shdr *shdr = elf->shdr;
+	size_t max_offs = elf->max_addr - elf->load_addr;
+	const size_t wsz = sizeof(Elf64_Addr);
+	Elf64_Xword *relr = NULL;
+	Elf64_Xword *relr_end = NULL;
+	Elf64_Addr *where = NULL;
+	size_t offs = 0;
+	size_t n = 0;
+
+	assert(shdr[rel_sidx].sh_type == SHT_RELR);
+
+	n = relr_get_num_ents(elf, shdr[rel_sidx].sh_addr,
+			      shdr[rel_sidx].sh_size,
+			      shdr[rel_sidx].sh_entsize, sizeof(Elf64_Xword));
+	relr = (Elf64_Xword *)(elf->load_addr + shdr[rel_sidx].sh_addr);
+	relr_end = relr + n;
+
+	for (; relr < relr_end; relr++) {
+		Elf64_Xword ent = *relr;
+
+		if (!(ent & 1)) {
+			offs = ent;
+			/* Check the address is inside TA memory */
+			if (offs >= max_offs)
+				err(TEE_ERROR_BAD_FORMAT,
+				    "Relocation offset out of range");
+			where = (Elf64_Addr *)(elf->load_addr + offs);
+			*where += elf->load_addr;
+			num_relocs++;
+			offs += wsz;
+			continue;
+		}
+
+		for (n = 0, ent >>= 1; ent; n++, ent >>= 1) {
+			if (!(ent & 1))
+				continue;
+			if (offs >= max_offs || n * wsz >= max_offs - offs)
+				err(TEE_ERROR_BAD_FORMAT,
+				    "Relocation offset out of range");
+			where = (Elf64_Addr *)(elf->load_addr + offs + n * wsz);
+			*where += elf->load_addr;
+			num_relocs++;
+		}
+		if (ADD_OVERFLOW(offs, (sizeof(ent) * 8 - 1) * wsz, &offs))
+			err(TEE_ERROR_BAD_FORMAT, "Overflow");
+	}
+}
+#else /*ARM64*/
+static void __noreturn e64_relr_relocate(struct ta_elf *elf __unused,
+					 unsigned int rel_sidx __unused)
+{
+	err(TEE_ERROR_NOT_SUPPORTED, "arm64 not supported");
+}
+#endif /*ARM64*/
+
 void ta_elf_relocate(struct ta_elf *elf)
 {
 	size_t n = 0;
@@ -622,15 +889,20 @@ void ta_elf_relocate(struct ta_elf *elf)
 	if (elf->is_32bit) {
 		Elf32_Shdr *shdr = elf->shdr;
 
-		for (n = 0; n < elf->e_shnum; n++)
+		for (n = 0; n < elf->e_shnum; n++) {
 			if (shdr[n].sh_type == SHT_REL)
 				e32_relocate(elf, n);
+			else if (shdr[n].sh_type == SHT_RELR)
+				e32_relr_relocate(elf, n);
+		}
 	} else {
 		Elf64_Shdr *shdr = elf->shdr;
 
-		for (n = 0; n < elf->e_shnum; n++)
+		for (n = 0; n < elf->e_shnum; n++) {
 			if (shdr[n].sh_type == SHT_RELA)
 				e64_relocate(elf, n);
-
+			else if (shdr[n].sh_type == SHT_RELR)
+				e64_relr_relocate(elf, n);
+		}
 	}
 }
@@ -6,6 +6,8 @@
 #ifndef __PTA_BENCHMARK_H
 #define __PTA_BENCHMARK_H
 
+#include <stdint.h>
+
 /*
  * Interface to the benchmark pseudo-TA, which is used for registering
  * timestamp buffers
@@ -23,4 +25,48 @@
 #define BENCHMARK_CMD_GET_MEMREF		BENCHMARK_CMD(2)
 #define BENCHMARK_CMD_UNREGISTER		BENCHMARK_CMD(3)
 
+/*
+ * Read latency statistics of standard calls collected by the core
+ *
+ * [out]    memref[0]: Array of struct benchmark_latency, one entry per
+ *                     command type and interval that has samples
+ * [out]    value[1].a: Number of entries
+ *
+ * Return codes:
+ * TEE_SUCCESS
+ * TEE_ERROR_SHORT_BUFFER - memref[0] too small, required size in
+ *                          memref[0].size
+ */
+#define BENCHMARK_CMD_GET_LATENCY		BENCHMARK_CMD(4)
+
+/* Clear the latency statistics, no parameters */
+#define BENCHMARK_CMD_RESET_LATENCY		BENCHMARK_CMD(5)
+
+/* Command types, benchmark_latency::cmd */
+#define BENCHMARK_LAT_CMD_OPEN_SESSION		0
+#define BENCHMARK_LAT_CMD_INVOKE		1
+#define BENCHMARK_LAT_CMD_CLOSE_SESSION		2
+#define BENCHMARK_LAT_CMD_OTHER			3
+#define BENCHMARK_LAT_CMD_COUNT			4
+
+/* Intervals, benchmark_latency::interval */
+#define BENCHMARK_LAT_SMC_TO_THREAD	0 /* SMC entry to thread allocated */
+#define BENCHMARK_LAT_PARAM_IN		1 /* Thread allocated to params in */
+#define BENCHMARK_LAT_TA_ENTRY		2 /* Params in to TA entry */
+#define BENCHMARK_LAT_TA		3 /* In TA, RPCs excluded */
+#define BENCHMARK_LAT_RPC		4 /* Sum of RPCs */
+#define BENCHMARK_LAT_RETURN		5 /* TA return to SMC return */
+#define BENCHMARK_LAT_TOTAL		6 /* SMC entry to SMC return */
+#define BENCHMARK_LAT_COUNT		7
+
+struct benchmark_latency {
+	uint32_t cmd;		/* BENCHMARK_LAT_CMD_* */
+	uint32_t interval;	/* BENCHMARK_LAT_* */
+	uint64_t count;		/* Number of samples */
+	uint64_t min_ns;
+	uint64_t p50_ns;	/* Median, histogram resolution */
+	uint64_t p99_ns;	/* 99th percentile, histogram resolution */
+	uint64_t max_ns;
+};
+
 #endif /* __PTA_BENCHMARK_H */
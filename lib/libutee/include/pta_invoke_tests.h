@@ -6,6 +6,8 @@
 #ifndef __PTA_INVOKE_TESTS_H
 #define __PTA_INVOKE_TESTS_H
 
+#include <stdint.h>
+
 #define PTA_INVOKE_TESTS_UUID \
 		{ 0xd96a5b40, 0xc3e5, 0x21e3, \
 			{ 0x87, 0x94, 0x10, 0x02, 0xa5, 0xd5, 0xc6, 0x1b } }
@@ -103,5 +105,73 @@
  */
 #define PTA_INVOKE_TESTS_CMD_MEMREF_NULL	10
 
+/*
+ * Secure storage hash tree commit latency
+ *
+ * [in]     value[0].a	number of blocks in the file, at most 256
+ * [in]     value[0].b	number of blocks modified before each commit
+ * [in]     value[1].a	repetition count
+ * [out]    value[2].a	average commit time in microseconds
+ * [out]    value[2].b	average number of storage writes per commit
+ */
+#define PTA_INVOKE_TESTS_CMD_FS_HTREE_COMMIT_PERF	11
+
+/*
+ * Secure storage benchmark, the operation is done once on each of a set
+ * of persistent objects created for the purpose and removed afterwards.
+ * Objects are accessed directly through the storage backend, the
+ * syscall layer isn't included in the figures.
+ *
+ * Crypto time is the time to encrypt and authenticate the data of one
+ * object with the algorithms of the backend, measured separately.
+ *
+ * RPMB figures can be taken against a real device or against the RPMB
+ * emulation in tee-supplicant (RPMB_EMU=1).
+ *
+ * PTA_INVOKE_TESTS_STORAGE_TRUNCATE_ABORT truncates each object in a
+ * transaction which is then aborted, and fails unless the object data
+ * reads back unchanged. It needs a backend supporting transactions.
+ *
+ * [in]     value[0].a	storage ID, TEE_STORAGE_PRIVATE_REE or
+ *			TEE_STORAGE_PRIVATE_RPMB
+ * [in]     value[0].b	PTA_INVOKE_TESTS_STORAGE_*
+ * [in]     value[1].a	object data size in bytes, at most 64 KiB
+ * [in]     value[1].b	number of objects, at most 128
+ * [out]    memref[2]	struct pta_invoke_tests_storage_perf
+ */
+#define PTA_INVOKE_TESTS_CMD_STORAGE_PERF	12
+
+#define PTA_INVOKE_TESTS_STORAGE_CREATE		0
+#define PTA_INVOKE_TESTS_STORAGE_OPEN		1
+#define PTA_INVOKE_TESTS_STORAGE_READ		2
+#define PTA_INVOKE_TESTS_STORAGE_WRITE		3
+#define PTA_INVOKE_TESTS_STORAGE_TRUNCATE	4
+#define PTA_INVOKE_TESTS_STORAGE_RENAME		5
+#define PTA_INVOKE_TESTS_STORAGE_DELETE		6
+#define PTA_INVOKE_TESTS_STORAGE_ENUMERATE	7
+#define PTA_INVOKE_TESTS_STORAGE_TRUNCATE_ABORT	8
+
+/*
+ * struct pta_invoke_tests_storage_perf - secure storage benchmark result
+ * @min_us:	fastest operation in microseconds
+ * @p50_us:	median operation time in microseconds
+ * @p90_us:	90th percentile operation time in microseconds
+ * @p99_us:	99th percentile operation time in microseconds
+ * @max_us:	slowest operation in microseconds
+ * @avg_us:	average operation time in microseconds
+ * @rpcs:	total number of storage RPCs of all operations
+ * @crypto_us:	crypto time of the data of one object in microseconds
+ */
+struct pta_invoke_tests_storage_perf {
+	uint32_t min_us;
+	uint32_t p50_us;
+	uint32_t p90_us;
+	uint32_t p99_us;
+	uint32_t max_us;
+	uint32_t avg_us;
+	uint32_t rpcs;
+	uint32_t crypto_us;
+};
+
 #endif /*__PTA_INVOKE_TESTS_H*/
 
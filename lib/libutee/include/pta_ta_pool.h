@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+/*
+ * Warm pool of pre-instantiated TAs
+ *
+ * The TAs listed in CFG_TA_POOL_UUIDS are loaded ahead of their first
+ * client: early TAs at boot, the others when PTA_TA_POOL_CMD_FILL is
+ * invoked, typically once tee-supplicant is running. Only single instance,
+ * keep alive TAs stay loaded once the pool session is closed, so that the
+ * first client session finds an initialized context.
+ */
+
+#ifndef __PTA_TA_POOL_H
+#define __PTA_TA_POOL_H
+
+#include <stdint.h>
+
+#define PTA_TA_POOL_UUID { 0x4a6f2ba1, 0x8d37, 0x4c6e, \
+		{ 0x9b, 0x2a, 0x61, 0x0e, 0xc5, 0x47, 0xd3, 0x18 } }
+
+/* Entry not loaded yet */
+#define PTA_TA_POOL_STATE_EMPTY		0
+/* TA context is loaded and initialized */
+#define PTA_TA_POOL_STATE_READY		1
+/* Loading the TA failed, see @result */
+#define PTA_TA_POOL_STATE_FAILED	2
+/* TA is not single instance and keep alive, it cannot be pooled */
+#define PTA_TA_POOL_STATE_SKIPPED	3
+/* TA context was loaded but has since been destroyed (e.g. panic) */
+#define PTA_TA_POOL_STATE_EVICTED	4
+
+/*
+ * struct pta_ta_pool_entry - status of a pool entry
+ * @uuid:	UUID of the TA, as octets
+ * @state:	One of PTA_TA_POOL_STATE_*
+ * @result:	TEE_Result of the last load attempt
+ * @load_time_us: Time spent loading and initializing the TA
+ * @reserved:	Must be 0
+ */
+struct pta_ta_pool_entry {
+	uint8_t uuid[16];
+	uint32_t state;
+	uint32_t result;
+	uint32_t load_time_us;
+	uint32_t reserved;
+};
+
+/*
+ * Get the status of the pool
+ *
+ * [out]    memref[0]: Array of struct pta_ta_pool_entry
+ * [out]    value[1].a: Number of entries in the pool
+ *
+ * Return codes:
+ * TEE_SUCCESS - Invoke command success
+ * TEE_ERROR_BAD_PARAMETERS - Incorrect input param
+ * TEE_ERROR_SHORT_BUFFER - Output buffer size less than required
+ */
+#define PTA_TA_POOL_CMD_GET_STATUS	0
+
+/*
+ * Load the pool entries which are not ready yet
+ *
+ * Needs tee-supplicant for TAs which are not early TAs.
+ *
+ * [out]    value[0].a: Number of ready entries
+ * [out]    value[0].b: Number of entries which could not be loaded
+ *
+ * Return codes:
+ * TEE_SUCCESS - Invoke command success
+ * TEE_ERROR_BAD_PARAMETERS - Incorrect input param
+ */
+#define PTA_TA_POOL_CMD_FILL		1
+
+#endif /* __PTA_TA_POOL_H */
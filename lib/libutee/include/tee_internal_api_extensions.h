@@ -78,4 +78,66 @@ TEE_Result tee_invoke_supp_plugin(const TEE_UUID *uuid, uint32_t cmd,
 				  uint32_t sub_cmd, void *buf, size_t len,
 				  size_t *outlen);
 
+/*
+ * TEE_GetNextPersistentObjectIDs() - get the IDs of the next objects of an
+ *				      enumerator
+ * @objectEnumerator:	started enumerator
+ * @objectIDs:		buffer of *count IDs, TEE_OBJECT_ID_MAX_LEN bytes each
+ * @objectIDLens:	length of each ID returned in @objectIDs
+ * @count:		number of IDs to get [in], number of IDs returned [out]
+ *
+ * Unlike TEE_GetNextPersistentObject() the objects aren't opened, which
+ * makes listing the objects of a TA considerably cheaper.
+ *
+ * Returns TEE_SUCCESS if at least one ID was returned,
+ * TEE_ERROR_ITEM_NOT_FOUND if there are no more objects or another
+ * TEE_ERROR_* on failure.
+ */
+TEE_Result TEE_GetNextPersistentObjectIDs(TEE_ObjectEnumHandle objectEnumerator,
+					  void *objectIDs,
+					  uint32_t *objectIDLens,
+					  uint32_t *count);
+
+/*
+ * Persistent object transactions
+ *
+ * TEE_BeginPersistentObjectTransaction() Starts a transaction, from then
+ *		on the changes done with TEE_WriteObjectData() and
+ *		TEE_TruncateObjectData() aren't stored until the transaction
+ *		is committed. Panics if a transaction is already started.
+ *
+ * TEE_CommitPersistentObjectTransaction() Stores the changes of the
+ *		transaction, the changes to all the objects in the same
+ *		storage are stored atomically. The changes are discarded
+ *		and the transaction ended if TEE_SUCCESS isn't returned,
+ *		except on TEE_ERROR_OUT_OF_MEMORY which is only returned
+ *		before anything is stored, the transaction is then kept to
+ *		be committed again or aborted.
+ *
+ * TEE_AbortPersistentObjectTransaction() Discards the changes of the
+ *		transaction.
+ *
+ * Closing an object discards its changes in the current transaction.
+ * Other operations such as creating, renaming or deleting objects aren't
+ * part of the transaction. Storages without transaction support, such as
+ * TEE_STORAGE_PRIVATE_RPMB, store the changes right away.
+ */
+void TEE_BeginPersistentObjectTransaction(void);
+TEE_Result TEE_CommitPersistentObjectTransaction(void);
+void TEE_AbortPersistentObjectTransaction(void);
+
+/*
+ * TEE_SyncObjectData() - store the data written to an object
+ * @object:	handle of an opened persistent object
+ *
+ * With CFG_REE_FS_WRITE_BEHIND, data written with TEE_WriteObjectData()
+ * to an object in TEE_STORAGE_PRIVATE_REE may be held back until a
+ * threshold is reached or the object is closed. This function stores such
+ * data, it does nothing for storages storing the data right away or for
+ * an object with changes in a transaction.
+ *
+ * Returns TEE_SUCCESS or TEE_ERROR_* on failure.
+ */
+TEE_Result TEE_SyncObjectData(TEE_ObjectHandle object);
+
 #endif
@@ -70,6 +70,47 @@ struct ftrace_buf {
 	uint32_t buf_off;	/* Ftrace buffer offset */
 	bool syscall_trace_enabled; /* Some syscalls are never traced */
 	bool syscall_trace_suspended; /* By foreign interrupt or RPC */
+	uint64_t last_time;	/* Timestamp of the last binary record */
+	uint32_t rec_off;	/* Offset of the next binary record */
+	uint32_t cntfrq;	/* Counter frequency for binary records */
+};
+
+/*
+ * Binary function trace (CFG_FTRACE_BINARY)
+ *
+ * Instead of formatting text, ftrace_enter() and ftrace_return() append
+ * one fixed size record per event to a ring buffer located at
+ * ftrace_buf::buf_off. When the ring is full the oldest records are
+ * overwritten. The timestamp of each record is stored as a delta with
+ * the previous record, the absolute time of the newest record being
+ * ftrace_buf::last_time. When dumped, the ring is preceded by a struct
+ * ftrace_bin_hdr and unrolled so that records appear oldest first.
+ * scripts/ftrace_decode.py turns such a dump into the usual text
+ * function graph or into Chrome trace JSON.
+ */
+#define FTRACE_BIN_MAGIC		0x43525446 /* "FTRC" */
+#define FTRACE_BIN_VERSION		1
+#define FTRACE_BIN_FLAG_32BIT		BIT(0)
+
+#define FTRACE_REC_ENTER		0
+#define FTRACE_REC_RETURN		1
+
+struct ftrace_rec {
+	uint64_t pc;		/* Function address, 0 for returns */
+	uint32_t delta;		/* Ticks since previous record (saturated) */
+	uint16_t depth;		/* Call depth */
+	uint16_t type;		/* FTRACE_REC_* */
+};
+
+struct ftrace_bin_hdr {
+	uint32_t magic;		/* FTRACE_BIN_MAGIC */
+	uint16_t version;	/* FTRACE_BIN_VERSION */
+	uint16_t rec_size;	/* sizeof(struct ftrace_rec) */
+	uint32_t flags;		/* FTRACE_BIN_FLAG_* */
+	uint32_t cntfrq;	/* Counter frequency */
+	uint32_t num_recs;	/* Number of records following the header */
+	uint32_t pad;
+	uint64_t last_time;	/* Timestamp of the last record */
 };
 
 /* Defined by the linker script */
@@ -201,6 +201,18 @@ TEE_Result _utee_storage_start_enum(unsigned long obj_enum,
 TEE_Result _utee_storage_next_enum(unsigned long obj_enum, TEE_ObjectInfo *info,
 				   void *obj_id, uint64_t *len);
 
+/*
+ * obj_enum is of type TEE_ObjectEnumHandle
+ * obj_ids holds *count IDs of TEE_OBJECT_ID_MAX_LEN bytes each, the length
+ * of each ID is returned in obj_id_lens. *count is updated with the
+ * number of IDs returned.
+ */
+TEE_Result _utee_storage_next_enum_ids(unsigned long obj_enum, void *obj_ids,
+				       uint32_t *obj_id_lens, uint64_t *count);
+
+/* op is of type enum utee_storage_trans_operation */
+TEE_Result _utee_storage_transaction(unsigned long op);
+
 /* Data Stream Access Functions */
 /* obj is of type TEE_ObjectHandle */
 TEE_Result _utee_storage_obj_read(unsigned long obj, void *data, size_t len,
@@ -218,6 +230,9 @@ TEE_Result _utee_storage_obj_trunc(unsigned long obj, size_t len);
 TEE_Result _utee_storage_obj_seek(unsigned long obj, int32_t offset,
 				  unsigned long whence);
 
+/* obj is of type TEE_ObjectHandle */
+TEE_Result _utee_storage_obj_sync(unsigned long obj);
+
 /* seServiceHandle is of type TEE_SEServiceHandle */
 TEE_Result _utee_se_service_open(uint32_t *seServiceHandle);
 
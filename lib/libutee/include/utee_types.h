@@ -32,6 +32,13 @@ enum utee_cache_operation {
 	TEE_CACHEINVALIDATE,
 };
 
+/* Operations of the storage transaction syscall */
+enum utee_storage_trans_operation {
+	UTEE_STORAGE_TRANS_BEGIN = 0,
+	UTEE_STORAGE_TRANS_COMMIT,
+	UTEE_STORAGE_TRANS_ABORT,
+};
+
 struct utee_params {
 	uint64_t types;
 	/* vals[n * 2]	   corresponds to either value.a or memref.buffer
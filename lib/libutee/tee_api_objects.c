@@ -630,6 +630,64 @@ out:
 	return res;
 }
 
+TEE_Result TEE_GetNextPersistentObjectIDs(TEE_ObjectEnumHandle objectEnumerator,
+					  void *objectIDs,
+					  uint32_t *objectIDLens,
+					  uint32_t *count)
+{
+	TEE_Result res = TEE_SUCCESS;
+	uint64_t cnt = 0;
+
+	__utee_check_out_annotation(count, sizeof(*count));
+
+	if (!objectIDs || !objectIDLens || !*count) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto out;
+	}
+
+	cnt = *count;
+	res = _utee_storage_next_enum_ids((unsigned long)objectEnumerator,
+					  objectIDs, objectIDLens, &cnt);
+	if (res == TEE_SUCCESS)
+		*count = cnt;
+	else
+		*count = 0;
+
+out:
+	if (res != TEE_SUCCESS &&
+	    res != TEE_ERROR_ITEM_NOT_FOUND &&
+	    res != TEE_ERROR_STORAGE_NOT_AVAILABLE)
+		TEE_Panic(res);
+
+	return res;
+}
+
+void TEE_BeginPersistentObjectTransaction(void)
+{
+	TEE_Result res = _utee_storage_transaction(UTEE_STORAGE_TRANS_BEGIN);
+
+	if (res != TEE_SUCCESS)
+		TEE_Panic(res);
+}
+
+TEE_Result TEE_CommitPersistentObjectTransaction(void)
+{
+	TEE_Result res = _utee_storage_transaction(UTEE_STORAGE_TRANS_COMMIT);
+
+	if (res == TEE_ERROR_BAD_STATE)
+		TEE_Panic(res);
+
+	return res;
+}
+
+void TEE_AbortPersistentObjectTransaction(void)
+{
+	TEE_Result res = _utee_storage_transaction(UTEE_STORAGE_TRANS_ABORT);
+
+	if (res != TEE_SUCCESS)
+		TEE_Panic(res);
+}
+
 /* Data and Key Storage API  - Data Stream Access Functions */
 
 TEE_Result TEE_ReadObjectData(TEE_ObjectHandle object, void *buffer,
@@ -707,6 +765,27 @@ out:
 	return res;
 }
 
+TEE_Result TEE_SyncObjectData(TEE_ObjectHandle object)
+{
+	TEE_Result res = TEE_SUCCESS;
+
+	if (object == TEE_HANDLE_NULL) {
+		res = TEE_ERROR_BAD_PARAMETERS;
+		goto out;
+	}
+
+	res = _utee_storage_obj_sync((unsigned long)object);
+
+out:
+	if (res != TEE_SUCCESS &&
+	    res != TEE_ERROR_STORAGE_NOT_AVAILABLE &&
+	    res != TEE_ERROR_STORAGE_NO_SPACE &&
+	    res != TEE_ERROR_CORRUPT_OBJECT)
+		TEE_Panic(res);
+
+	return res;
+}
+
 TEE_Result TEE_SeekObjectData(TEE_ObjectHandle object, int32_t offset,
 			      TEE_Whence whence)
 {
@@ -27,8 +27,6 @@
 
 #define DURATION_MAX_LEN		16
 
-static const char hex_str[] = "0123456789abcdef";
-
 static __noprof struct ftrace_buf *get_fbuf(void)
 {
 #if defined(__KERNEL__)
@@ -59,6 +57,58 @@ static __noprof struct ftrace_buf *get_fbuf(void)
 #endif
 }
 
+#if defined(CFG_FTRACE_BINARY)
+
+/*
+ * Appends one record to the ring buffer, overwriting the oldest record
+ * when the ring is full. No formatting is done here, the dump is decoded
+ * on the host by scripts/ftrace_decode.py.
+ */
+static void __noprof fbuf_add_rec(struct ftrace_buf *fbuf, unsigned long pc,
+				  uint16_t type)
+{
+	uint64_t now = barrier_read_counter_timer();
+	struct ftrace_rec *rec = NULL;
+	uint64_t delta = 0;
+
+	if (!fbuf->last_time)
+		fbuf->cntfrq = read_cntfrq();
+	else if (now > fbuf->last_time)
+		delta = now - fbuf->last_time;
+	fbuf->last_time = now;
+
+	if (fbuf->rec_off + sizeof(*rec) > fbuf->max_size)
+		fbuf->rec_off = 0;
+
+	rec = (struct ftrace_rec *)((char *)fbuf + fbuf->buf_off +
+				    fbuf->rec_off);
+	rec->pc = pc;
+	if (delta > UINT32_MAX)
+		rec->delta = UINT32_MAX;
+	else
+		rec->delta = delta;
+	rec->depth = fbuf->ret_idx;
+	rec->type = type;
+
+	fbuf->rec_off += sizeof(*rec);
+	if (fbuf->curr_size < fbuf->rec_off)
+		fbuf->curr_size = fbuf->rec_off;
+}
+
+static void __noprof fbuf_log_enter(struct ftrace_buf *fbuf, unsigned long pc)
+{
+	fbuf_add_rec(fbuf, pc, FTRACE_REC_ENTER);
+}
+
+static void __noprof fbuf_log_return(struct ftrace_buf *fbuf)
+{
+	fbuf_add_rec(fbuf, 0, FTRACE_REC_RETURN);
+}
+
+#else /*!CFG_FTRACE_BINARY*/
+
+static const char hex_str[] = "0123456789abcdef";
+
 #if defined(_CFG_FTRACE_BUF_WHEN_FULL_shift)
 
 /*
@@ -134,17 +184,11 @@ static size_t __noprof to_func_enter_fmt(char *buf, uint32_t ret_idx,
 	return str - buf;
 }
 
-void __noprof ftrace_enter(unsigned long pc, unsigned long *lr)
+static void __noprof fbuf_log_enter(struct ftrace_buf *fbuf, unsigned long pc)
 {
-	struct ftrace_buf *fbuf = NULL;
 	size_t dump_size = 0;
 	bool full = false;
 
-	fbuf = get_fbuf();
-
-	if (!fbuf || !fbuf->buf_off || !fbuf->max_size)
-		return;
-
 	dump_size = DURATION_MAX_LEN + fbuf->ret_idx +
 			(2 * sizeof(unsigned long)) + 8;
 
@@ -163,23 +207,8 @@ void __noprof ftrace_enter(unsigned long pc, unsigned long *lr)
 						     fbuf->ret_idx,
 						     pc);
 
-	if (fbuf->ret_idx < FTRACE_RETFUNC_DEPTH) {
-		fbuf->ret_stack[fbuf->ret_idx] = *lr;
+	if (fbuf->ret_idx < FTRACE_RETFUNC_DEPTH)
 		fbuf->begin_time[fbuf->ret_idx] = barrier_read_counter_timer();
-		fbuf->ret_idx++;
-	} else {
-		/*
-		 * This scenario isn't expected as function call depth
-		 * shouldn't be more than FTRACE_RETFUNC_DEPTH.
-		 */
-#if defined(__KERNEL__)
-		panic();
-#else
-		_utee_panic(0);
-#endif
-	}
-
-	*lr = (unsigned long)&__ftrace_return;
 }
 
 static void __noprof ftrace_duration(char *buf, uint64_t start, uint64_t end)
@@ -237,22 +266,13 @@ static void __noprof ftrace_duration(char *buf, uint64_t start, uint64_t end)
 	}
 }
 
-unsigned long __noprof ftrace_return(void)
+static void __noprof fbuf_log_return(struct ftrace_buf *fbuf)
 {
-	struct ftrace_buf *fbuf = NULL;
 	size_t dump_size = 0;
 	char *curr_buf = NULL;
 	char *dur_loc = NULL;
 	uint32_t i = 0;
 
-	fbuf = get_fbuf();
-
-	/* Check for valid return index */
-	if (fbuf && fbuf->ret_idx && fbuf->ret_idx <= FTRACE_RETFUNC_DEPTH)
-		fbuf->ret_idx--;
-	else
-		return 0;
-
 	curr_buf = (char *)fbuf + fbuf->buf_off + fbuf->curr_size;
 
 	/*
@@ -300,6 +320,52 @@ unsigned long __noprof ftrace_return(void)
 					barrier_read_counter_timer());
 		}
 	}
+}
+
+#endif /*!CFG_FTRACE_BINARY*/
+
+void __noprof ftrace_enter(unsigned long pc, unsigned long *lr)
+{
+	struct ftrace_buf *fbuf = NULL;
+
+	fbuf = get_fbuf();
+
+	if (!fbuf || !fbuf->buf_off || !fbuf->max_size)
+		return;
+
+	fbuf_log_enter(fbuf, pc);
+
+	if (fbuf->ret_idx < FTRACE_RETFUNC_DEPTH) {
+		fbuf->ret_stack[fbuf->ret_idx] = *lr;
+		fbuf->ret_idx++;
+	} else {
+		/*
+		 * This scenario isn't expected as function call depth
+		 * shouldn't be more than FTRACE_RETFUNC_DEPTH.
+		 */
+#if defined(__KERNEL__)
+		panic();
+#else
+		_utee_panic(0);
+#endif
+	}
+
+	*lr = (unsigned long)&__ftrace_return;
+}
+
+unsigned long __noprof ftrace_return(void)
+{
+	struct ftrace_buf *fbuf = NULL;
+
+	fbuf = get_fbuf();
+
+	/* Check for valid return index */
+	if (fbuf && fbuf->ret_idx && fbuf->ret_idx <= FTRACE_RETFUNC_DEPTH)
+		fbuf->ret_idx--;
+	else
+		return 0;
+
+	fbuf_log_return(fbuf);
 
 	return fbuf->ret_stack[fbuf->ret_idx];
 }
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (c) 2026, agent <agent@local>
+ */
+
+#ifndef FNV1A_H
+#define FNV1A_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Initial value of a FNV-1a hash */
+#define FNV1A_INIT	2166136261U
+
+/*
+ * fnv1a_hash() - hash a buffer with 32-bit FNV-1a
+ * @h:		FNV1A_INIT, or the hash returned for the preceding buffers
+ * @data:	buffer to hash
+ * @len:	size of @data
+ *
+ * Not a cryptographic hash, only meant to spread keys of hash tables.
+ */
+static inline uint32_t fnv1a_hash(uint32_t h, const void *data, size_t len)
+{
+	const uint8_t *d = data;
+	size_t n = 0;
+
+	for (n = 0; n < len; n++)
+		h = (h ^ d[n]) * 16777619;
+
+	return h;
+}
+
+#endif /*FNV1A_H*/
@@ -153,6 +153,50 @@ CFG_TEE_FW_MANUFACTURER ?= FW_MAN_UNDEF
 # TEE_STORAGE_PRIVATE is passed to the trusted storage API)
 CFG_REE_FS ?= y
 
+# Size of the data blocks of files created in the REE FS, as a power of two:
+# 12 for 4 KiB up to 16 for 64 KiB. Larger blocks mean fewer RPCs and
+# cryptographic operations for large objects, but a small update still
+# rewrites a whole block. The block size is recorded in each file so
+# existing files keep their 4 KiB blocks.
+CFG_REE_FS_BLOCK_SHIFT ?= 12
+
+# Cache of REE FS hash tree elements in secure memory
+#
+# Verified hash tree nodes and decrypted data blocks of files in the REE FS
+# are kept in a LRU cache, files read repeatedly are served without RPCs.
+# Updated data blocks are also kept in secure memory until the file is
+# committed. Statistics are reported by the stats pseudo TA.
+# CFG_REE_FS_BLOCK_CACHE_SIZE: maximum size in bytes of the cache, 16 data
+# blocks by default. It must hold at least two blocks of
+# CFG_REE_FS_BLOCK_SHIFT size.
+CFG_REE_FS_BLOCK_CACHE ?= n
+CFG_REE_FS_BLOCK_CACHE_SIZE ?= $(shell echo $$((16 << $(CFG_REE_FS_BLOCK_SHIFT))))
+$(eval $(call cfg-depends-all,CFG_REE_FS_BLOCK_CACHE,CFG_REE_FS))
+
+# Write-behind of REE FS objects
+#
+# Writes to an object are kept in the hash tree of the open object instead
+# of being committed one by one. They're committed when the object is
+# closed, when the TA calls TEE_SyncObjectData(), when the object is
+# truncated or once CFG_REE_FS_WRITE_BEHIND_SIZE bytes have been written.
+# Updated blocks are written to the unused version of each block as usual,
+# so a crash loses the writes not yet committed but nothing else.
+# Combine with CFG_REE_FS_BLOCK_CACHE to also keep updated blocks in secure
+# memory until committed.
+CFG_REE_FS_WRITE_BEHIND ?= n
+CFG_REE_FS_WRITE_BEHIND_SIZE ?= 16384
+$(eval $(call cfg-depends-all,CFG_REE_FS_WRITE_BEHIND,CFG_REE_FS))
+
+# Cache of persistent object heads in secure memory
+#
+# The head and attributes of persistent objects opened by TAs are kept in
+# a LRU cache, opening an object again only needs the storage to open and
+# authenticate the file, the head and attributes aren't read again.
+# Cached heads are removed when an object is created, renamed or deleted.
+# CFG_STORAGE_HEAD_CACHE_SIZE: maximum size in bytes of the cache
+CFG_STORAGE_HEAD_CACHE ?= n
+CFG_STORAGE_HEAD_CACHE_SIZE ?= 16384
+
 # RPMB file system support
 CFG_RPMB_FS ?= n
 
@@ -194,6 +238,26 @@ CFG_RPMB_FS_RD_ENTRIES ?= 8
 # in case the cache is too small to hold all elements when traversing.
 CFG_RPMB_FS_CACHE_ENTRIES ?= 0
 
+# Keeps the complete FAT of the RPMB FS in memory, indexed by file name.
+# The FAT is read once when first used, after that opening, creating,
+# removing and enumerating files need no RPMB reads for the FAT. Free
+# space is tracked as a list of extents updated as files change, data is
+# placed in the smallest free extent that fits.
+# Costs sizeof(struct rpmb_fat_entry) = 256 bytes of heap for each FAT
+# entry, CFG_RPMB_FS_CACHE_ENTRIES is ignored when enabled.
+CFG_RPMB_FS_FAT_INDEX ?= n
+
+# Number of RPMB data blocks kept decrypted in memory for writes which
+# don't cover whole blocks. Such writes only read back the first and last
+# block they touch, from this cache if they were recently written. Costs
+# about 330 bytes per entry, 0 disables the cache.
+CFG_RPMB_FS_BLOCK_CACHE_ENTRIES ?= 4
+
+# Write as many RPMB data frames in each request as the Reliable Write
+# Sector Count of the device allows, instead of one frame per request.
+# Requires a normal world RPMB driver which handles multi-frame writes.
+CFG_RPMB_WRITE_MULTIPLE_BLOCKS ?= n
+
 # Print RPMB data frames sent to and received from the RPMB device
 CFG_RPMB_FS_DEBUG_DATA ?= n
 
@@ -310,6 +374,31 @@ CFG_REE_FS_TA ?= y
 CFG_REE_FS_TA_BUFFERED ?= n
 $(eval $(call cfg-depends-all,CFG_REE_FS_TA_BUFFERED,CFG_REE_FS_TA))
 
+# Cache of verified REE FS TA images
+#
+# Requires CFG_REE_FS_TA_BUFFERED=y. When enabled, the TA buffers are kept in
+# a LRU cache in the "Secure DDR" pool once the image has been verified (and
+# decrypted). Subsequent loads of the same TA still fetch the image from
+# tee-supplicant, but skip signature verification, hashing and decryption
+# when the signed header is unchanged.
+# CFG_REE_FS_TA_CACHE_SIZE: maximum total size in bytes of cached images
+# CFG_REE_FS_TA_CACHE_ENTRIES: maximum number of cached images
+CFG_REE_FS_TA_CACHE ?= n
+CFG_REE_FS_TA_CACHE_SIZE ?= 1048576
+CFG_REE_FS_TA_CACHE_ENTRIES ?= 8
+$(eval $(call cfg-depends-all,CFG_REE_FS_TA_CACHE,CFG_REE_FS_TA_BUFFERED))
+
+# Support for zlib compressed REE FS TAs (SHDR_COMPRESSED_TA)
+#
+# Such TAs are produced with scripts/sign_encrypt.py --compress, or by
+# building the TA with CFG_COMPRESS_TA=y. They are decompressed while being
+# loaded, which reduces the amount of data transferred from the normal world.
+CFG_REE_FS_TA_COMPRESSED ?= n
+$(eval $(call cfg-depends-all,CFG_REE_FS_TA_COMPRESSED,CFG_REE_FS_TA))
+ifeq ($(CFG_REE_FS_TA_COMPRESSED),y)
+$(call force,CFG_ZLIB,y)
+endif
+
 # When CFG_REE_FS=y and CFG_RPMB_FS=y:
 # Allow secure storage in the REE FS to be entirely deleted without causing
 # anti-rollback errors. That is, rm /data/tee/dirf.db or rm -rf /data/tee (or
@@ -367,6 +456,29 @@ endif
 # not compress them with CFG_EARLY_TA_COMPRESS=n
 CFG_EARLY_TA_COMPRESS ?= y
 
+# Compress the early TAs and the secure partitions with LZ4 instead of
+# DEFLATE. LZ4 images are larger but decompress several times faster, which
+# shortens the load of the embedded TAs on slow cores. The decompression
+# time is reported in the log when an image is closed.
+CFG_EMBEDDED_TS_LZ4 ?= n
+$(eval $(call cfg-depends-all,CFG_EMBEDDED_TS_LZ4,CFG_EMBEDDED_TS))
+
+# Warm pool of pre-instantiated TAs
+#
+# CFG_TA_POOL_UUIDS is a space separated list of TA UUIDs which are loaded
+# ahead of their first client session so that it does not pay for the TA
+# load and TA_CreateEntryPoint(). Only TAs which are single instance and
+# keep alive (TA_FLAG_SINGLE_INSTANCE | TA_FLAG_INSTANCE_KEEP_ALIVE) can be
+# pooled. Early TAs are loaded during
+# the first standard call, other TAs need tee-supplicant and are loaded when
+# the normal world invokes the command PTA_TA_POOL_CMD_FILL of the pseudo TA
+# in lib/libutee/include/pta_ta_pool.h, which also reports the pool status.
+# Example:
+#   CFG_TA_POOL_UUIDS="8aaaf200-2450-11e4-abe2-0002a5d5c51b"
+CFG_TA_POOL ?= n
+CFG_TA_POOL_UUIDS ?=
+$(eval $(call cfg-depends-all,CFG_TA_POOL,CFG_WITH_USER_TA))
+
 # Enable paging, requires SRAM, can't be enabled by default
 CFG_WITH_PAGER ?= n
 
@@ -513,6 +625,17 @@ $(call force,_CFG_FTRACE_BUF_WHEN_FULL_$(CFG_FTRACE_BUF_WHEN_FULL),y)
 #     display it in milliseconds
 CFG_FTRACE_US_MS ?= 10000
 
+# Binary function tracing.
+# When enabled, function entries and returns are stored as fixed size binary
+# records (function address, timestamp delta, call depth) in a ring buffer
+# that overwrites the oldest records when full, instead of being formatted
+# as text at each call. This reduces the tracing overhead considerably. The
+# resulting /tmp/ftrace-<ta_uuid>.out is decoded on the host with
+# scripts/ftrace_decode.py, either into the usual text function graph or
+# into Chrome trace JSON. CFG_FTRACE_BUF_WHEN_FULL is ignored.
+CFG_FTRACE_BINARY ?= n
+$(call cfg-depends-all,CFG_FTRACE_BINARY,CFG_FTRACE_SUPPORT)
+
 # Core syscall function tracing.
 # When this option is enabled, OP-TEE core is instrumented with GCC's
 # -pg flag and will output syscall function graph in user TA ftrace
@@ -520,6 +643,21 @@ CFG_FTRACE_US_MS ?= 10000
 CFG_SYSCALL_FTRACE ?= n
 $(call cfg-depends-all,CFG_SYSCALL_FTRACE,CFG_FTRACE_SUPPORT)
 
+# Link TAs and TA shared libraries with -z pack-relative-relocs when the
+# linker supports it. Relative relocations are then stored in a compact
+# SHT_RELR table instead of one Elf32_Rel/Elf64_Rela entry each, which
+# makes the binaries smaller and faster to relocate by ldelf. ldelf
+# supports SHT_RELR regardless of this option. Loading times of both formats
+# can be compared with CFG_LDELF_TIMING=y.
+CFG_TA_RELR ?= n
+
+# TA load timing.
+# When enabled, ldelf reads the system counter to measure the time spent
+# loading a TA and relocating it, and reports it together with symbol lookup
+# statistics in the debug log. Accesses to the counter from EL0/PL0 are
+# enabled by the core for this purpose.
+CFG_LDELF_TIMING ?= n
+
 # Enable to compile user TA libraries with profiling (-pg).
 # Depends on CFG_TA_GPROF_SUPPORT or CFG_FTRACE_SUPPORT.
 CFG_ULIBS_MCOUNT ?= n
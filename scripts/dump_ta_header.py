@@ -15,7 +15,8 @@ def main():
     import struct
     import sys
 
-    img_type_name = {1: 'SHDR_BOOTSTRAP_TA', 2: 'SHDR_ENCRYPTED_TA'}
+    img_type_name = {1: 'SHDR_BOOTSTRAP_TA', 2: 'SHDR_ENCRYPTED_TA',
+                     3: 'SHDR_COMPRESSED_TA'}
     algo_name = {0x70414930: 'RSASSA_PKCS1_PSS_MGF1_SHA256',
                  0x70004830: 'RSASSA_PKCS1_V1_5_SHA256'}
 
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Copyright (c) 2026, agent <agent@local>
+#
+
+import argparse
+import json
+import struct
+import sys
+
+FUNC_GRAPH_HDR = b'Function graph for TA:'
+FTRACE_BIN_MAGIC = 0x43525446
+FTRACE_BIN_VERSION = 1
+FTRACE_BIN_FLAG_32BIT = 1 << 0
+FTRACE_REC_ENTER = 0
+FTRACE_REC_RETURN = 1
+
+# struct ftrace_bin_hdr and struct ftrace_rec in user_ta_header.h
+BIN_HDR = struct.Struct('<IHHIIIIQ')
+REC = struct.Struct('<QIHH')
+
+# Same layout as the text produced by lib/libutils/ext/ftrace/ftrace.c
+DURATION_MAX_LEN = 16
+
+epilog = '''
+This script decodes the binary function trace written by OP-TEE to
+/tmp/ftrace-<ta_uuid>.out when CFG_FTRACE_BINARY=y.
+
+By default, the output is the same text function graph as produced with
+CFG_FTRACE_BINARY=n, so it can be piped into scripts/symbolize.py:
+
+  $ scripts/ftrace_decode.py /tmp/ftrace-<ta_uuid>.out | \\
+        scripts/symbolize.py -d <ta_uuid>.elf
+
+With --chrome, a JSON file suitable for chrome://tracing or Perfetto is
+written instead.
+'''
+
+
+def get_args():
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        description='Decodes OP-TEE binary function traces',
+        epilog=epilog)
+    parser.add_argument('file', nargs='?', help='ftrace dump (default: '
+                        'standard input)')
+    parser.add_argument('--chrome', action='store_true',
+                        help='Output Chrome trace JSON instead of text')
+    parser.add_argument('--us-ms', type=int, default=10000,
+                        help='Same as CFG_FTRACE_US_MS: durations greater '
+                        'or equal to this value (in microseconds) are '
+                        'displayed in milliseconds (default: 10000, 0 '
+                        'means always microseconds)')
+
+    return parser.parse_args()
+
+
+def split_dump(data):
+    pos = data.find(FUNC_GRAPH_HDR)
+    if pos < 0:
+        sys.exit('Function graph header not found')
+    eol = data.find(b'\n', pos)
+    if eol < 0:
+        sys.exit('Truncated function graph header')
+    return data[:eol + 1], data[eol + 1:]
+
+
+def parse_records(data):
+    if len(data) < BIN_HDR.size:
+        sys.exit('Truncated binary header')
+    (magic, version, rec_size, flags, cntfrq, num_recs, _,
+     last_time) = BIN_HDR.unpack_from(data)
+    if magic != FTRACE_BIN_MAGIC:
+        sys.exit('Bad magic, not a binary function trace')
+    if version != FTRACE_BIN_VERSION or rec_size != REC.size:
+        sys.exit('Unsupported binary function trace version')
+    if not cntfrq:
+        cntfrq = 1
+
+    recs = []
+    off = BIN_HDR.size
+    for n in range(num_recs):
+        if off + REC.size > len(data):
+            print('Warning: truncated dump', file=sys.stderr)
+            break
+        recs.append(REC.unpack_from(data, off))
+        off += REC.size
+
+    # Timestamps are deltas with the previous record, only the time of the
+    # last record is known.
+    times = [0] * len(recs)
+    t = last_time
+    for i in range(len(recs) - 1, -1, -1):
+        times[i] = t
+        t -= recs[i][1]
+
+    addr_digits = 8 if flags & FTRACE_BIN_FLAG_32BIT else 16
+
+    return recs, times, cntfrq, addr_digits
+
+
+# Mirrors ftrace_duration() in lib/libutils/ext/ftrace/ftrace.c
+def duration(ticks, cntfrq, us_ms):
+    ticks = ticks * 1000000000 // cntfrq
+    us = ticks // 1000
+    ns = ticks % 1000
+
+    if us_ms and us >= us_ms:
+        unit = 'm'
+        val = us // 1000
+        frac = us % 1000
+    else:
+        unit = 'u'
+        val = us
+        frac = ns
+
+    if val > 999999:
+        s = '-' * 10
+    else:
+        s = '{}.{:03d}'.format(val if val else '', frac)
+
+    return (s + ' ' + unit + 's').rjust(DURATION_MAX_LEN - 3)
+
+
+def prefix(depth, dur=''):
+    return dur.rjust(DURATION_MAX_LEN - 3) + ' | ' + ' ' * depth
+
+
+def decode_text(recs, times, cntfrq, addr_digits, us_ms):
+    lines = []
+    # Per depth: index in lines and start time of the pending call
+    pending = {}
+
+    for (pc, _, depth, rtype), t in zip(recs, times):
+        if rtype == FTRACE_REC_ENTER:
+            lines.append([depth, '0x{:0{}x}'.format(pc, addr_digits), None])
+            pending[depth] = (len(lines) - 1, t)
+            continue
+
+        start = pending.pop(depth, None)
+        if start is None:
+            # Entry was overwritten in the ring buffer
+            lines.append([depth, '}', None])
+            continue
+
+        dur = duration(t - start[1], cntfrq, us_ms)
+        if start[0] == len(lines) - 1:
+            # Leaf function: "0x...();"
+            lines[-1][1] += '();'
+            lines[-1][2] = dur
+        else:
+            lines.append([depth, '}', dur])
+
+    out = []
+    for depth, s, dur in lines:
+        if dur is None and s != '}':
+            s += '() {'
+        out.append(prefix(depth, dur or '') + s + '\n')
+
+    return ''.join(out)
+
+
+def decode_chrome(recs, times, cntfrq, addr_digits):
+    events = []
+    open_depths = set()
+    t0 = times[0] if times else 0
+
+    for (pc, _, depth, rtype), t in zip(recs, times):
+        ts = (t - t0) * 1000000 / cntfrq
+        if rtype == FTRACE_REC_ENTER:
+            open_depths.add(depth)
+            events.append({'name': '0x{:0{}x}'.format(pc, addr_digits),
+                           'ph': 'B', 'ts': ts, 'pid': 0, 'tid': 0})
+        elif depth in open_depths:
+            open_depths.discard(depth)
+            events.append({'ph': 'E', 'ts': ts, 'pid': 0, 'tid': 0})
+
+    return json.dumps({'traceEvents': events, 'displayTimeUnit': 'ns'},
+                      indent=1) + '\n'
+
+
+def main():
+    args = get_args()
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    head, body = split_dump(data)
+    recs, times, cntfrq, addr_digits = parse_records(body)
+
+    if args.chrome:
+        sys.stdout.write(decode_chrome(recs, times, cntfrq, addr_digits))
+    else:
+        sys.stdout.write(head.decode('utf-8', 'replace'))
+        sys.stdout.write(decode_text(recs, times, cntfrq, addr_digits,
+                                     args.us_ms))
+
+
+if __name__ == "__main__":
+    main()
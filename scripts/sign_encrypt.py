@@ -16,6 +16,8 @@ enc_key_type = {'SHDR_ENC_KEY_DEV_SPECIFIC': 0x0,
 
 SHDR_BOOTSTRAP_TA = 1
 SHDR_ENCRYPTED_TA = 2
+SHDR_COMPRESSED_TA = 3
+SHDR_COMP_ALGO_ZLIB = 0
 SHDR_MAGIC = 0x4f545348
 SHDR_SIZE = 20
 
@@ -51,8 +53,8 @@ def get_args(logger):
         ' TA image file.\n' +
         '                 Takes arguments --uuid, --ta-version, --in, --out,' +
         ' --key,\n' +
-        '                 --enc-key (optional) and' +
-        ' --enc-key-type (optional).\n' +
+        '                 --enc-key (optional), --enc-key-type (optional)' +
+        ' and --compress (optional).\n' +
         '     digest      Generate loadable TA binary image digest' +
         ' for offline\n' +
         '                 signing. Takes arguments --uuid, --ta-version,' +
@@ -109,6 +111,10 @@ def get_args(logger):
         help='Encryption key type.\n' +
         '(SHDR_ENC_KEY_DEV_SPECIFIC or SHDR_ENC_KEY_CLASS_WIDE).\n' +
         'Defaults to SHDR_ENC_KEY_DEV_SPECIFIC.')
+    parser.add_argument(
+        '--compress', required=False, action='store_true',
+        help='Compress the TA with zlib (SHDR_COMPRESSED_TA).\n' +
+        'Cannot be combined with --enc-key.')
     parser.add_argument(
         '--ta-version', required=False, type=int_parse, default=0,
         help='TA version stored as a 32-bit unsigned integer and used for\n' +
@@ -152,6 +158,11 @@ def get_args(logger):
                     '--out were given.\n' +
                     '  --out will be ignored.')
 
+    if parsed.compress and parsed.enc_key:
+        logger.error('Arguments --compress and --enc-key cannot be ' +
+                     'combined.')
+        sys.exit(1)
+
     # Set defaults for optional arguments.
 
     if parsed.sigf is None:
@@ -178,6 +189,7 @@ def main():
     import logging
     import os
     import struct
+    import zlib
 
     logging.basicConfig()
     logger = logging.getLogger(os.path.basename(__file__))
@@ -217,6 +229,12 @@ def main():
     magic = SHDR_MAGIC
     if args.enc_key:
         img_type = SHDR_ENCRYPTED_TA
+    elif args.compress:
+        img_type = SHDR_COMPRESSED_TA
+        # The signed hash covers the uncompressed image
+        zimg = zlib.compress(img, 9)
+        img_size = len(zimg)
+        chdr = struct.pack('<II', SHDR_COMP_ALGO_ZLIB, len(img))
     else:
         img_type = SHDR_BOOTSTRAP_TA
 
@@ -248,6 +266,8 @@ def main():
         h.update(ehdr)
         h.update(nonce)
         h.update(tag)
+    if args.compress:
+        h.update(chdr)
     h.update(img)
     img_digest = h.finalize()
 
@@ -263,6 +283,9 @@ def main():
                 f.write(nonce)
                 f.write(tag)
                 f.write(ciphertext)
+            elif args.compress:
+                f.write(chdr)
+                f.write(zimg)
             else:
                 f.write(img)
 
@@ -361,7 +384,7 @@ def main():
         if magic != SHDR_MAGIC:
             raise Exception("Unexpected magic: 0x{:08x}".format(magic))
 
-        if img_type != SHDR_BOOTSTRAP_TA:
+        if img_type not in (SHDR_BOOTSTRAP_TA, SHDR_COMPRESSED_TA):
             raise Exception("Unsupported image type: {}".format(img_type))
 
         if algo_value not in algo.values():
@@ -395,10 +418,26 @@ def main():
         # sizeof(struct shdr_bootstrap_ta)
         h.update(img[start:end])
 
+        if img_type == SHDR_COMPRESSED_TA:
+            # sizeof(struct shdr_compressed_ta)
+            start, end = end, end + 8
+            [comp_algo, uncompressed_size] = struct.unpack('<II',
+                                                           img[start:end])
+            if comp_algo != SHDR_COMP_ALGO_ZLIB:
+                raise Exception('Unsupported compression: {}'
+                                .format(comp_algo))
+            h.update(img[start:end])
+
         # raw image
         start = end
         end += img_size
-        h.update(img[start:end])
+        if img_type == SHDR_COMPRESSED_TA:
+            raw = zlib.decompress(img[start:end])
+            if len(raw) != uncompressed_size:
+                raise Exception('Uncompressed size does not match')
+            h.update(raw)
+        else:
+            h.update(img[start:end])
 
         if digest != h.finalize():
             raise Exception('Hash digest does not match')
@@ -41,11 +41,95 @@ def get_args():
         dest="compress",
         action="store_true",
         help='Compress the image using the DEFLATE '
-        'algorithm')
+        'algorithm, or the algorithm given with --compress-algo')
+
+    parser.add_argument(
+        '--compress-algo',
+        choices=['deflate', 'lz4'],
+        default='deflate',
+        help='Compression algorithm used with --compress: deflate '
+        '(default) or lz4, which is faster to decompress')
 
     return parser.parse_args()
 
 
+# Must match EMB_TS_COMPRESS_* in core/include/kernel/embedded_ts.h
+EMB_TS_COMPRESS_DEFLATE = 0
+EMB_TS_COMPRESS_LZ4 = 1
+EMB_TS_LZ4_BLOCK_STORED = 1 << 31
+LZ4_BLOCK_SIZE = 32 * 1024
+
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5
+LZ4_MFLIMIT = 12
+LZ4_MAX_OFFSET = 0xffff
+
+
+def lz4_len(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def lz4_sequence(out, lit, offs=0, mlen=0):
+    token = min(len(lit), 15) << 4
+    if offs:
+        token |= min(mlen - LZ4_MIN_MATCH, 15)
+    out.append(token)
+    if len(lit) >= 15:
+        lz4_len(out, len(lit) - 15)
+    out += lit
+    if offs:
+        out += struct.pack('<H', offs)
+        if mlen - LZ4_MIN_MATCH >= 15:
+            lz4_len(out, mlen - LZ4_MIN_MATCH - 15)
+
+
+def lz4_compress_block(src):
+    # Greedy LZ4 block compressor, decoded by core/kernel/lz4.c
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    n = len(src)
+
+    while i <= n - LZ4_MFLIMIT:
+        key = src[i:i + LZ4_MIN_MATCH]
+        ref = table.get(key, -1)
+        table[key] = i
+        if ref < 0 or i - ref > LZ4_MAX_OFFSET:
+            i += 1
+            continue
+
+        mlen = LZ4_MIN_MATCH
+        max_mlen = n - LZ4_LAST_LITERALS - i
+        while mlen < max_mlen and src[ref + mlen] == src[i + mlen]:
+            mlen += 1
+
+        lz4_sequence(out, src[anchor:i], i - ref, mlen)
+        i += mlen
+        anchor = i
+
+    lz4_sequence(out, src[anchor:])
+    return bytes(out)
+
+
+def lz4_compress(data):
+    # See EMB_TS_COMPRESS_LZ4 in core/include/kernel/embedded_ts.h
+    out = bytearray(struct.pack('<I', LZ4_BLOCK_SIZE))
+    for offs in range(0, len(data), LZ4_BLOCK_SIZE):
+        blk = data[offs:offs + LZ4_BLOCK_SIZE]
+        cblk = lz4_compress_block(blk)
+        if len(cblk) >= len(blk):
+            out += struct.pack('<I', len(blk) | EMB_TS_LZ4_BLOCK_STORED)
+            out += blk
+        else:
+            out += struct.pack('<I', len(cblk))
+            out += cblk
+    return bytes(out)
+
+
 def get_name(obj):
     # Symbol or section .name can be a byte array or a string, we want a string
     try:
@@ -101,7 +185,10 @@ def main():
         bytes = _ts.read()
         uncompressed_size = len(bytes)
         if args.compress:
-            bytes = zlib.compress(bytes)
+            if args.compress_algo == 'lz4':
+                bytes = lz4_compress(bytes)
+            else:
+                bytes = zlib.compress(bytes)
         size = len(bytes)
 
     f = open(args.out, 'w')
@@ -147,6 +234,8 @@ def main():
     if args.compress:
         f.write('\t.uncompressed_size = '
                 '{:d},\n'.format(uncompressed_size))
+        if args.compress_algo == 'lz4':
+            f.write('\t.compression = EMB_TS_COMPRESS_LZ4,\n')
     f.write('};\n')
     f.close()
 
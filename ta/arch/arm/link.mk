@@ -35,6 +35,11 @@ ifeq ($(sm)-$(CFG_TA_BTI),ta_arm64-y)
 link-ldflags += $(call ld-option,-z force-bti) --fatal-warnings
 endif
 link-ldflags += --as-needed # Do not add dependency on unused shlib
+# DT_GNU_HASH is faster to search for ldelf, DT_HASH is kept for older ones
+link-ldflags += --hash-style=both
+ifeq ($(CFG_TA_RELR),y)
+link-ldflags += $(call ld-option,-z pack-relative-relocs)
+endif
 link-ldflags += $(link-ldflags$(sm))
 
 $(link-out-dir$(sm))/dyn_list:
@@ -106,6 +111,10 @@ ifeq ($(CFG_ENCRYPT_TA),y)
 crypt-args$(user-ta-uuid) := --enc-key $(TA_ENC_KEY)
 cmd-echo$(user-ta-uuid) := SIGNENC
 endif
+ifeq ($(CFG_COMPRESS_TA),y)
+# Requires CFG_REE_FS_TA_COMPRESSED=y in OP-TEE core
+crypt-args$(user-ta-uuid) += --compress
+endif
 $(link-out-dir$(sm))/$(user-ta-uuid).ta: \
 			$(link-out-dir$(sm))/$(user-ta-uuid).stripped.elf \
 			$(TA_SIGN_KEY) \
@@ -24,6 +24,10 @@ ifeq ($(sm)-$(CFG_TA_BTI),ta_arm64-y)
 shlink-ldflags += $(call ld-option,-z force-bti) --fatal-warnings
 endif
 shlink-ldflags += --as-needed # Do not add dependency on unused shlib
+shlink-ldflags += --hash-style=both # See link.mk
+ifeq ($(CFG_TA_RELR),y)
+shlink-ldflags += $(call ld-option,-z pack-relative-relocs)
+endif
 
 shlink-ldadd  = $(LDADD)
 shlink-ldadd += $(addprefix -L,$(libdirs))